@@ -0,0 +1,381 @@
+/*
+ * cache.c - 프록시의 웹 객체 캐시
+ *
+ * 블록들은 두 가지 구조에 동시에 연결된다.
+ *   - LRU 이중 연결 리스트: cache_root(가장 최근) ~ cache_tail(가장 오래됨)
+ *   - URI 해시 인덱스: uri 의 64비트 해시로 버킷을 고르고, 같은 버킷의 블록끼리 연결
+ *
+ * 조회는 해시가 같은 블록에 대해서만 strcmp 를 하므로 캐시 크기와 상관없이 O(1) 이고,
+ * 두 구조 모두 이중 연결이라 블록 제거도 O(1) 이다.
+ *
+ * 동시성:
+ *   - 조회(읽기)는 락을 잡지 않는다. 해시 버킷과 hnext 포인터는 atomic 으로 게시되고,
+ *     읽는 스레드는 epoch_enter/epoch_exit 사이에서만 이 포인터들을 따라간다.
+ *   - 추가/제거처럼 구조를 바꾸는 작업만 cache_write_lock 으로 직렬화한다.
+ *     LRU 리스트는 쓰는 쪽만 건드린다.
+ *   - 최근 사용 정보는 리스트를 옮기는 대신 블록의 referenced 비트로 남긴다.
+ *     evict 할 때 이 비트가 켜진 블록은 비트를 끄고 리스트 앞으로 옮겨 한 번 더 기회를 준다
+ *     (CLOCK / second chance). 이미 켜져 있으면 다시 쓰지 않으므로 자주 읽히는 블록의
+ *     캐시 라인이 코어 사이를 오가지 않는다.
+ *   - refcnt: 캐시가 블록을 갖고 있는 동안 1, 히트를 전송 중인 스레드마다 1씩 더해진다.
+ *     전송은 오래 걸릴 수 있어 epoch 임계 구역을 붙잡고 있지 않도록 참조로 고정한다.
+ *     참조가 0 이 되면 블록은 epoch_retire 로 넘어가, 그 블록을 보고 있었을 수 있는
+ *     읽기 스레드가 모두 빠져나간 뒤에 해제된다.
+ *
+ * 메모리:
+ *   블록은 헤더 + uri + 객체 데이터를 실제 크기대로 이어 붙여 slab 할당기에서 받는다.
+ *   arena 크기가 MAX_CACHE_SIZE 이므로 "캐시 1MB" 는 실제로 1MB 의 메모리를 뜻하고,
+ *   total_cache_size 도 객체 크기가 아닌 블록이 차지하는 바이트 수를 센다.
+ */
+#include "cache.h"
+#include "epoch.h"
+#include "slab.h"
+
+// 캐시 전체를 관리하기 위한 전역 변수 (선언은 cache.h, cache_write_lock 으로 보호)
+CacheBlock *cache_root;
+CacheBlock *cache_tail;
+int total_cache_size;
+
+static _Atomic(CacheBlock *) cache_buckets[CACHE_HASH_BUCKETS];  // URI 해시 인덱스
+static int cache_count;                                          // 캐시에 있는 블록 수
+static atomic_long retired_size;    // 캐시에서 빠졌지만 아직 arena 로 돌아오지 않은 블록들의 바이트 수
+
+static pthread_mutex_t cache_write_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void lru_unlink(CacheBlock *block);
+static void lru_push_front(CacheBlock *block);
+static void remove_block(CacheBlock *block);
+static CacheBlock *make_room(size_t need);
+static void free_block(void *ptr);
+
+
+/**
+ * 캐시를 초기화하는 함수
+ * 
+ * 캐시의 루트와 테일 포인터를 NULL로 설정하고
+ * 총 캐시 크기를 0으로 초기화한다.
+ */
+void init_cache() {
+    int i;
+
+    slab_init(MAX_CACHE_SIZE);
+
+    pthread_mutex_lock(&cache_write_lock);
+    cache_root = NULL;
+    cache_tail = NULL;
+    total_cache_size = 0;
+    cache_count = 0;
+    for (i = 0; i < CACHE_HASH_BUCKETS; i++) {
+        atomic_init(&cache_buckets[i], NULL);
+    }
+    pthread_mutex_unlock(&cache_write_lock);
+}
+
+/**
+ * URI 의 64비트 FNV-1a 해시를 계산하는 함수
+ *
+ * @param uri 해시할 URI 문자열
+ * @return 64비트 해시 값
+ */
+uint64_t hash_uri(const char *uri) {
+    uint64_t hash = 14695981039346656037ULL;    // FNV offset basis
+
+    while (*uri) {
+        hash ^= (unsigned char)*uri++;
+        hash *= 1099511628211ULL;               // FNV prime
+    }
+    return hash;
+}
+
+/**
+ * 주어진 URI에 해당하는 캐시 블록을 찾는 함수 (락을 잡지 않는다)
+ *
+ * 찾은 블록은 참조 카운트를 올려 고정한 뒤 돌려준다. 그래서 다른 스레드가
+ * 이 블록을 evict 하더라도, 호출한 쪽이 release_cache_block 을 부를 때까지
+ * object_data 는 그대로 남아 있다.
+ * 
+ * @param uri 검색할 URI 문자열
+ * @return 고정된 캐시 블록의 포인터, 없으면 NULL
+ */
+CacheBlock* find_cache_block(char *uri) {
+    uint64_t hash = hash_uri(uri);
+    CacheBlock *current;
+    int ref;
+
+    epoch_enter();
+
+    current = atomic_load_explicit(&cache_buckets[hash & (CACHE_HASH_BUCKETS - 1)],
+                                   memory_order_acquire);
+    while (current != NULL) {
+        // 해시가 같을 때만 전체 문자열을 비교한다.
+        if (current->uri_hash == hash && strcmp(current->uri, uri) == 0) {
+            // 참조가 이미 0 이면 제거되어 해제를 기다리는 블록이므로 미스로 처리한다.
+            ref = atomic_load(&current->refcnt);
+            while (ref > 0 && !atomic_compare_exchange_weak(&current->refcnt, &ref, ref + 1))
+                ;
+            if (ref == 0) {
+                current = NULL;
+            } else if (!atomic_load_explicit(&current->referenced, memory_order_relaxed)) {
+                atomic_store_explicit(&current->referenced, 1, memory_order_relaxed);
+            }
+            break;
+        }
+        current = atomic_load_explicit(&current->hnext, memory_order_acquire);
+    }
+
+    epoch_exit();
+    return current;
+}
+
+/**
+ * find_cache_block 으로 고정한 블록을 놓아주는 함수
+ *
+ * 마지막 참조가 사라지면(이미 캐시에서 제거된 블록) 해제를 예약한다.
+ *
+ * @param block 놓아줄 캐시 블록
+ */
+void release_cache_block(CacheBlock *block) {
+    if (atomic_fetch_sub(&block->refcnt, 1) == 1) {
+        epoch_retire(block, free_block);
+    }
+}
+
+/**
+ * 읽기 스레드가 모두 빠져나간 블록을 arena 에 돌려주는 함수 (epoch_retire 의 free_fn)
+ */
+static void free_block(void *ptr) {
+    atomic_fetch_sub(&retired_size, ((CacheBlock *)ptr)->alloc_size);
+    slab_free(ptr);
+}
+
+/**
+ * 새로운 웹 객체를 캐시에 추가하는 함수
+ * 
+ * @param uri 캐시할 객체의 URI
+ * @param data 캐시할 객체의 데이터
+ * @param size 캐시할 객체의 크기
+ */
+void add_to_cache(char *uri, char *data, int size) {
+    _Atomic(CacheBlock *) *bucket;
+    CacheBlock *old, *head, *new_block;
+    uint64_t hash = hash_uri(uri);
+    size_t uri_len = strlen(uri) + 1;
+    size_t need = sizeof(CacheBlock) + uri_len + size;
+
+    if (size > MAX_OBJECT_SIZE || slab_class_size(need) == 0) {
+        return;
+    }
+
+    // 1. arena 에서 실제 크기만큼 할당한다. 빈 공간이 없으면 make_room 이 evict 해서 만든다.
+    if ((new_block = slab_alloc(need)) == NULL) {
+        pthread_mutex_lock(&cache_write_lock);
+        new_block = make_room(need);
+        pthread_mutex_unlock(&cache_write_lock);
+
+        if (new_block == NULL) {    // 전송 중인 블록들이 arena 를 붙잡고 있다
+            return;
+        }
+    }
+
+    // 2. 새 블록에 데이터 복사 및 초기화 (락을 잡기 전에 복사까지 끝낸다)
+    memcpy(new_block->uri, uri, uri_len);
+    new_block->object_data = new_block->uri + uri_len;
+    memcpy(new_block->object_data, data, size);  // 바이너리 데이터이므로 memcpy 사용
+    new_block->object_size = size;
+    new_block->alloc_size = slab_size(new_block);
+    new_block->uri_hash = hash;
+    atomic_init(&new_block->refcnt, 1);          // 캐시가 갖고 있는 참조
+    atomic_init(&new_block->referenced, 0);
+
+    pthread_mutex_lock(&cache_write_lock);
+
+    // 3. 같은 URI 가 이미 있으면(동시에 들어온 미스) 예전 블록을 지운다.
+    bucket = &cache_buckets[hash & (CACHE_HASH_BUCKETS - 1)];
+    for (old = atomic_load(bucket); old != NULL; old = atomic_load(&old->hnext)) {
+        if (old->uri_hash == hash && strcmp(old->uri, uri) == 0) {
+            remove_block(old);
+            break;
+        }
+    }
+
+    // 4. 해시 버킷의 맨 앞에 연결
+    //    블록 내용을 모두 채운 뒤 release 저장으로 게시하므로, 읽는 스레드는 완성된 블록만 본다.
+    head = atomic_load_explicit(bucket, memory_order_relaxed);
+    atomic_init(&new_block->hnext, head);
+    if (head != NULL) {
+        head->hpprev = &new_block->hnext;
+    }
+    new_block->hpprev = bucket;
+    atomic_store_explicit(bucket, new_block, memory_order_release);
+
+    // 5. LRU 리스트의 맨 앞에 연결
+    lru_push_front(new_block);
+    total_cache_size += new_block->alloc_size;   // 캐시 사이즈 업데이트 (실제 차지하는 바이트)
+    cache_count++;
+
+    pthread_mutex_unlock(&cache_write_lock);
+}
+
+/**
+ * need 바이트를 할당할 수 있을 때까지 블록을 evict 하는 함수
+ *
+ * evict 된 블록의 메모리는 epoch 가 지나야 arena 로 돌아오므로 매번 회수를 시도한다.
+ * 전송 중인 스레드가 고정했거나 읽기 스레드가 아직 보고 있는 블록은 evict 해도 바로 돌아오지 않는다.
+ * 이번에 evict 했지만 돌아오지 않은 바이트가 need 만큼 쌓였다면, 더 evict 해도 공간은 그 블록들이
+ * 풀려야 생기므로 캐시를 비우는 대신 이 객체를 캐시하지 않는다.
+ * cache_write_lock 을 잡은 상태에서 호출해야 한다.
+ *
+ * @return 할당된 메모리, 공간을 만들지 못했으면 NULL
+ */
+static CacheBlock *make_room(size_t need) {
+    CacheBlock *block;
+    long held_before = atomic_load(&retired_size);  // 이번 호출 전부터 돌아오지 않은 바이트
+
+    while ((block = slab_alloc(need)) == NULL) {
+        if (cache_tail == NULL || atomic_load(&retired_size) - held_before >= (long)need) {
+            epoch_reclaim();
+            return slab_alloc(need);
+        }
+        evict_lru_block();
+        epoch_reclaim();
+    }
+    return block;
+}
+
+/**
+ * 가장 오래전에 사용된(Least Recently Used) 캐시 블록을 제거하는 함수
+ *
+ * 리스트 끝의 블록이 최근에 읽혔다면(referenced) 비트를 끄고 맨 앞으로 옮긴 뒤
+ * 다음 블록을 본다. 모든 블록을 한 바퀴 돌아도 못 찾으면 끝의 블록을 제거한다.
+ * cache_write_lock 을 잡은 상태에서 호출해야 한다.
+ */
+void evict_lru_block() {
+    CacheBlock *victim;
+    int chances = cache_count;
+
+    // 캐시가 비어 있으면 아무것도 하지 않고 함수 종료
+    if (cache_tail == NULL) {
+        return;
+    }
+
+    while ((victim = cache_tail) != cache_root && chances-- > 0 &&
+           atomic_exchange_explicit(&victim->referenced, 0, memory_order_relaxed)) {
+        lru_unlink(victim);
+        lru_push_front(victim);
+    }
+
+    remove_block(cache_tail);
+}
+
+/**
+ * 블록을 해시 인덱스와 LRU 리스트에서 떼어 내고 캐시의 참조를 놓는 함수
+ *
+ * 떼어 낸 뒤에도 이미 이 블록까지 따라온 읽기 스레드는 hnext 를 계속 따라갈 수 있도록
+ * 블록 자신의 hnext 는 건드리지 않는다.
+ */
+static void remove_block(CacheBlock *block) {
+    CacheBlock *next = atomic_load_explicit(&block->hnext, memory_order_relaxed);
+
+    // 해시 버킷에서 제거: 앞 블록(또는 버킷 헤드)이 다음 블록을 가리키게 한다.
+    atomic_store_explicit(block->hpprev, next, memory_order_release);
+    if (next != NULL) {
+        next->hpprev = block->hpprev;
+    }
+
+    lru_unlink(block);
+
+    // 캐시 용량 업데이트 (arena 로 돌아올 때까지는 retired_size 로 센다)
+    total_cache_size -= block->alloc_size;
+    cache_count--;
+    atomic_fetch_add(&retired_size, block->alloc_size);
+
+    // 캐시의 참조를 놓는다. 전송 중인 스레드가 없으면 여기서 해제가 예약된다.
+    release_cache_block(block);
+}
+
+/**
+ * 블록을 LRU 리스트에서 떼어 내는 함수
+ */
+static void lru_unlink(CacheBlock *block) {
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        cache_root = block->next;
+    }
+
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    } else {
+        cache_tail = block->prev;
+    }
+}
+
+/**
+ * 블록을 LRU 리스트의 맨 앞(가장 최근 사용)에 넣는 함수
+ */
+static void lru_push_front(CacheBlock *block) {
+    block->prev = NULL;
+    block->next = cache_root;
+
+    if (cache_root != NULL) {
+        cache_root->prev = block;
+    } else {                     // 리스트가 비어 있을 경우
+        cache_tail = block;
+    }
+    cache_root = block;
+}
+
+/**
+ * 응답을 모을 빈 버퍼를 준비하는 함수
+ *
+ * 메모리는 첫 데이터가 들어올 때 할당하고, 크기는 MAX_OBJECT_SIZE 를 넘지 않는다.
+ */
+void cache_fill_init(cache_fill_t *fill) {
+    fill->buf = NULL;
+    fill->size = 0;
+    fill->cap = 0;
+    fill->overflow = 0;
+}
+
+/**
+ * 클라이언트에게 전달한 응답 조각을 버퍼 뒤에 덧붙이는 함수
+ *
+ * 객체가 MAX_OBJECT_SIZE 를 넘는 순간 버퍼를 버리고 이후 조각은 무시한다.
+ * 그래서 큰 객체는 메모리를 더 쓰지 않고 그대로 흘려보내기만 한다.
+ */
+void cache_fill_append(cache_fill_t *fill, const char *data, int n) {
+    if (fill->overflow) {
+        return;
+    }
+
+    if (fill->size + n > MAX_OBJECT_SIZE) {
+        cache_fill_abort(fill);
+        fill->overflow = 1;
+        return;
+    }
+
+    if (fill->size + n > fill->cap) {
+        int cap = (fill->cap > 0) ? fill->cap : MAXBUF;
+        while (cap < fill->size + n) {
+            cap *= 2;
+        }
+        if (cap > MAX_OBJECT_SIZE) {
+            cap = MAX_OBJECT_SIZE;
+        }
+        fill->buf = Realloc(fill->buf, cap);
+        fill->cap = cap;
+    }
+
+    memcpy(fill->buf + fill->size, data, n);
+    fill->size += n;
+}
+
+/**
+ * 캐시에 넣지 않고 버퍼만 해제하는 함수 (응답이 중간에 끊긴 경우 등)
+ */
+void cache_fill_abort(cache_fill_t *fill) {
+    free(fill->buf);
+    fill->buf = NULL;
+    fill->size = 0;
+    fill->cap = 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * cache.h - 프록시의 웹 객체 캐시 (LRU 리스트 + URI 해시 인덱스)
+ *
+ * 여러 스레드가 함께 사용할 수 있고, 조회는 락을 잡지 않는다. find_cache_block 이 돌려준 블록은
+ * 참조 카운트로 고정(pin)되어 있으므로, 다 쓴 뒤 반드시 release_cache_block 을 호출해야 한다.
+ */
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "csapp.h"
+
+/* Recommended max cache and object sizes */
+#define MAX_CACHE_SIZE 1049000
+#define MAX_OBJECT_SIZE 102400
+
+#define CACHE_HASH_BUCKETS 4096     // 해시 인덱스의 버킷 수 (2의 거듭제곱)
+
+/* --------------- Cache Data Structures --------------- */
+// 캐시 블록 하나를 나타내는 구조체
+// 헤더 바로 뒤에 uri 문자열과 객체 데이터가 실제 크기만큼 이어서 저장된다.
+// (블록 전체가 slab 할당기의 한 블록 하나를 차지한다.)
+typedef struct CacheBlock {
+    char *object_data;                      // value: 웹 객체 데이터 (uri 바로 뒤를 가리킨다)
+    int object_size;                        // 객체의 크기
+    int alloc_size;                         // 이 블록이 arena 에서 실제로 차지하는 바이트 수
+    uint64_t uri_hash;                      // uri 의 64비트 해시 (저장할 때 한 번만 계산)
+    atomic_int refcnt;                      // 캐시 자신(1) + 이 블록을 전송 중인 스레드 수
+    atomic_int referenced;                  // 마지막 evict 검사 이후 읽힌 적이 있으면 1
+
+    struct CacheBlock *prev;                // LRU 리스트: 이전 블록을 가리키는 포인터
+    struct CacheBlock *next;                // LRU 리스트: 다음 블록을 가리키는 포인터
+
+    _Atomic(struct CacheBlock *) hnext;     // 해시 버킷: 같은 버킷의 다음 블록
+    _Atomic(struct CacheBlock *) *hpprev;   // 해시 버킷: 자신을 가리키고 있는 포인터의 주소
+
+    char uri[];                             // key: 요청 URI (NULL 문자 포함 실제 길이)
+} CacheBlock;
+
+// 응답을 전달하면서 캐시에 넣을 객체를 모으는 버퍼 (아직 캐시에 게시되지 않은 항목)
+typedef struct {
+    char *buf;                              // 지금까지 모은 응답 (필요할 때마다 두 배로 늘린다)
+    int size;                               // 모은 바이트 수
+    int cap;                                // buf 의 크기
+    int overflow;                           // MAX_OBJECT_SIZE 를 넘어 캐시하지 않기로 했으면 1
+} cache_fill_t;
+
+// 캐시 전체를 관리하기 위한 전역 변수
+extern CacheBlock *cache_root;     // 캐시 연결 리스트의 시작점 (가장 최근에 추가되었거나 다시 기회를 얻은 블록)
+extern CacheBlock *cache_tail;     // 캐시 연결 리스트의 마지막 블록 (다음 evict 후보)
+extern int total_cache_size;       // 현재 캐시 블록들이 arena 에서 실제로 차지하는 바이트 수의 합
+/* ----------------------------------------------------- */
+
+void init_cache();
+uint64_t hash_uri(const char *uri);
+CacheBlock* find_cache_block(char *uri);
+void release_cache_block(CacheBlock *block);
+void add_to_cache(char *uri, char *data, int size);
+void evict_lru_block();
+
+void cache_fill_init(cache_fill_t *fill);
+void cache_fill_append(cache_fill_t *fill, const char *data, int n);
+void cache_fill_abort(cache_fill_t *fill);
+
+#endif /* __CACHE_H__ */
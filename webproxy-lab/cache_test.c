@@ -0,0 +1,102 @@
+/*
+ * cache_test.c - cache.c 의 evict 회귀 검사 ("make check" 로 실행한다)
+ *
+ * 실패한 검사마다 한 줄을 출력하고, 하나라도 실패하면 1 로 끝난다.
+ */
+#include <stdio.h>
+#include "cache.h"
+
+#define OBJ_SIZE    100000      // 블록 하나가 128KB 등급을 차지하므로 arena 에 8개가 들어간다
+#define ARENA_OBJS  8
+
+static char data[OBJ_SIZE];
+static int failures;
+
+
+static void expect(int cond, const char *what) {
+    if (!cond) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static char *uri_of(int i) {
+    static char uri[MAXLINE];
+
+    sprintf(uri, "http://localhost/obj%d", i);
+    return uri;
+}
+
+/**
+ * 캐시에 있으면 1 (고정했던 참조는 바로 놓는다)
+ */
+static int cached(int i) {
+    CacheBlock *block = find_cache_block(uri_of(i));
+
+    if (block == NULL) {
+        return 0;
+    }
+    release_cache_block(block);
+    return 1;
+}
+
+/**
+ * 객체 from ~ to-1 중 캐시에 있는 수
+ */
+static int count_cached(int from, int to) {
+    int i, n = 0;
+
+    for (i = from; i < to; i++) {
+        n += cached(i);
+    }
+    return n;
+}
+
+/**
+ * arena 가 차면 가장 오래된 블록 하나만 evict 하고 새 객체를 넣는다
+ */
+static void test_evict_unpinned(void) {
+    int i;
+
+    for (i = 0; i <= ARENA_OBJS; i++) {
+        add_to_cache(uri_of(i), data, OBJ_SIZE);
+    }
+    expect(!cached(0), "unpinned: oldest object evicted");
+    expect(count_cached(1, ARENA_OBJS + 1) == ARENA_OBJS, "unpinned: the others stay cached");
+}
+
+/**
+ * 모든 블록이 전송 중이라 고정되어 있으면, 새 객체 하나 때문에 캐시를 비우지 않는다
+ */
+static void test_pinned_keeps_cache(void) {
+    CacheBlock *pins[ARENA_OBJS];
+    int i;
+
+    for (i = 0; i < ARENA_OBJS; i++) {
+        pins[i] = find_cache_block(uri_of(i + 1));
+    }
+
+    add_to_cache(uri_of(ARENA_OBJS + 1), data, OBJ_SIZE);
+    expect(!cached(ARENA_OBJS + 1), "pinned: new object not cached");
+    expect(count_cached(1, ARENA_OBJS + 1) >= ARENA_OBJS - 1, "pinned: cache not emptied");
+
+    // 전송이 끝나 고정이 풀리면 evict 했던 블록의 공간을 쓸 수 있다.
+    for (i = 0; i < ARENA_OBJS; i++) {
+        if (pins[i] != NULL) {
+            release_cache_block(pins[i]);
+        }
+    }
+    add_to_cache(uri_of(ARENA_OBJS + 1), data, OBJ_SIZE);
+    expect(cached(ARENA_OBJS + 1), "pinned: cached once the pins are released");
+}
+
+int main(void) {
+    init_cache();
+    test_evict_unpinned();
+    test_pinned_keeps_cache();
+
+    if (failures == 0) {
+        printf("cache: all tests passed\n");
+    }
+    return failures != 0;
+}
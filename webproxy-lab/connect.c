@@ -0,0 +1,213 @@
+/*
+ * connect.c - 여러 목적지 주소로 동시에 연결을 시도하는 non-blocking connect 엔진 (Happy Eyeballs, RFC 8305)
+ *
+ * 경쟁 상태(connrace_t)는 블록되지 않는 connrace_step 으로만 진행한다.
+ * 이벤트 루프는 시도 소켓들을 epoll 에 등록해 두고 이벤트가 오거나 connrace_deadline 이 되면 부르고,
+ * 스레드 모드의 race_connect 는 같은 함수를 poll 로 기다리며 부른다.
+ */
+#include "connect.h"
+#include <poll.h>
+#include <limits.h>
+
+
+/**
+ * 단조 증가 시계의 현재 시각을 밀리초로 얻는 함수
+ *
+ * 시스템 시각이 바뀌어도 제한 시간 계산이 어긋나지 않도록 CLOCK_MONOTONIC 을 쓴다.
+ */
+long monotonic_ms() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+/**
+ * 연결 경쟁을 준비하는 함수
+ *
+ * 첫 주소의 family 부터 시작해 두 family 를 번갈아 늘어놓는다. 한쪽 경로가 통째로 막혀 있어도
+ * 두 번째 시도는 다른 family 로 가므로 stagger 한 번만 기다리면 된다.
+ *
+ * @param addrs getaddrinfo 결과 (경쟁이 끝날 때까지 해제하면 안 된다)
+ * @param stagger_ms 다음 주소를 시작하기 전에 앞 시도를 기다리는 시간
+ * @param attempt_ms 시도 하나의 제한 시간
+ */
+void connrace_init(connrace_t *r, struct addrinfo *addrs, int stagger_ms, int attempt_ms) {
+    struct addrinfo *first[CONNECT_MAX_ADDRS], *other[CONNECT_MAX_ADDRS], *p;
+    int nfirst = 0, nother = 0, i = 0, j = 0;
+
+    for (p = addrs; p != NULL && nfirst + nother < CONNECT_MAX_ADDRS; p = p->ai_next) {
+        if (p->ai_family == addrs->ai_family) {
+            first[nfirst++] = p;
+        } else {
+            other[nother++] = p;
+        }
+    }
+
+    r->naddrs = 0;
+    while (i < nfirst || j < nother) {
+        if (i < nfirst) {
+            r->order[r->naddrs++] = first[i++];
+        }
+        if (j < nother) {
+            r->order[r->naddrs++] = other[j++];
+        }
+    }
+
+    r->next = 0;
+    r->nactive = 0;
+    r->next_start = 0;
+    r->stagger_ms = stagger_ms;
+    r->attempt_ms = attempt_ms;
+}
+
+/**
+ * 진행 중인 시도 하나를 목록에서 빼는 함수 (마지막 시도를 그 자리로 옮긴다)
+ */
+static void remove_attempt(connrace_t *r, int i) {
+    r->active[i] = r->active[--r->nactive];
+}
+
+/**
+ * 연결 경쟁을 블록되지 않고 할 수 있는 만큼 진행하는 함수
+ *
+ * 1. 진행 중인 시도 중 handshake 가 끝난 소켓이 있으면 그 소켓을 쓰고 나머지는 닫는다.
+ * 2. 실패했거나 제한 시간이 지난 시도는 닫는다.
+ * 3. 진행 중인 시도가 없거나 stagger 가 지났으면 다음 주소로 연결을 시작한다.
+ *
+ * @param on_start 새 시도 소켓을 만들 때마다 connect 전에 호출한다 (epoll 등록 등, 실패하면 음수, NULL 이면 생략)
+ * @return 연결된 소켓 (non-blocking), CONNRACE_AGAIN 또는 CONNRACE_FAIL
+ */
+int connrace_step(connrace_t *r, int (*on_start)(int fd, void *arg), void *arg) {
+    struct pollfd pfd[CONNECT_MAX_ADDRS];
+    struct addrinfo *p;
+    long now = monotonic_ms();
+    int i, fd, err;
+    socklen_t len;
+
+    // 1. 진행 중인 시도들의 상태를 기다리지 않고 확인한다.
+    for (i = 0; i < r->nactive; i++) {
+        pfd[i].fd = r->active[i].fd;
+        pfd[i].events = POLLOUT;
+        pfd[i].revents = 0;
+    }
+    if (r->nactive > 0 && poll(pfd, r->nactive, 0) < 0) {
+        for (i = 0; i < r->nactive; i++) {
+            pfd[i].revents = 0;     // 이번에는 아무것도 확인하지 못한 것으로 친다
+        }
+    }
+
+    // 뒤에서부터 보면 빠진 자리로 옮겨 오는 시도는 이미 확인한 것이다.
+    for (i = r->nactive - 1; i >= 0; i--) {
+        fd = r->active[i].fd;
+        if (pfd[i].revents != 0) {
+            err = 0;
+            len = sizeof(err);
+            if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+                err = errno;
+            }
+            remove_attempt(r, i);
+            if (err == 0) {
+                connrace_abort(r);  // 가장 먼저 연결된 소켓만 남긴다
+                return fd;
+            }
+            close(fd);
+            r->next_start = now;    // 실패한 시도가 있으면 stagger 를 기다리지 않고 다음 주소로
+        } else if (now >= r->active[i].deadline) {
+            remove_attempt(r, i);
+            close(fd);
+            r->next_start = now;
+        }
+    }
+
+    // 2. 다음 주소로 연결을 시작한다.
+    while (r->next < r->naddrs && (r->nactive == 0 || now >= r->next_start)) {
+        p = r->order[r->next++];
+
+        if ((fd = socket(p->ai_family, p->ai_socktype | SOCK_NONBLOCK, p->ai_protocol)) < 0) {
+            continue;
+        }
+        if (on_start != NULL && on_start(fd, arg) < 0) {
+            close(fd);
+            continue;
+        }
+        if (connect(fd, p->ai_addr, p->ai_addrlen) == 0) {
+            connrace_abort(r);      // 루프백처럼 바로 연결되는 경우
+            return fd;
+        }
+        if (errno != EINPROGRESS) {
+            close(fd);
+            continue;               // 바로 실패한 주소는 건너뛰고 다음 주소를 시도
+        }
+
+        r->active[r->nactive].fd = fd;
+        r->active[r->nactive].deadline = now + r->attempt_ms;
+        r->nactive++;
+        r->next_start = now + r->stagger_ms;
+    }
+
+    return (r->nactive > 0) ? CONNRACE_AGAIN : CONNRACE_FAIL;
+}
+
+/**
+ * 소켓 이벤트가 없어도 connrace_step 을 다시 불러야 하는 시각(ms)을 얻는 함수
+ *
+ * 가장 이른 시도의 제한 시간과, 남은 주소가 있으면 다음 시도를 시작할 시각 중 빠른 쪽이다.
+ */
+long connrace_deadline(connrace_t *r) {
+    long deadline = (r->next < r->naddrs) ? r->next_start : LONG_MAX;
+    int i;
+
+    for (i = 0; i < r->nactive; i++) {
+        if (r->active[i].deadline < deadline) {
+            deadline = r->active[i].deadline;
+        }
+    }
+    return deadline;
+}
+
+/**
+ * 진행 중인 시도를 모두 닫고 경쟁을 끝내는 함수
+ */
+void connrace_abort(connrace_t *r) {
+    while (r->nactive > 0) {
+        close(r->active[--r->nactive].fd);
+    }
+    r->next = r->naddrs;
+}
+
+/**
+ * 주소들을 경쟁시켜 연결하는 블로킹 함수 (open_clientfd 의 connect 부분을 대신한다)
+ *
+ * @param deadline 이 시각(ms)까지 연결하지 못하면 남은 시도를 모두 버린다
+ * @return 연결된 소켓 (blocking 모드로 되돌린다), 모든 주소로 실패하면 CONNRACE_FAIL,
+ *         제한 시간이 지나면 CONNRACE_TIMEOUT
+ */
+int race_connect(struct addrinfo *addrs, int stagger_ms, int attempt_ms, long deadline) {
+    connrace_t r;
+    struct pollfd pfd[CONNECT_MAX_ADDRS];
+    long timeout, wake;
+    int fd, i;
+
+    connrace_init(&r, addrs, stagger_ms, attempt_ms);
+
+    while ((fd = connrace_step(&r, NULL, NULL)) == CONNRACE_AGAIN) {
+        if (monotonic_ms() >= deadline) {
+            connrace_abort(&r);
+            return CONNRACE_TIMEOUT;
+        }
+        for (i = 0; i < r.nactive; i++) {
+            pfd[i].fd = r.active[i].fd;
+            pfd[i].events = POLLOUT;
+        }
+        wake = connrace_deadline(&r);
+        timeout = ((wake < deadline) ? wake : deadline) - monotonic_ms();
+        poll(pfd, r.nactive, (timeout > 0) ? timeout : 0);
+    }
+    if (fd < 0) {
+        return CONNRACE_FAIL;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+    return fd;
+}
@@ -0,0 +1,47 @@
+/*
+ * connect.h - 여러 목적지 주소로 동시에 연결을 시도하는 non-blocking connect 엔진 (Happy Eyeballs)
+ *
+ * open_clientfd 처럼 주소를 하나씩 블로킹 connect 로 시도하면, 목록 앞쪽의 주소가 응답 없이 막혀 있을 때
+ * 커널의 SYN 타임아웃(몇 분)이 지나야 다음 주소로 넘어간다.
+ * 여기서는 주소 family(IPv6/IPv4)를 번갈아 늘어놓고, 앞 시도가 stagger 만큼 끝나지 않으면
+ * 다음 주소로도 연결을 시작한다. 가장 먼저 handshake 를 마친 소켓을 쓰고 나머지는 닫는다.
+ * 각 시도는 attempt 시간 안에 끝나지 않으면 버린다.
+ */
+#ifndef __CONNECT_H__
+#define __CONNECT_H__
+
+#include "csapp.h"
+
+#define CONNECT_MAX_ADDRS   16      // 한 번에 경쟁시킬 수 있는 주소 수
+
+/* connrace_step 의 반환값 (0 이상이면 연결된 소켓) */
+#define CONNRACE_AGAIN      -1      // 아직 연결된 시도가 없다: 이벤트나 connrace_deadline 까지 기다린다
+#define CONNRACE_FAIL       -2      // 모든 주소로 연결에 실패했다
+#define CONNRACE_TIMEOUT    -3      // race_connect: 전체 제한 시간 안에 연결하지 못했다
+
+/* 진행 중인 connect 시도 하나 */
+typedef struct {
+    int fd;
+    long deadline;                  // 이 시각(ms)까지 연결되지 않으면 버린다
+} connect_attempt_t;
+
+/* 주소 목록 하나에 대한 연결 경쟁 */
+typedef struct {
+    struct addrinfo *order[CONNECT_MAX_ADDRS];  // family 를 번갈아 늘어놓은 주소 목록
+    int naddrs;
+    int next;                       // 다음에 시도할 주소의 위치
+    connect_attempt_t active[CONNECT_MAX_ADDRS];    // 진행 중인 시도 ([0, nactive) 만 유효)
+    int nactive;
+    long next_start;                // 이 시각(ms)이 되면 앞 시도를 기다리지 않고 다음 주소를 시작한다
+    int stagger_ms;                 // 다음 주소를 시작하기 전에 기다리는 시간
+    int attempt_ms;                 // 시도 하나의 제한 시간
+} connrace_t;
+
+long monotonic_ms();
+void connrace_init(connrace_t *r, struct addrinfo *addrs, int stagger_ms, int attempt_ms);
+int connrace_step(connrace_t *r, int (*on_start)(int fd, void *arg), void *arg);
+long connrace_deadline(connrace_t *r);
+void connrace_abort(connrace_t *r);
+int race_connect(struct addrinfo *addrs, int stagger_ms, int attempt_ms, long deadline);
+
+#endif /* __CONNECT_H__ */
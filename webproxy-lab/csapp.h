@@ -25,6 +25,7 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -60,6 +61,17 @@ extern char **environ; /* Defined by libc */
 #define MAXBUF   8192  /* Max I/O buffer size */
 #define LISTENQ  1024  /* Second argument to listen() */
 
+/* $begin rio_iov_t */
+#define RIO_IOVMAX 64
+typedef struct {
+    struct iovec iov[RIO_IOVMAX]; /* Fragments of the response, in order */
+    int iovcnt;                   /* Fragments added */
+    int iovcur;                   /* First fragment not fully written */
+    char *fmtptr;                 /* Next free byte in fmtbuf */
+    char fmtbuf[MAXLINE];         /* Storage for rio_iovprintf text */
+} rio_iov_t;
+/* $end rio_iov_t */
+
 /* Our own error-handling functions */
 void unix_error(char *msg);
 void posix_error(int code, char *msg);
@@ -178,6 +190,13 @@ ssize_t rio_writen(int fd, void *usrbuf, size_t n);
 void rio_readinitb(rio_t *rp, int fd); 
 ssize_t	rio_readnb(rio_t *rp, void *usrbuf, size_t n);
 ssize_t	rio_readlineb(rio_t *rp, void *usrbuf, size_t maxlen);
+ssize_t	rio_peekb(rio_t *rp, char **bufp);
+void	rio_consumeb(rio_t *rp, size_t n);
+void	rio_iovinit(rio_iov_t *v);
+int	rio_iovadd(rio_iov_t *v, void *buf, size_t len);
+int	rio_iovprintf(rio_iov_t *v, const char *fmt, ...);
+ssize_t	rio_iovflush(int fd, rio_iov_t *v);
+ssize_t	rio_writev(int fd, rio_iov_t *v);
 
 /* Wrappers for Rio package */
 ssize_t Rio_readn(int fd, void *usrbuf, size_t n);
@@ -0,0 +1,214 @@
+/*
+ * dns.c - 목적지 주소 조회 결과를 (host, port) 별로 보관하는 DNS 캐시
+ *
+ * 항목은 "host:port" 의 해시로 버킷에 나눠 두고, 표 전체를 하나의 락으로 보호한다.
+ * getaddrinfo 는 오래 걸릴 수 있으므로 락을 잡지 않은 채 부른다.
+ *
+ * TTL 이 지난 항목은 곧바로 미스로 처리하지 않는다. 마지막으로 성공한 결과를 돌려주면서
+ * 분리된 스레드 하나가 뒤에서 새로 조회하고, 끝나면 결과를 바꿔 끼운다.
+ * 바꿔 끼운 이전 결과는 그 결과로 connect 중인 쪽이 놓을 때 해제된다.
+ */
+#include "dns.h"
+#include "cache.h"
+
+/* 캐시 항목 하나 (host:port) */
+typedef struct dns_entry {
+    char *key;                      // "host:port"
+    uint64_t key_hash;
+    char *hostname;                 // 새로 조회할 때 쓸 이름과 포트 ("host\0port" 사본 하나를 나눠 가리킨다)
+    char *port;
+    dns_result_t *res;              // 마지막으로 성공한 결과 (실패를 기억하는 항목이면 NULL)
+    int err;                        // 실패한 조회의 getaddrinfo 에러 코드
+    time_t expires;                 // 이 시각까지는 res (또는 실패)를 그대로 쓴다
+    int refreshing;                 // 뒤에서 새로 조회하는 중이면 1
+    struct dns_entry *next;         // 같은 버킷의 다음 항목
+} dns_entry_t;
+
+static pthread_mutex_t dns_lock = PTHREAD_MUTEX_INITIALIZER;
+static dns_entry_t *dns_buckets[DNS_HASH_BUCKETS];
+
+static atomic_long dns_hits;        // 캐시된 결과(또는 실패)로 답한 조회 수
+static atomic_long dns_misses;      // getaddrinfo 를 직접 불러야 했던 조회 수
+
+
+/**
+ * getaddrinfo 로 목적지 주소를 조회하는 함수 (open_clientfd 와 같은 hints 를 쓴다)
+ *
+ * @param err 실패하면 getaddrinfo 에러 코드를 저장한다
+ * @return 새 결과 (캐시가 가질 참조 하나를 포함한다), 실패하면 NULL
+ */
+static dns_result_t *resolve(char *hostname, char *port, int *err) {
+    struct addrinfo hints, *addrs;
+    dns_result_t *res;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV | AI_ADDRCONFIG;
+    if ((*err = getaddrinfo(hostname, port, &hints, &addrs)) != 0) {
+        fprintf(stderr, "getaddrinfo failed (%s:%s): %s\n", hostname, port, gai_strerror(*err));
+        return NULL;
+    }
+
+    res = Malloc(sizeof(dns_result_t));
+    res->addrs = addrs;
+    atomic_init(&res->refcnt, 1);
+    return res;
+}
+
+/**
+ * 항목을 찾는 함수 (create 가 1 이면 없을 때 새로 만든다, dns_lock 을 잡은 채 호출)
+ */
+static dns_entry_t *find_entry(char *hostname, char *port, int create) {
+    char key[MAXLINE];
+    uint64_t hash;
+    dns_entry_t **bucket, *e;
+
+    snprintf(key, sizeof(key), "%s:%s", hostname, port);
+    hash = hash_uri(key);
+    bucket = &dns_buckets[hash & (DNS_HASH_BUCKETS - 1)];
+
+    for (e = *bucket; e != NULL; e = e->next) {
+        if (e->key_hash == hash && strcmp(e->key, key) == 0) {
+            return e;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    // key 를 "host\0port" 로 한 번 더 복사해 두면 새로 조회할 때 다시 나눌 필요가 없다.
+    e = Calloc(1, sizeof(dns_entry_t));
+    e->key = strdup(key);
+    e->key_hash = hash;
+    e->hostname = Malloc(strlen(key) + 1);
+    strcpy(e->hostname, hostname);
+    e->port = e->hostname + strlen(hostname) + 1;
+    strcpy(e->port, port);
+    e->next = *bucket;
+    *bucket = e;
+    return e;
+}
+
+/**
+ * 항목의 결과를 새 조회 결과로 바꾸는 함수 (dns_lock 을 잡은 채 호출)
+ */
+static void store_result(dns_entry_t *e, dns_result_t *res, int err, time_t now) {
+    if (e->res != NULL) {
+        dns_release(e->res);    // 캐시가 가지던 참조를 놓는다
+    }
+    e->res = res;
+    e->err = err;
+    e->expires = now + ((res != NULL) ? DNS_CACHE_TTL : DNS_NEGATIVE_TTL);
+}
+
+/**
+ * TTL 이 지난 항목을 뒤에서 새로 조회하는 스레드 함수
+ *
+ * 조회에 실패하면 이전 결과를 그대로 두어, 남은 유예 시간 동안은 계속 쓸 수 있게 한다.
+ */
+static void *refresh_thread(void *vargp) {
+    dns_entry_t *e = vargp;     // 항목은 표에서 빠지지 않으므로 락 없이 가리켜도 된다
+    dns_result_t *res;
+    int err;
+
+    Pthread_detach(pthread_self());
+
+    res = resolve(e->hostname, e->port, &err);
+
+    pthread_mutex_lock(&dns_lock);
+    if (res != NULL) {
+        store_result(e, res, 0, time(NULL));
+    }
+    e->refreshing = 0;
+    pthread_mutex_unlock(&dns_lock);
+    return NULL;
+}
+
+/**
+ * 캐시에서만 목적지 주소를 찾는 함수 (getaddrinfo 를 부르지 않으므로 블록되지 않는다)
+ *
+ * TTL 이 지났지만 유예 시간 안이면 이전 결과를 돌려주고 새 조회는 뒤에서 시작한다.
+ * 이벤트 루프는 이 함수로 먼저 찾아보고, 없을 때만 resolver 스레드에 조회를 맡긴다.
+ *
+ * @param res 캐시에 답이 있으면 고정된 조회 결과를 저장한다 (실패를 기억하는 항목이면 NULL)
+ * @param err 실패를 기억하는 항목이면 getaddrinfo 에러 코드를 저장한다
+ * @return 캐시에 답이 있으면 1 (실패 포함), 없으면 0
+ */
+int dns_lookup_cached(char *hostname, char *port, dns_result_t **res, int *err) {
+    dns_entry_t *e;
+    time_t now = time(NULL);
+    pthread_t tid;
+
+    pthread_mutex_lock(&dns_lock);
+    e = find_entry(hostname, port, 0);
+    if (e == NULL || (now >= e->expires && (e->res == NULL || now >= e->expires + DNS_STALE_GRACE))) {
+        pthread_mutex_unlock(&dns_lock);
+        return 0;
+    }
+
+    if (now >= e->expires && !e->refreshing) {
+        e->refreshing = 1;
+        if (pthread_create(&tid, NULL, refresh_thread, e) != 0) {
+            e->refreshing = 0;  // 다음 조회에서 다시 시도한다
+        }
+    }
+    if ((*res = e->res) != NULL) {
+        atomic_fetch_add(&e->res->refcnt, 1);
+    }
+    *err = e->err;
+    pthread_mutex_unlock(&dns_lock);
+
+    atomic_fetch_add(&dns_hits, 1);
+    return 1;
+}
+
+/**
+ * 목적지 주소를 조회하는 함수
+ *
+ * 캐시에 쓸 수 있는 결과가 있으면 getaddrinfo 없이 바로 돌려주고, 없으면 직접 조회한다.
+ *
+ * @param err 실패하면 getaddrinfo 에러 코드를 저장한다
+ * @return 고정된 조회 결과 (다 쓴 뒤 dns_release 호출), 실패하면 NULL
+ */
+dns_result_t *dns_lookup(char *hostname, char *port, int *err) {
+    dns_entry_t *e;
+    dns_result_t *res;
+
+    // 1. 캐시에서 찾는다.
+    if (dns_lookup_cached(hostname, port, &res, err)) {
+        return res;
+    }
+
+    // 2. 캐시 미스: 락 없이 직접 조회한 뒤 결과(실패 포함)를 캐시에 넣는다.
+    atomic_fetch_add(&dns_misses, 1);
+    res = resolve(hostname, port, err);
+
+    pthread_mutex_lock(&dns_lock);
+    e = find_entry(hostname, port, 1);
+    store_result(e, res, *err, time(NULL));
+    if (res != NULL) {
+        atomic_fetch_add(&res->refcnt, 1);  // 호출한 쪽이 가질 참조
+    }
+    pthread_mutex_unlock(&dns_lock);
+    return res;
+}
+
+/**
+ * dns_lookup 이 돌려준 결과를 놓는 함수
+ *
+ * 마지막 참조가 사라지면(캐시에서도 바뀌었으면) 주소 목록을 해제한다.
+ */
+void dns_release(dns_result_t *res) {
+    if (atomic_fetch_sub(&res->refcnt, 1) == 1) {
+        freeaddrinfo(res->addrs);
+        free(res);
+    }
+}
+
+/**
+ * 지금까지의 캐시 히트/미스 수를 얻는 함수
+ */
+void dns_stats(long *hits, long *misses) {
+    *hits = atomic_load(&dns_hits);
+    *misses = atomic_load(&dns_misses);
+}
@@ -0,0 +1,34 @@
+/*
+ * dns.h - 목적지 주소 조회 결과를 (host, port) 별로 보관하는 DNS 캐시
+ *
+ * 캐시 미스마다 getaddrinfo 를 부르면 느린 resolver 응답이 그대로 미스 지연이 되고,
+ * 같은 이름을 계속 묻게 되어 로컬 resolver 에도 부담이 된다.
+ * 조회 결과는 DNS_CACHE_TTL 초 동안 그대로 쓰고, 그 뒤 DNS_STALE_GRACE 초 동안은
+ * 뒤에서 새로 조회하는 동안 마지막으로 성공한 결과를 계속 돌려준다.
+ * 실패한 조회도 DNS_NEGATIVE_TTL 초 동안 기억해 같은 실패를 반복해서 묻지 않는다.
+ *
+ * dns_lookup 이 돌려준 결과는 참조 카운트로 고정되어 있으므로, 다 쓴 뒤 반드시 dns_release 를 호출해야 한다.
+ */
+#ifndef __DNS_H__
+#define __DNS_H__
+
+#include <stdatomic.h>
+#include "csapp.h"
+
+#define DNS_CACHE_TTL       60      // 조회 결과를 그대로 쓰는 시간 (초)
+#define DNS_STALE_GRACE     300     // TTL 이 지난 뒤 새로 조회하는 동안 이전 결과를 쓸 수 있는 시간 (초)
+#define DNS_NEGATIVE_TTL    5       // 실패한 조회를 기억하는 시간 (초)
+#define DNS_HASH_BUCKETS    256     // 캐시 표의 버킷 수 (2의 거듭제곱)
+
+/* 조회 결과 하나 (캐시와 그 결과로 connect 중인 쪽이 함께 가리킨다) */
+typedef struct {
+    struct addrinfo *addrs;         // getaddrinfo 결과 (목적지 주소 목록)
+    atomic_int refcnt;              // 캐시 자신(1) + 이 결과를 쓰고 있는 쪽의 수
+} dns_result_t;
+
+dns_result_t *dns_lookup(char *hostname, char *port, int *err);
+int dns_lookup_cached(char *hostname, char *port, dns_result_t **res, int *err);
+void dns_release(dns_result_t *res);
+void dns_stats(long *hits, long *misses);
+
+#endif /* __DNS_H__ */
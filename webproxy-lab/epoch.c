@@ -0,0 +1,180 @@
+/*
+ * epoch.c - epoch 기반 지연 해제 (epoch-based reclamation)
+ *
+ * 전역 epoch 는 계속 증가하는 정수다. 스레드마다 레코드가 하나씩 있고,
+ * 임계 구역에 들어갈 때 그때의 전역 epoch 를 자기 레코드에 적는다.
+ *
+ * 전역 epoch 를 e 에서 e+1 로 올리려면 임계 구역 안의 모든 스레드가 e 를 보고 있어야 한다.
+ * 그러면 epoch e-1 이하에서 retire 된 객체는 어떤 스레드도 가리킬 수 없으므로 해제할 수 있다.
+ * (retire 된 객체는 이미 공유 구조에서 떨어져 있으므로, 그 뒤에 들어온 스레드는 찾을 수 없다.)
+ *
+ * 읽는 쪽은 자기 레코드에만 쓰기 때문에 여러 코어가 같은 캐시 라인을 두고 다투지 않는다.
+ * retire 와 epoch 전진은 드물게 일어나는 쓰기 쪽 작업이라 mutex 로 보호한다.
+ */
+#include <stdatomic.h>
+#include "csapp.h"
+#include "epoch.h"
+
+/* 스레드 하나의 epoch 레코드 */
+typedef struct epoch_record {
+    atomic_ulong epoch;             // 임계 구역에 들어갈 때 본 전역 epoch
+    atomic_int active;              // 임계 구역 안에 있으면 1
+    atomic_int in_use;              // 살아 있는 스레드가 이 레코드를 쓰고 있으면 1
+    struct epoch_record *next;      // 전체 레코드 목록 (추가만 하고 빼지 않는다)
+} epoch_record_t;
+
+/* 해제를 기다리는 객체 */
+typedef struct retired {
+    void *ptr;
+    void (*free_fn)(void *);
+    unsigned long epoch;            // retire 될 때의 전역 epoch
+    struct retired *next;
+} retired_t;
+
+static atomic_ulong global_epoch = 1;
+static _Atomic(epoch_record_t *) records;              // 모든 스레드의 레코드
+static _Thread_local epoch_record_t *my_record;        // 이 스레드의 레코드
+
+static pthread_mutex_t limbo_lock = PTHREAD_MUTEX_INITIALIZER;
+static retired_t *limbo;                               // 해제를 기다리는 객체 목록
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t record_key;                       // 스레드 종료 시 레코드를 반납하기 위한 키
+
+
+/**
+ * 스레드가 끝날 때 레코드를 다른 스레드가 다시 쓸 수 있게 반납하는 함수
+ */
+static void release_record(void *vargp) {
+    epoch_record_t *rec = vargp;
+
+    atomic_store(&rec->active, 0);
+    atomic_store(&rec->in_use, 0);
+}
+
+static void make_key() {
+    pthread_key_create(&record_key, release_record);
+}
+
+/**
+ * 이 스레드의 레코드를 찾거나 새로 만드는 함수
+ *
+ * 연결마다 스레드를 만드는 thread 모드에서도 레코드가 끝없이 늘지 않도록,
+ * 끝난 스레드가 반납한 레코드를 먼저 재사용한다.
+ */
+static epoch_record_t *get_record() {
+    epoch_record_t *rec;
+    int unused = 0;
+
+    if (my_record != NULL) {
+        return my_record;
+    }
+
+    Pthread_once(&key_once, make_key);
+
+    for (rec = atomic_load(&records); rec != NULL; rec = rec->next) {
+        unused = 0;
+        if (atomic_compare_exchange_strong(&rec->in_use, &unused, 1)) {
+            break;
+        }
+    }
+
+    if (rec == NULL) {
+        rec = Calloc(1, sizeof(epoch_record_t));
+        atomic_init(&rec->in_use, 1);
+        rec->next = atomic_load(&records);
+        while (!atomic_compare_exchange_weak(&records, &rec->next, rec))
+            ;
+    }
+
+    pthread_setspecific(record_key, rec);
+    my_record = rec;
+    return rec;
+}
+
+/**
+ * 락 없는 읽기 임계 구역에 들어가는 함수
+ *
+ * 중첩해서 부르면 안 된다.
+ */
+void epoch_enter() {
+    epoch_record_t *rec = get_record();
+
+    atomic_store(&rec->epoch, atomic_load(&global_epoch));
+    atomic_store(&rec->active, 1);
+}
+
+/**
+ * 읽기 임계 구역에서 나오는 함수
+ */
+void epoch_exit() {
+    atomic_store_explicit(&my_record->active, 0, memory_order_release);
+}
+
+/**
+ * 모든 활성 스레드가 현재 epoch 를 보고 있으면 전역 epoch 를 올리고,
+ * 두 epoch 이전에 retire 된 객체들을 해제하는 함수
+ *
+ * limbo_lock 을 잡은 상태에서 호출해야 한다.
+ */
+static void try_advance() {
+    unsigned long e = atomic_load(&global_epoch);
+    epoch_record_t *rec;
+    retired_t **pp, *r;
+
+    for (rec = atomic_load(&records); rec != NULL; rec = rec->next) {
+        if (atomic_load(&rec->active) && atomic_load(&rec->epoch) != e) {
+            return;     // 아직 이전 epoch 에 머물러 있는 스레드가 있다
+        }
+    }
+
+    atomic_store(&global_epoch, e + 1);
+
+    // 이제 모든 스레드는 e 이상에 있으므로 e-1 이하에서 retire 된 객체는 안전하다.
+    pp = &limbo;
+    while ((r = *pp) != NULL) {
+        if (r->epoch < e) {
+            *pp = r->next;
+            r->free_fn(r->ptr);
+            free(r);
+        } else {
+            pp = &r->next;
+        }
+    }
+}
+
+/**
+ * 공유 구조에서 떼어 낸 객체의 해제를 예약하는 함수
+ *
+ * @param ptr 해제할 객체
+ * @param free_fn 안전해졌을 때 ptr 을 해제할 함수
+ */
+void epoch_retire(void *ptr, void (*free_fn)(void *)) {
+    retired_t *r = Malloc(sizeof(retired_t));
+
+    r->ptr = ptr;
+    r->free_fn = free_fn;
+
+    pthread_mutex_lock(&limbo_lock);
+    r->epoch = atomic_load(&global_epoch);
+    r->next = limbo;
+    limbo = r;
+    try_advance();
+    pthread_mutex_unlock(&limbo_lock);
+}
+
+/**
+ * 해제를 기다리는 객체가 있으면 epoch 를 전진시켜 회수를 시도하는 함수
+ *
+ * 메모리가 부족할 때 쓰기 쪽에서 호출한다.
+ */
+void epoch_reclaim() {
+    int i;
+
+    pthread_mutex_lock(&limbo_lock);
+    // 읽는 스레드가 없으면 두 번 전진하면 limbo 가 모두 비워진다.
+    for (i = 0; i < 2 && limbo != NULL; i++) {
+        try_advance();
+    }
+    pthread_mutex_unlock(&limbo_lock);
+}
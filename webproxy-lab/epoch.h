@@ -0,0 +1,16 @@
+/*
+ * epoch.h - epoch 기반 지연 해제 (epoch-based reclamation)
+ *
+ * 락 없이 공유 자료구조를 읽는 스레드는 epoch_enter/epoch_exit 사이에서만 포인터를 따라간다.
+ * 구조에서 떼어 낸 객체는 바로 free 하지 않고 epoch_retire 로 넘기면,
+ * 그 시점에 읽고 있던 스레드가 모두 임계 구역을 빠져나간 뒤에 해제된다.
+ */
+#ifndef __EPOCH_H__
+#define __EPOCH_H__
+
+void epoch_enter();
+void epoch_exit();
+void epoch_retire(void *ptr, void (*free_fn)(void *));
+void epoch_reclaim();
+
+#endif /* __EPOCH_H__ */
@@ -0,0 +1,1083 @@
+/*
+ * evloop.c - edge-triggered epoll 기반 이벤트 루프 엔진
+ *
+ * 연결마다 스레드를 만드는 대신 모든 소켓을 non-blocking 으로 만들고,
+ * 하나의 스레드가 epoll 로 준비된 소켓만 골라 처리한다.
+ * handle_client_request 의 흐름(요청 읽기 → 캐시 조회 → 목적지 연결 → 전달 → 종료)을
+ * 연결별 상태 기계로 나누고, 더 진행할 수 없으면(EAGAIN) 다음 이벤트를 기다린다.
+ * keep-alive 연결은 응답을 보낸 뒤 종료 대신 다시 요청 읽기 단계로 돌아간다.
+ *
+ * edge-triggered 모드에서는 준비 상태가 "바뀔 때"만 알림이 오므로,
+ * 각 단계는 항상 EAGAIN 이 나올 때까지 읽고 써야 한다.
+ *
+ * 제한 시간(keep-alive 유휴, 연결, 첫 바이트, 전송 중 유휴, 요청 전체)은 연결마다 타이머 하나로 잰다.
+ * 상태 기계가 멈출 때마다 지금 상태에서 가장 이른 제한 시각으로 타이머를 다시 맞추고,
+ * 타이밍 휠에서 맞추기와 지우기는 O(1) 이므로 연결 수가 많아도 비용이 거의 없다.
+ */
+#include "proxy.h"
+#include "flight.h"
+#include "framer.h"
+#include "upstream.h"
+#include "dns.h"
+#include "resolver.h"
+#include "connect.h"
+#include "timer.h"
+#include "relay.h"
+#include "range.h"
+#include "iobuf.h"
+#include "respfilter.h"
+#include <sys/epoll.h>
+
+#define MAX_EVENTS 256
+#define SEND_DONE (-1)      // send_filtered: 받은 조각을 다 보냈다 (단계 함수는 계속 진행한다)
+
+/* 연결 하나가 거치는 상태 */
+typedef enum {
+    ST_READ_REQUEST,    // 클라이언트의 요청 라인과 헤더를 모으는 중
+    ST_RESOLVING,       // resolver 스레드가 목적지 주소를 조회하는 중
+    ST_CONNECTING,      // 목적지 서버와 non-blocking connect 진행 중
+    ST_SEND_REQUEST,    // 재조립한 요청을 목적지 서버로 보내는 중
+    ST_FORWARD,         // 목적지 서버의 응답을 클라이언트로 전달하는 중
+    ST_SPLICE,          // 캐시하지 않을 응답의 본문을 splice 로 옮기는 중
+    ST_FOLLOW,          // 같은 URI 를 받아 오는 leader 의 버퍼를 따라 클라이언트로 전달하는 중
+    ST_REPLY,           // 캐시 히트 또는 에러 응답을 클라이언트로 보내는 중
+    ST_CLOSED           // 종료됨 (이번 이벤트 묶음 처리가 끝나면 해제)
+} conn_state_t;
+
+/* 각 단계 함수의 반환값 */
+enum {
+    STEP_NEXT,          // 상태가 바뀌었으니 바로 다음 단계를 진행
+    STEP_BLOCK,         // EAGAIN: 다음 이벤트를 기다린다
+    STEP_CLOSE          // 연결을 정리한다
+};
+
+/* 클라이언트 연결 하나의 상태 */
+typedef struct conn {
+    conn_state_t state;
+    int client_fd;                  // 클라이언트 소켓
+    int server_fd;                  // 목적지 서버 소켓 (-1 이면 아직 없음)
+    int reused;                     // server_fd 를 keep-alive 풀에서 꺼냈으면 1
+
+    char req[MAXBUF];               // 클라이언트의 요청 헤더를 모으는 버퍼 (뒤에 pipelined 요청이 이어질 수 있다)
+    int req_len;
+    int hdr_len;                    // 지금 처리 중인 요청의 헤더 길이 (빈 줄 포함)
+    char *uri;                      // 캐시 키로 사용할 요청 URI
+    int keep_alive;                 // 클라이언트가 응답 뒤에도 연결을 유지하려 하면 1
+    int persistent;                 // ST_REPLY 로 보내는 응답이 끝난 뒤에도 연결을 쓸 수 있으면 1
+
+    resolve_job_t *job;             // ST_RESOLVING: resolver 에 맡긴 조회 (끝나면 NULL)
+    dns_result_t *addrs;            // DNS 캐시에서 고정해 둔 조회 결과 (목적지 주소 목록)
+    connrace_t race;                // ST_CONNECTING: 목적지 주소들 사이의 연결 경쟁
+
+    char out[MAXBUF];               // 목적지로 보낼 요청, 또는 클라이언트로 보낼 응답 조각
+    int out_len;
+    int out_off;                    // 응답 조각이면 respfilter 가 소비한 바이트 수
+
+    respfilter_t rf;                // 클라이언트에게 보낼 응답의 hop-by-hop 헤더를 고쳐 쓰는 필터 (Range 응답의 조각들도 담는다)
+    char *reply;                    // ST_REPLY 에서 보낼 데이터 (캐시 객체 또는 에러 응답)
+    int reply_len;
+    int reply_off;
+    CacheBlock *pinned;             // 히트를 보내는 동안 고정해 둔 캐시 블록 (없으면 NULL)
+
+    flight_t *flight;               // 참여 중인 in-flight 요청 (없으면 NULL)
+    int leader;                     // flight 의 leader 면 1 (응답을 flight 버퍼에 채운다)
+    flight_waiter_t waiter;         // follower 로서 leader 의 진행을 기다리는 대기자
+    char *saved_req;                // 다시 보내야 할 때를 위한 요청 (follower 가 직접 받아 오거나 풀 연결이 닫혔을 때)
+    int sent;                       // follower: 클라이언트에게 넘긴 바이트 수
+
+    iobuf_t in;                     // ST_FORWARD: 목적지에서 읽은 조각 (보내는 동안만 풀의 버퍼를 빌린다)
+    framer_t fr;                    // ST_FORWARD: 목적지 응답의 끝을 찾는 파서
+    int got;                        // ST_FORWARD: 목적지에서 받은 바이트 수
+    int extra;                      // ST_FORWARD: 응답 뒤에 남는 바이트가 있었으면 1 (연결을 다시 쓰지 않는다)
+    relay_t relay;                  // ST_SPLICE: 목적지 소켓과 클라이언트 소켓 사이의 파이프
+
+    int racing;                     // 연결 경쟁 중이면 1 (race 의 시도 소켓들을 닫아야 한다)
+    int replied;                    // 이번 요청의 응답을 클라이언트에게 보내기 시작했으면 1
+
+    tw_timer_t timer;               // 지금 상태에서 가장 이른 제한 시각에 울리는 타이머
+    long idle_since;                // ST_READ_REQUEST 에 들어온 시각 (ms, keep-alive 유휴 시간의 기준)
+    long req_start;                 // 요청 헤더를 다 읽은 시각 (요청 전체 제한 시간의 기준)
+    long connect_start;             // 주소 조회를 시작한 시각 (연결 제한 시간의 기준)
+    long sent_at;                   // 요청을 다 보낸 시각 (첫 바이트 제한 시간의 기준)
+    long last_io;                   // 마지막으로 데이터가 오간 시각 (전송 중 유휴 시간의 기준)
+
+    int woken;                      // 깨울 목록에 들어 있으면 1
+    struct conn *next_woken;        // 이번 이벤트 묶음 뒤에 진행할 follower 목록
+    struct conn *next_closed;       // 해제 대기 목록
+} conn_t;
+
+static int epfd;                    // epoll 인스턴스
+static char resolver_tag;           // resolver eventfd 의 이벤트를 구분하기 위한 표시 (&resolver_tag)
+static conn_t *closed_conns;        // 이번 이벤트 묶음에서 닫힌 연결들
+static conn_t *woken_conns;         // leader 가 새 데이터를 받아 깨운 follower 들
+static timer_wheel_t wheel;         // 연결들의 제한 시간 타이머
+static long loop_now;               // 이번 이벤트 묶음을 처리하기 시작한 시각 (ms)
+
+static int conn_drive(conn_t *c);
+static int start_fetch(conn_t *c);
+static int connect_origin(conn_t *c);
+static int resolved(conn_t *c);
+static void resolve_done(void *arg, dns_result_t *res, int err);
+
+
+/**
+ * 파일 디스크립터를 non-blocking 모드로 바꾸는 함수
+ *
+ * @param fd 대상 파일 디스크립터
+ * @return 성공하면 0, 실패하면 -1
+ */
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags < 0) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/**
+ * 소켓을 edge-triggered 모드로 epoll 에 등록하는 함수
+ *
+ * 읽기/쓰기 준비를 한 번에 등록해 두고, 어느 쪽 이벤트가 오든 conn_drive 가
+ * 현재 상태에서 할 수 있는 만큼 진행한다. 그래서 이후에 epoll_ctl(MOD) 이 필요 없다.
+ *
+ * @param fd 등록할 소켓
+ * @param ptr 이벤트와 함께 돌려받을 포인터 (리스닝 소켓은 NULL)
+ */
+static int epoll_add(int fd, void *ptr) {
+    struct epoll_event ev;
+
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = ptr;
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+/**
+ * 참여 중인 flight 에서 빠지는 함수
+ *
+ * leader 가 빠지면 flight 가 끝나고, 응답을 끝까지 받았으면(ok) 캐시에 추가된다.
+ */
+static void drop_flight(conn_t *c, int ok) {
+    if (c->flight == NULL) {
+        return;
+    }
+    if (c->leader) {
+        flight_finish(c->flight, ok);
+    } else {
+        flight_unwatch(c->flight, &c->waiter);
+        flight_release(c->flight);
+    }
+    c->flight = NULL;
+}
+
+/**
+ * leader 가 새 데이터를 받았을 때 follower 를 깨우는 함수 (flight_waiter_t 의 wake)
+ *
+ * 이벤트 루프는 스레드 하나뿐이라 leader 가 진행하는 도중에 호출된다.
+ * 그 자리에서 follower 를 진행하지 않고 목록에 넣어 두었다가 이벤트 묶음 처리가 끝난 뒤 진행한다.
+ */
+static void conn_wake(void *arg) {
+    conn_t *c = arg;
+
+    if (!c->woken) {
+        c->woken = 1;
+        c->next_woken = woken_conns;
+        woken_conns = c;
+    }
+}
+
+/**
+ * 목적지 쪽 자원(주소 조회, 연결 시도, 목적지 소켓)을 놓는 함수
+ */
+static void release_origin(conn_t *c) {
+    if (c->racing) {
+        c->racing = 0;
+        connrace_abort(&c->race);   // 아직 진행 중인 시도 소켓들을 닫는다
+    }
+    if (c->job != NULL) {
+        resolver_cancel(c->job);    // 조회가 끝나도 이 연결은 깨우지 않는다
+        c->job = NULL;
+    }
+    if (c->server_fd >= 0) {
+        Close(c->server_fd);
+        c->server_fd = -1;
+    }
+    relay_close(&c->relay);
+    iobuf_release(&c->in);
+}
+
+/**
+ * 요청 하나를 처리하면서 잡은 자원(목적지 소켓, 캐시 블록, flight 등)을 놓는 함수
+ */
+static void release_request(conn_t *c) {
+    release_origin(c);
+    if (c->addrs != NULL) {
+        dns_release(c->addrs);
+        c->addrs = NULL;
+    }
+    free(c->uri);
+    c->uri = NULL;
+    if (c->pinned != NULL) {
+        release_cache_block(c->pinned);     // reply 는 블록 안을 가리키므로 free 하지 않는다
+        c->pinned = NULL;
+    } else {
+        free(c->reply);
+    }
+    c->reply = NULL;
+    drop_flight(c, 0);
+    free(c->saved_req);
+    c->saved_req = NULL;
+}
+
+/**
+ * 연결을 닫고 해제 대기 목록에 넣는 함수
+ *
+ * 같은 이벤트 묶음 안에 이 연결의 다른 소켓 이벤트가 남아 있을 수 있으므로
+ * 바로 free 하지 않고, 묶음 처리가 끝난 뒤 free_closed_conns 에서 해제한다.
+ * close() 하면 epoll 등록도 자동으로 해제된다.
+ */
+static void conn_close(conn_t *c) {
+    timer_del(&wheel, &c->timer);
+    Close(c->client_fd);
+    release_request(c);
+
+    c->state = ST_CLOSED;
+    c->next_closed = closed_conns;
+    closed_conns = c;
+}
+
+/**
+ * 응답을 다 보낸 뒤 연결을 닫을지, 다음 요청을 읽을지 정하는 함수
+ *
+ * 클라이언트는 응답 헤더를 보고 연결을 계속 쓸지 정하므로, 클라이언트가 keep-alive 를 원하고
+ * 클라이언트가 보낸 응답의 끝을 알 수 있을 때만 연결을 유지한다 (respfilter 가 헤더에 적은 판단). 이미 받아 둔 pipelined 요청은 앞으로 당겨
+ * 바로 처리한다. edge-triggered 모드에서는 버퍼에 남은 요청에 대해 새 이벤트가 오지 않기 때문이다.
+ *
+ * @param persistent 보낸 응답이 끝난 뒤에도 연결을 쓸 수 있으면 1
+ */
+static int finish_request(conn_t *c, int persistent) {
+    if (!c->keep_alive || !persistent) {
+        return STEP_CLOSE;
+    }
+
+    release_request(c);
+    c->req_len -= c->hdr_len;
+    memmove(c->req, c->req + c->hdr_len, c->req_len);
+    c->req[c->req_len] = '\0';
+    c->hdr_len = 0;
+    c->keep_alive = c->persistent = 0;
+    c->leader = c->reused = 0;
+    c->sent = 0;
+    c->replied = 0;
+    c->out_len = c->out_off = 0;
+    c->reply_len = c->reply_off = 0;
+
+    c->state = ST_READ_REQUEST;
+    c->idle_since = loop_now;
+    return STEP_NEXT;
+}
+
+/**
+ * 연결의 지금 상태에서 가장 이른 제한 시각(ms)을 구하는 함수
+ *
+ * 요청을 기다리는 동안은 keep-alive 유휴 시간만 재고, 요청을 받은 뒤에는
+ * 요청 전체의 제한 시각과 지금 단계의 제한 시각 중 이른 쪽을 쓴다.
+ * - 주소 조회와 connect: 연결 제한 시간
+ * - 응답의 첫 바이트를 기다리는 중: 첫 바이트 제한 시간
+ * - 그 밖에 주고받는 중: 마지막으로 데이터가 오간 뒤의 유휴 시간
+ * follower 가 leader 를 기다리는 동안은 leader 의 제한 시간이 대신 재므로 요청 전체만 잰다.
+ */
+static long conn_deadline(conn_t *c) {
+    long deadline, phase;
+
+    if (c->state == ST_READ_REQUEST) {
+        return c->idle_since + CLIENT_IDLE_TIMEOUT * 1000L;
+    }
+
+    deadline = c->req_start + config.request_timeout_ms;
+    if (c->state == ST_RESOLVING || c->state == ST_CONNECTING) {
+        phase = c->connect_start + config.connect_timeout_ms;
+    } else if (c->state == ST_FORWARD && c->out_off == c->out_len && c->got == 0) {
+        phase = c->sent_at + config.first_byte_timeout_ms;
+    } else if (c->state == ST_FOLLOW && c->out_off == c->out_len) {
+        phase = deadline;
+    } else {
+        phase = c->last_io + config.idle_timeout_ms;
+    }
+    return (phase < deadline) ? phase : deadline;
+}
+
+/**
+ * 상태 기계가 멈출 때 연결의 타이머를 다시 맞추는 함수
+ *
+ * 연결 경쟁 중이면 stagger / 시도 제한 시각에도 깨어나 경쟁을 진행해야 한다.
+ */
+static void conn_arm(conn_t *c) {
+    long expires = conn_deadline(c), race;
+
+    if (c->racing && (race = connrace_deadline(&c->race)) < expires) {
+        expires = race;
+    }
+    timer_set(&wheel, &c->timer, expires);
+}
+
+/**
+ * 다음 epoll_wait 가 기다릴 시간(ms)을 정하는 함수 (가장 이른 타이머까지만 기다린다)
+ */
+static int next_timeout() {
+    long expires = timer_next_expiry(&wheel), now;
+
+    if (expires < 0) {
+        return -1;
+    }
+    now = monotonic_ms();
+    return (expires > now) ? expires - now : 0;
+}
+
+/**
+ * 이번 이벤트 묶음에서 닫힌 연결들을 실제로 해제하는 함수
+ */
+static void free_closed_conns() {
+    while (closed_conns != NULL) {
+        conn_t *c = closed_conns;
+        closed_conns = c->next_closed;
+        free(c);
+    }
+}
+
+/**
+ * 클라이언트에게 보낼 응답을 준비하고 ST_REPLY 로 넘어가는 함수
+ *
+ * @param data 보낼 데이터 (malloc 으로 할당된 버퍼면 소유권이 연결로 넘어온다)
+ * @param len 데이터의 길이
+ */
+static int start_reply(conn_t *c, char *data, int len) {
+    c->last_io = loop_now;
+    c->reply = data;
+    c->reply_len = len;
+    c->reply_off = 0;
+    c->state = ST_REPLY;
+    return STEP_NEXT;
+}
+
+/**
+ * 에러 응답을 만들어 ST_REPLY 로 넘어가는 함수
+ */
+static int start_error(conn_t *c, char *cause, char *errnum, char *shortmsg, char *longmsg) {
+    drop_flight(c, 0);          // leader 라면 기다리는 follower 들도 직접 받아 오게 한다
+
+    if (c->replied) {
+        return STEP_CLOSE;      // 응답을 보내기 시작했다면 에러 응답을 끼워 넣을 수 없다.
+    }
+
+    char *buf = Malloc(MAXBUF + MAXLINE);
+    int len = format_clienterror(buf, MAXBUF + MAXLINE, cause, errnum, shortmsg, longmsg);
+
+    return start_reply(c, buf, len);
+}
+
+/**
+ * 목적지 응답의 조각을 respfilter 에 넣어 가며 클라이언트에게 보내는 함수
+ *
+ * 필터가 채운 조각들(rf.out)을 다 보낸 뒤에 다음 바이트를 넣는다. 쓰기가 막혔다가 다시 불리면
+ * 보내다 만 조각부터 이어 보내므로, 호출한 쪽은 그동안 buf 를 그대로 두어야 한다.
+ * 헤더가 너무 커서 고쳐 쓸 수 없으면 (아직 아무것도 보내지 않았으므로) 502 응답으로 넘어간다.
+ *
+ * @param buf 보낼 응답 조각
+ * @param off buf 에서 필터가 소비한 바이트 수 (갱신된다)
+ * @param len buf 의 길이
+ * @return 다 보냈으면 SEND_DONE, 아니면 단계 함수가 그대로 돌려줄 값
+ */
+static int send_filtered(conn_t *c, char *buf, int *off, int len) {
+    int used;
+
+    while (1) {
+        if (c->rf.out.iovcur < c->rf.out.iovcnt) {
+            if (rio_iovflush(c->client_fd, &c->rf.out) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return (errno == EAGAIN) ? STEP_BLOCK : STEP_CLOSE;
+            }
+            c->last_io = loop_now;
+            c->replied = 1;
+            continue;
+        }
+        if (*off == len) {
+            return SEND_DONE;
+        }
+        if ((used = respfilter_feed(&c->rf, buf + *off, len - *off)) < 0) {
+            return start_error(c, c->uri, "502", "Bad Gateway", "Response header from the host is too large");
+        }
+        *off += used;
+    }
+}
+
+/**
+ * 얻은 주소들 사이의 연결 경쟁을 시작하는 함수
+ *
+ * 시도 소켓은 만들 때마다 epoll 에 등록되므로, handshake 가 끝나면 EPOLLOUT 이벤트가 온다.
+ * stagger 와 시도별 제한 시간은 소켓 이벤트와 상관없이 지나가므로 conn_arm 이 연결의 타이머를
+ * 그 시각에도 맞춰 이벤트 루프가 시각에 맞춰 진행하게 한다.
+ */
+static int start_connect(conn_t *c) {
+    connrace_init(&c->race, c->addrs->addrs, config.connect_stagger_ms, config.connect_attempt_ms);
+    c->racing = 1;
+    c->state = ST_CONNECTING;
+    return STEP_NEXT;
+}
+
+/**
+ * 연결 경쟁이 새 시도 소켓을 만들 때 부르는 함수 (connrace_step 의 on_start)
+ */
+static int race_start_fd(int fd, void *arg) {
+    return epoll_add(fd, arg);
+}
+
+/**
+ * 모은 요청 헤더를 해석하고 캐시 조회 또는 목적지 연결을 시작하는 함수
+ *
+ * handle_client_request 의 요청 처리 부분과 같은 일을 메모리 버퍼 위에서 한다.
+ */
+static int handle_request(conn_t *c, http_request_t *req) {
+    char method[MAXLINE], uri[MAXLINE];
+    char other_header[MAXLINE];
+    char hostname[MAXLINE], port[MAXLINE], path[MAXLINE];
+    CacheBlock *cache_block;
+
+    // 1. 파서가 나눈 요청 라인에서 메서드와 URI 를 꺼낸다.
+    copy_request_line(req, method, uri);
+    printf("Request headers:\n");
+    printf("%s %s HTTP/1.%d\n", method, uri, req->minor_version);
+
+    // 2. GET 메서드가 아니면 에러를 보낸다.
+    if (strcasecmp(method, "GET") != 0) {
+        return start_error(c, method, "501", "Not implemented", "Tiny does not implement this method");
+    }
+
+    // 3. 나머지 헤더 중 목적지로 전달할 헤더만 모은다.
+    //    버리는 헤더 가운데 Connection 계열은 클라이언트 연결을 유지할지 정하는 데 쓴다.
+    c->keep_alive = (req->minor_version >= 1);
+    filter_headers(req->headers, req->num_headers, other_header, sizeof(other_header), &c->keep_alive);
+    respfilter_init(&c->rf, req->minor_version == 0, c->keep_alive);
+
+    c->uri = strdup(uri);
+
+    // 4. 캐시 히트면 저장된 객체를 respfilter 로 헤더를 고쳐 쓰면서 보낸다.
+    //    블록은 고정되어 있으므로 전송 도중 evict 되어도 연결을 닫을 때까지 해제되지 않는다.
+    //    Range 요청이면 새로 쓴 헤더와 블록 안의 구간을 가리키는 조각들로 206 응답을 만들어 writev 로 보낸다.
+    //    206 / 416 은 길이가 정해져 있으므로 클라이언트가 원하는 대로 연결을 유지한다.
+    if ((cache_block = find_cache_block(uri)) != NULL) {
+        c->pinned = cache_block;
+        if (range_requested(other_header)) {
+            if (range_reply(cache_block->object_data, cache_block->object_size, other_header,
+                            c->keep_alive, &c->rf.out)) {
+                c->persistent = 1;
+                return start_reply(c, NULL, 0);
+            }
+            rio_iovinit(&c->rf.out);
+        }
+        return start_reply(c, cache_block->object_data, cache_block->object_size);
+    }
+
+    // 5. 캐시 미스: 목적지 서버로 보낼 요청을 조립한다.
+    parse_uri(uri, hostname, port, path);
+    reassemble(c->out, path, hostname, other_header);
+    c->out_len = strlen(c->out);
+    c->out_off = 0;
+
+    // 6. 같은 URI 를 이미 받아 오고 있는 연결이 있으면 그 응답을 따라 읽는다.
+    //    Range 요청은 응답(객체의 일부)이 다르고 캐시하지도 않으므로 flight 없이 직접 받아 온다.
+    c->saved_req = strdup(c->out);
+    if (range_requested(other_header)) {
+        return start_fetch(c);
+    }
+    c->flight = flight_join(uri, &c->leader);
+    if (!c->leader) {
+        c->out_len = c->out_off = 0;
+        c->waiter.wake = conn_wake;
+        c->waiter.arg = c;
+        flight_watch(c->flight, &c->waiter);
+        c->state = ST_FOLLOW;
+        return STEP_NEXT;
+    }
+
+    return start_fetch(c);
+}
+
+/**
+ * 목적지 연결을 준비하는 함수 (보낼 요청은 c->out 에 준비되어 있어야 한다)
+ *
+ * keep-alive 풀에 같은 목적지로 가는 유휴 연결이 있으면 주소 조회와 connect 없이 바로 요청을 보낸다.
+ */
+static int start_fetch(conn_t *c) {
+    char hostname[MAXLINE], port[MAXLINE], path[MAXLINE];
+    int fd;
+
+    parse_uri(c->uri, hostname, port, path);
+
+    if ((fd = upstream_get(hostname, port)) >= 0) {
+        if (set_nonblocking(fd) < 0 || epoll_add(fd, c) < 0) {
+            Close(fd);
+            return connect_origin(c);
+        }
+        c->server_fd = fd;
+        c->reused = 1;
+        c->last_io = loop_now;
+        c->state = ST_SEND_REQUEST;
+        return STEP_NEXT;
+    }
+    return connect_origin(c);
+}
+
+/**
+ * 풀에서 꺼낸 연결을 서버가 이미 닫았을 때 새 연결로 요청을 다시 보내는 함수
+ *
+ * 서버가 응답을 한 바이트도 보내지 않았을 때만 부른다. 그래야 클라이언트가 받은 내용이 없다.
+ */
+static int retry_fetch(conn_t *c) {
+    Close(c->server_fd);
+    c->server_fd = -1;
+    c->reused = 0;
+    strcpy(c->out, c->saved_req);
+    c->out_len = strlen(c->out);
+    c->out_off = 0;
+    return connect_origin(c);
+}
+
+/**
+ * 목적지 주소를 얻고 새 연결을 시작하는 함수
+ *
+ * DNS 캐시에 답이 있으면 바로 connect 를 시작한다. 없으면 조회를 resolver 스레드에 맡기고
+ * ST_RESOLVING 에서 기다린다. 그래서 느린 DNS 응답이 이벤트 루프를 멈추지 않는다.
+ */
+static int connect_origin(conn_t *c) {
+    char hostname[MAXLINE], port[MAXLINE], path[MAXLINE];
+    int err;
+
+    parse_uri(c->uri, hostname, port, path);
+    c->connect_start = loop_now;
+
+    if (dns_lookup_cached(hostname, port, &c->addrs, &err)) {
+        return resolved(c);
+    }
+    c->job = resolver_submit(hostname, port, resolve_done, c);
+    c->state = ST_RESOLVING;
+    return STEP_BLOCK;
+}
+
+/**
+ * 조회가 끝났을 때 resolver_complete 가 부르는 함수 (resolve_job_t 의 done)
+ *
+ * @param res 조회 결과 (소유권이 연결로 넘어온다, 실패하면 NULL)
+ */
+static void resolve_done(void *arg, dns_result_t *res, int err) {
+    conn_t *c = arg;
+
+    c->job = NULL;
+    c->addrs = res;
+    conn_drive(c);
+}
+
+/**
+ * 주소를 얻은 뒤 첫 번째 주소로 connect 를 시작하는 함수
+ */
+static int resolved(conn_t *c) {
+    if (c->addrs == NULL) {
+        return start_error(c, c->uri, "502", "Bad Gateway", "Proxy could not resolve the host");
+    }
+    return start_connect(c);
+}
+
+/**
+ * ST_RESOLVING: resolver 의 조회가 끝났으면 connect 를 시작한다.
+ */
+static int do_resolving(conn_t *c) {
+    return (c->job != NULL) ? STEP_BLOCK : resolved(c);
+}
+
+/**
+ * ST_READ_REQUEST: 빈 줄이 나올 때까지 요청 헤더를 모아 http_parse_request 로 나눈다.
+ *
+ * keep-alive 연결에서는 앞 요청과 함께 받은 pipelined 요청이 이미 버퍼에 있을 수 있으므로,
+ * 읽기 전에 버퍼부터 확인한다.
+ */
+static int do_read_request(conn_t *c) {
+    http_request_t req;
+    int last_len = 0, rc;
+    ssize_t n;
+
+    while (1) {
+        // 앞에서 확인한 길이를 넘기면 파서는 새로 받은 부분에 빈 줄이 있을 때만 다시 나눈다.
+        if ((rc = http_parse_request(c->req, c->req_len, last_len, &req)) > 0) {
+            c->hdr_len = rc;
+            c->req_start = loop_now;
+            return handle_request(c, &req);
+        }
+        if (rc == HTTP_PARSE_ERROR) {
+            c->hdr_len = c->req_len;
+            c->req_start = loop_now;
+            return start_error(c, "", "400", "Bad Request", "Proxy could not parse the request");
+        }
+        if (c->req_len == sizeof(c->req) - 1) {
+            c->req_start = loop_now;
+            return start_error(c, "", "400", "Bad Request", "Request header is too large");
+        }
+        last_len = c->req_len;
+
+        n = read(c->client_fd, c->req + c->req_len, sizeof(c->req) - 1 - c->req_len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN) ? STEP_BLOCK : STEP_CLOSE;
+        }
+        if (n == 0) {
+            return STEP_CLOSE;  // 클라이언트가 연결을 끊었다.
+        }
+
+        c->req_len += n;
+        c->req[c->req_len] = '\0';
+    }
+}
+
+/**
+ * ST_CONNECTING: 연결 경쟁을 진행하고, 가장 먼저 연결된 소켓으로 요청을 보낸다.
+ */
+static int do_connecting(conn_t *c) {
+    int fd = connrace_step(&c->race, race_start_fd, c);
+
+    if (fd == CONNRACE_AGAIN) {
+        return STEP_BLOCK;
+    }
+    c->racing = 0;
+    if (fd == CONNRACE_FAIL) {
+        return start_error(c, c->uri, "502", "Bad Gateway", "Proxy could not connect to the host");
+    }
+
+    // 경쟁에서 진 시도 소켓은 닫혔으므로 epoll 등록도 함께 풀렸다.
+    c->server_fd = fd;
+    c->last_io = loop_now;
+    c->state = ST_SEND_REQUEST;
+    return STEP_NEXT;
+}
+
+/**
+ * ST_SEND_REQUEST: 재조립한 요청을 목적지 서버로 보낸다.
+ */
+static int do_send_request(conn_t *c) {
+    ssize_t n;
+
+    while (c->out_off < c->out_len) {
+        n = write(c->server_fd, c->out + c->out_off, c->out_len - c->out_off);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                return STEP_BLOCK;
+            }
+            // 풀에 있는 동안 서버가 닫은 연결이면 새 연결로 다시 시도한다.
+            return c->reused ? retry_fetch(c) : STEP_CLOSE;
+        }
+        c->out_off += n;
+        c->last_io = loop_now;
+    }
+
+    // 요청을 다 보냈으면 응답 전달 단계로 넘어간다.
+    c->sent_at = loop_now;
+    c->out_len = c->out_off = 0;
+    iobuf_init(&c->in, c->server_fd, MAXBUF);
+    framer_init(&c->fr);
+    c->got = 0;
+    c->extra = 0;
+    c->state = ST_FORWARD;
+    return STEP_NEXT;
+}
+
+/**
+ * 목적지 응답을 끝까지 전달했을 때 부르는 함수
+ *
+ * 크기 제한 안이면 캐시에 추가하고, 연결을 다시 쓸 수 있으면 epoll 에서 빼서 풀에 돌려놓는다.
+ */
+static int forward_done(conn_t *c) {
+    char hostname[MAXLINE], port[MAXLINE], path[MAXLINE];
+
+    drop_flight(c, 1);
+    relay_close(&c->relay);
+    if (c->fr.keep_alive && !c->extra &&
+        epoll_ctl(epfd, EPOLL_CTL_DEL, c->server_fd, NULL) == 0) {
+        parse_uri(c->uri, hostname, port, path);
+        upstream_put(hostname, port, c->server_fd);
+        c->server_fd = -1;
+    }
+    return finish_request(c, respfilter_persistent(&c->rf));
+}
+
+/**
+ * ST_FORWARD: 목적지 서버의 응답을 받는 대로 클라이언트에게 전달하고,
+ * 크기가 MAX_OBJECT_SIZE 이하이면 캐시에 저장할 수 있도록 모아 둔다.
+ *
+ * 클라이언트가 느려 쓰기가 막히면(EAGAIN) 목적지에서 더 읽지 않는다.
+ * 그래서 연결 하나가 쓰는 메모리는 읽은 조각 하나(iobuf, 최대 IOBUF_MAX)와 캐시용 버퍼를 넘지 않는다.
+ * 조각을 다 보내면 iobuf 의 버퍼는 풀로 돌아가므로, 목적지를 기다리는 동안에는 버퍼를 들고 있지 않는다.
+ *
+ * 응답의 끝은 framer 로 세고, 끝까지 읽은 persistent 연결은 epoll 에서 빼서 풀에 돌려놓는다.
+ * 클라이언트에게는 respfilter 를 거쳐 보내고, flight 버퍼에는 목적지의 응답을 그대로 덧붙인다.
+ */
+static int do_forward(conn_t *c) {
+    char *data;
+    ssize_t n, len;
+    int rc;
+
+    while (1) {
+        // 1. 이전에 읽은 조각이 남아 있으면 먼저 필터를 거쳐 클라이언트에게 보낸다.
+        if ((rc = send_filtered(c, c->in.bufptr, &c->out_off, c->out_len)) != SEND_DONE) {
+            return rc;
+        }
+        iobuf_release(&c->in);      // 보낸 조각과 응답 뒤에 남는 바이트를 버리고 버퍼를 돌려준다
+
+        // 2. 응답을 끝까지 보냈다.
+        if (framer_done(&c->fr)) {
+            return forward_done(c);
+        }
+
+        // 캐시하지 않을 응답의 남은 본문은 splice 로 옮긴다.
+        if (framer_uncacheable(&c->fr) && framer_body_left(&c->fr) > 0 &&
+            relay_open(&c->relay) == 0) {
+            c->state = ST_SPLICE;
+            return STEP_NEXT;
+        }
+
+        // 3. 목적지 서버에서 다음 조각을 읽는다.
+        //    한 번에 도착하는 양이 버퍼를 채우면 다음 조각의 버퍼를 키운다 (최대 IOBUF_MAX).
+        n = iobuf_peek(&c->in, &data);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                return STEP_BLOCK;
+            }
+        }
+        if (n <= 0) {
+            // 풀에서 꺼낸 연결이 한 바이트도 보내지 않고 닫혔다면 서버가 먼저 닫은 것이다.
+            if (c->reused && c->got == 0) {
+                return retry_fetch(c);
+            }
+            // 길이 정보 없이 연결이 닫힐 때까지 읽는 응답만 온전하다.
+            drop_flight(c, n == 0 && framer_eof_ok(&c->fr));
+            return STEP_CLOSE;
+        }
+        c->got += n;
+        c->last_io = loop_now;
+
+        len = framer_feed(&c->fr, data, n);
+        if (len < n) {
+            c->extra = 1;       // 응답 뒤에 남는 바이트는 버리고, 그 연결은 다시 쓰지 않는다.
+        }
+
+        // leader 면 follower 들이 읽을 수 있게 flight 버퍼에 덧붙인다.
+        // 너무 큰 객체는 중간에 버퍼를 버리고 전달만 한다. 헤더로 보아 캐시하지 않을 응답이면
+        // 바로 flight 에서 빠지고, follower 들은 직접 받아 온다.
+        if (c->flight != NULL && framer_uncacheable(&c->fr)) {
+            drop_flight(c, 0);
+        }
+        if (c->flight != NULL) {
+            flight_append(c->flight, data, len);
+        }
+
+        c->out_off = 0;
+        c->out_len = len;
+    }
+}
+
+/**
+ * ST_SPLICE: 캐시하지 않을 응답의 남은 본문을 파이프를 거쳐 목적지 소켓에서 클라이언트 소켓으로 옮긴다.
+ *
+ * 바이트가 사용자 공간으로 복사되지 않는다. do_forward 처럼 클라이언트 쪽이 막히면
+ * 파이프가 빌 때까지 목적지에서 더 읽지 않는다.
+ */
+static int do_splice(conn_t *c) {
+    ssize_t n;
+
+    while (1) {
+        // 1. 파이프에 남은 바이트를 먼저 클라이언트에게 보낸다.
+        if (c->relay.len > 0) {
+            if ((n = relay_drain(&c->relay, c->client_fd)) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return (errno == EAGAIN) ? STEP_BLOCK : STEP_CLOSE;
+            }
+            c->last_io = loop_now;
+            continue;
+        }
+
+        if (framer_done(&c->fr)) {
+            return forward_done(c);
+        }
+
+        // 2. 목적지 소켓에서 파이프로 옮긴다. 본문은 보지 않고 옮긴 바이트 수만 framer 에 알린다.
+        if ((n = relay_fill(&c->relay, c->server_fd, framer_body_left(&c->fr))) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                return STEP_BLOCK;
+            }
+        }
+        if (n <= 0) {
+            return STEP_CLOSE;  // 연결이 닫힐 때까지가 본문인 응답도 여기서 끝난다
+        }
+        framer_skip(&c->fr, n);
+        c->got += n;
+        c->last_io = loop_now;
+    }
+}
+
+/**
+ * ST_FOLLOW: leader 의 flight 버퍼에서 새 데이터를 꺼내 클라이언트에게 전달한다.
+ *
+ * 새 데이터가 없으면 leader 가 깨울 때까지 기다린다. leader 가 실패했거나
+ * 객체가 너무 커서 버퍼가 버려지면, 이미 보낸 부분은 건너뛰면서 직접 받아 온다.
+ */
+static int do_follow(conn_t *c) {
+    ssize_t n;
+    int rc;
+
+    while (1) {
+        if ((rc = send_filtered(c, c->out, &c->out_off, c->out_len)) != SEND_DONE) {
+            return rc;
+        }
+
+        n = flight_read(c->flight, c->sent, c->out, sizeof(c->out), 0);
+        if (n > 0) {
+            c->out_len = n;
+            c->out_off = 0;
+            c->sent += n;
+            continue;
+        }
+        if (n == FLIGHT_AGAIN) {
+            return STEP_BLOCK;
+        }
+        if (n == FLIGHT_EOF) {
+            return finish_request(c, respfilter_persistent(&c->rf));
+        }
+
+        // FLIGHT_BROKEN: 아직 아무것도 보내지 않았으면 필터를 비우고 직접 받아 온다.
+        // 새로 받은 응답은 leader 의 응답과 바이트 단위로 같다는 보장이 없으므로 이어 붙이지 않고 닫는다.
+        drop_flight(c, 0);
+        if (c->replied) {
+            return STEP_CLOSE;
+        }
+        respfilter_init(&c->rf, c->rf.http10, c->keep_alive);
+        strcpy(c->out, c->saved_req);
+        c->out_len = strlen(c->out);
+        c->out_off = 0;
+        return start_fetch(c);
+    }
+}
+
+/**
+ * ST_REPLY: 캐시 객체나 에러 응답을 클라이언트에게 보낸다.
+ *
+ * 캐시 객체는 respfilter 를 거쳐 보낸다. Range 응답은 handle_request 가 필터의 조각들(rf.out)에
+ * 미리 만들어 두었으므로 그것을 먼저 writev 로 보낸다 (reply 는 비어 있다).
+ * 에러 응답 뒤에는 요청 본문이 남아 있을 수 있으므로 연결을 닫는다 (persistent 가 0).
+ */
+static int do_reply(conn_t *c) {
+    ssize_t n;
+    int rc;
+
+    if (c->pinned != NULL) {
+        if ((rc = send_filtered(c, c->reply, &c->reply_off, c->reply_len)) != SEND_DONE) {
+            return rc;
+        }
+        return finish_request(c, (c->reply_len > 0) ? respfilter_persistent(&c->rf) : c->persistent);
+    }
+
+    while (c->reply_off < c->reply_len) {
+        n = write(c->client_fd, c->reply + c->reply_off, c->reply_len - c->reply_off);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN) ? STEP_BLOCK : STEP_CLOSE;
+        }
+        c->reply_off += n;
+        c->last_io = loop_now;
+        c->replied = 1;
+    }
+    return finish_request(c, c->persistent);
+}
+
+/**
+ * 연결의 상태 기계를 더 이상 진행할 수 없을 때까지 돌리는 함수
+ *
+ * @return 마지막 단계의 반환값
+ */
+static int conn_drive(conn_t *c) {
+    int rc;
+
+    do {
+        switch (c->state) {
+        case ST_READ_REQUEST: rc = do_read_request(c); break;
+        case ST_RESOLVING:    rc = do_resolving(c);    break;
+        case ST_CONNECTING:   rc = do_connecting(c);   break;
+        case ST_SEND_REQUEST: rc = do_send_request(c); break;
+        case ST_FORWARD:      rc = do_forward(c);      break;
+        case ST_SPLICE:       rc = do_splice(c);       break;
+        case ST_FOLLOW:       rc = do_follow(c);       break;
+        case ST_REPLY:        rc = do_reply(c);        break;
+        default:              rc = STEP_BLOCK;         break;
+        }
+    } while (rc == STEP_NEXT);
+
+    if (rc == STEP_CLOSE) {
+        conn_close(c);
+    } else {
+        conn_arm(c);
+    }
+    return rc;
+}
+
+/**
+ * 연결의 타이머가 울렸을 때 부르는 함수 (tw_timer_t 의 fn)
+ *
+ * 연결 경쟁의 stagger / 시도 제한 시각이면 경쟁을 진행하기만 한다.
+ * 제한 시간이 지났으면 목적지 쪽 자원을 놓고, 클라이언트에게 아직 아무것도 보내지 않았다면
+ * 504 를 보낸 뒤 닫는다. 요청을 기다리던 연결이나 응답을 보내던 연결은 그냥 닫는다.
+ * leader 가 빠지면 follower 들은 깨어나 직접 받아 온다.
+ */
+static void conn_timeout(void *arg) {
+    conn_t *c = arg;
+
+    if (loop_now < conn_deadline(c)) {
+        conn_drive(c);
+        return;
+    }
+    if (c->state == ST_READ_REQUEST || c->state == ST_REPLY) {
+        conn_close(c);
+        return;
+    }
+
+    release_origin(c);
+    if (start_error(c, c->uri, "504", "Gateway Timeout", "Proxy timed out waiting for the host") == STEP_CLOSE) {
+        conn_close(c);
+        return;
+    }
+    conn_drive(c);
+}
+
+/**
+ * 대기 중인 연결 요청을 EAGAIN 이 나올 때까지 모두 받아들이는 함수
+ */
+static void accept_clients(int listenfd) {
+    struct sockaddr_storage clientaddr;
+    socklen_t clientlen;
+    char hostname[MAXLINE], port[MAXLINE];
+    int connfd;
+
+    while (1) {
+        clientlen = sizeof(clientaddr);
+        connfd = accept(listenfd, (SA *)&clientaddr, &clientlen);
+        if (connfd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                fprintf(stderr, "accept error: %s\n", strerror(errno));
+            }
+            return;
+        }
+
+        // 이벤트 루프를 멈추지 않도록 역방향 DNS 조회 없이 숫자 주소만 얻는다.
+        if (getnameinfo((SA *)&clientaddr, clientlen, hostname, MAXLINE, port, MAXLINE,
+                        NI_NUMERICHOST | NI_NUMERICSERV) == 0) {
+            printf("Accepted connection from (%s, %s)\n", hostname, port);
+        }
+
+        if (set_nonblocking(connfd) < 0) {
+            Close(connfd);
+            continue;
+        }
+
+        conn_t *c = Calloc(1, sizeof(conn_t));
+        c->client_fd = connfd;
+        c->server_fd = -1;
+        relay_init(&c->relay);
+        c->state = ST_READ_REQUEST;
+        c->idle_since = loop_now;
+        timer_init(&c->timer, conn_timeout, c);
+
+        if (epoll_add(connfd, c) < 0) {
+            Close(connfd);
+            free(c);
+            continue;
+        }
+        // 요청이 이미 도착해 있을 수 있으니 바로 한 번 진행해 본다.
+        conn_drive(c);
+    }
+}
+
+/**
+ * epoll 이벤트 루프를 실행하는 함수 (돌아오지 않는다)
+ *
+ * @param listenfd 클라이언트 연결을 기다리는 리스닝 소켓
+ */
+void evloop_run(int listenfd) {
+    struct epoll_event events[MAX_EVENTS];
+    int i, n;
+
+    if ((epfd = epoll_create1(0)) < 0) {
+        unix_error("epoll_create1 error");
+    }
+    if (set_nonblocking(listenfd) < 0 || epoll_add(listenfd, NULL) < 0) {
+        unix_error("evloop listen socket error");
+    }
+    if (epoll_add(resolver_init(config.nresolvers), &resolver_tag) < 0) {
+        unix_error("evloop resolver eventfd error");
+    }
+    timer_wheel_init(&wheel, monotonic_ms());
+
+    while (1) {
+        // 가장 이른 타이머가 울릴 때까지만 기다린다.
+        n = epoll_wait(epfd, events, MAX_EVENTS, next_timeout());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            unix_error("epoll_wait error");
+        }
+        loop_now = monotonic_ms();
+
+        for (i = 0; i < n; i++) {
+            conn_t *c = events[i].data.ptr;
+
+            if (c == NULL) {
+                accept_clients(listenfd);
+            } else if ((void *)c == &resolver_tag) {
+                resolver_complete();
+            } else if (c->state != ST_CLOSED) {
+                conn_drive(c);
+            }
+        }
+
+        // 시각이 된 타이머를 울린다 (연결 경쟁 진행, 제한 시간 만료).
+        loop_now = monotonic_ms();
+        timer_advance(&wheel, loop_now);
+
+        // leader 가 새 데이터를 받아 깨운 follower 들을 진행한다.
+        while (woken_conns != NULL) {
+            conn_t *c = woken_conns;
+            woken_conns = c->next_woken;
+            c->woken = 0;
+            if (c->state != ST_CLOSED) {
+                conn_drive(c);
+            }
+        }
+
+        free_closed_conns();
+    }
+}
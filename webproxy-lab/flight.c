@@ -0,0 +1,222 @@
+/*
+ * flight.c - 같은 URI 에 대한 동시 미스를 하나의 목적지 요청으로 합치는 in-flight 표
+ *
+ * 인기 있는 객체가 캐시에 없을 때(처음 시작했거나 evict 된 직후) 동시에 들어온 요청들이
+ * 각자 목적지에 연결해 같은 바이트를 받아 오지 않도록, leader 하나만 받아 오고
+ * 나머지는 leader 의 버퍼를 따라 읽는다.
+ *
+ * 락 순서: 표의 락(table_lock)을 잡은 채 flight 의 락을 잡지 않는다.
+ * 반대로 flight 의 락을 잡은 채 표의 락도 잡지 않는다. (두 락을 동시에 잡는 곳이 없다.)
+ */
+#include "flight.h"
+
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+static flight_t *flight_buckets[FLIGHT_HASH_BUCKETS];
+
+
+/**
+ * 상태가 바뀌었거나 새 데이터가 왔음을 기다리는 follower 들에게 알리는 함수
+ * (flight 의 락을 잡은 상태에서 호출한다)
+ */
+static void notify(flight_t *f) {
+    flight_waiter_t *w;
+
+    pthread_cond_broadcast(&f->cond);
+    for (w = f->waiters; w != NULL; w = w->next) {
+        w->wake(w->arg);
+    }
+}
+
+/**
+ * flight 를 표에서 떼어 내는 함수 (이미 떼어 냈으면 아무것도 하지 않는다)
+ *
+ * 떼어 낸 뒤에 같은 URI 로 들어온 미스는 새 leader 가 된다.
+ */
+static void unlink_flight(flight_t *f) {
+    flight_t **pp;
+
+    pthread_mutex_lock(&table_lock);
+    if (f->linked) {
+        for (pp = &flight_buckets[f->uri_hash & (FLIGHT_HASH_BUCKETS - 1)]; *pp != NULL; pp = &(*pp)->next) {
+            if (*pp == f) {
+                *pp = f->next;
+                break;
+            }
+        }
+        f->linked = 0;
+    }
+    pthread_mutex_unlock(&table_lock);
+}
+
+/**
+ * URI 에 대한 진행 중인 목적지 요청에 참여하는 함수
+ *
+ * 진행 중인 요청이 없으면 새 flight 를 만들어 표에 넣고 호출한 쪽이 leader 가 된다.
+ * leader 는 응답을 받으면서 flight_append 를, 끝나면 flight_finish 를 호출해야 하고,
+ * follower 는 다 읽은 뒤 flight_release 를 호출해야 한다.
+ *
+ * @param uri 요청 URI
+ * @param leader leader 가 되었으면 1, 이미 진행 중인 요청에 붙었으면 0 이 저장된다
+ * @return 참조가 하나 올라간 flight
+ */
+flight_t *flight_join(char *uri, int *leader) {
+    uint64_t hash = hash_uri(uri);
+    flight_t **bucket = &flight_buckets[hash & (FLIGHT_HASH_BUCKETS - 1)];
+    flight_t *f;
+
+    pthread_mutex_lock(&table_lock);
+
+    for (f = *bucket; f != NULL; f = f->next) {
+        if (f->uri_hash == hash && strcmp(f->uri, uri) == 0) {
+            // 표에 있는 동안은 leader 의 참조가 남아 있으므로 0 이 될 수 없다.
+            atomic_fetch_add(&f->refcnt, 1);
+            pthread_mutex_unlock(&table_lock);
+            *leader = 0;
+            return f;
+        }
+    }
+
+    f = Calloc(1, sizeof(flight_t));
+    f->uri = strdup(uri);
+    f->uri_hash = hash;
+    pthread_mutex_init(&f->lock, NULL);
+    pthread_cond_init(&f->cond, NULL);
+    cache_fill_init(&f->fill);
+    f->state = FLIGHT_RUNNING;
+    atomic_init(&f->refcnt, 1);
+    f->linked = 1;
+    f->next = *bucket;
+    *bucket = f;
+
+    pthread_mutex_unlock(&table_lock);
+    *leader = 1;
+    return f;
+}
+
+/**
+ * leader 가 목적지에서 받은 응답 조각을 덧붙이는 함수
+ *
+ * 객체가 MAX_OBJECT_SIZE 를 넘으면 버퍼를 버리고 flight 를 실패로 바꾼다.
+ * leader 는 계속 자기 클라이언트에게 전달하면 되고, follower 들은 직접 받아 온다.
+ */
+void flight_append(flight_t *f, const char *data, int n) {
+    int broken = 0;
+
+    pthread_mutex_lock(&f->lock);
+    if (f->state != FLIGHT_RUNNING) {
+        pthread_mutex_unlock(&f->lock);
+        return;
+    }
+
+    cache_fill_append(&f->fill, data, n);
+    if (f->fill.overflow) {
+        f->state = FLIGHT_FAILED;
+        broken = 1;
+    }
+    notify(f);
+    pthread_mutex_unlock(&f->lock);
+
+    if (broken) {
+        unlink_flight(f);       // 더 이상 새 follower 를 받지 않는다
+    }
+}
+
+/**
+ * leader 가 목적지 요청을 끝내는 함수 (leader 의 참조도 함께 놓는다)
+ *
+ * 성공했으면 모은 객체를 캐시에 넣은 뒤에 표에서 떼어 낸다.
+ * 이 순서라야 뒤에 들어온 요청이 캐시와 표 양쪽에서 모두 미스 나는 틈이 없다.
+ *
+ * @param ok 응답을 끝까지 받았으면 1, 중간에 실패했으면 0
+ */
+void flight_finish(flight_t *f, int ok) {
+    // 버퍼에 쓰는 것은 leader 뿐이므로 락 없이 읽어도 된다.
+    if (ok && f->state == FLIGHT_RUNNING && f->fill.size > 0) {
+        add_to_cache(f->uri, f->fill.buf, f->fill.size);
+    }
+
+    pthread_mutex_lock(&f->lock);
+    if (f->state == FLIGHT_RUNNING) {
+        f->state = ok ? FLIGHT_DONE : FLIGHT_FAILED;
+    }
+    notify(f);
+    pthread_mutex_unlock(&f->lock);
+
+    unlink_flight(f);
+    flight_release(f);
+}
+
+/**
+ * flight 의 참조를 놓는 함수 (마지막 참조면 해제한다)
+ */
+void flight_release(flight_t *f) {
+    if (atomic_fetch_sub(&f->refcnt, 1) != 1) {
+        return;
+    }
+
+    cache_fill_abort(&f->fill);
+    pthread_mutex_destroy(&f->lock);
+    pthread_cond_destroy(&f->cond);
+    free(f->uri);
+    free(f);
+}
+
+/**
+ * follower 가 leader 의 버퍼에서 off 바이트 이후를 읽는 함수
+ *
+ * @param off 이미 클라이언트에게 보낸 바이트 수
+ * @param buf 읽은 데이터를 복사할 버퍼
+ * @param maxlen buf 의 크기
+ * @param wait 1 이면 새 데이터가 올 때까지 스레드를 재운다. 0 이면 FLIGHT_AGAIN 을 돌려준다.
+ * @return 복사한 바이트 수, 또는 FLIGHT_EOF / FLIGHT_BROKEN / FLIGHT_AGAIN
+ */
+int flight_read(flight_t *f, int off, char *buf, int maxlen, int wait) {
+    int n;
+
+    pthread_mutex_lock(&f->lock);
+
+    while (f->state == FLIGHT_RUNNING && off >= f->fill.size && wait) {
+        pthread_cond_wait(&f->cond, &f->lock);
+    }
+
+    if (f->state == FLIGHT_FAILED) {
+        n = FLIGHT_BROKEN;
+    } else if (off < f->fill.size) {
+        n = f->fill.size - off;
+        if (n > maxlen) {
+            n = maxlen;
+        }
+        memcpy(buf, f->fill.buf + off, n);
+    } else {
+        n = (f->state == FLIGHT_DONE) ? FLIGHT_EOF : FLIGHT_AGAIN;
+    }
+
+    pthread_mutex_unlock(&f->lock);
+    return n;
+}
+
+/**
+ * 스레드를 재울 수 없는 follower 를 대기자로 등록하는 함수
+ */
+void flight_watch(flight_t *f, flight_waiter_t *w) {
+    pthread_mutex_lock(&f->lock);
+    w->next = f->waiters;
+    f->waiters = w;
+    pthread_mutex_unlock(&f->lock);
+}
+
+/**
+ * 대기자 등록을 해제하는 함수 (follower 가 flight_release 하기 전에 호출한다)
+ */
+void flight_unwatch(flight_t *f, flight_waiter_t *w) {
+    flight_waiter_t **pp;
+
+    pthread_mutex_lock(&f->lock);
+    for (pp = &f->waiters; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == w) {
+            *pp = w->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&f->lock);
+}
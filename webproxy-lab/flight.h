@@ -0,0 +1,63 @@
+/*
+ * flight.h - 같은 URI 에 대한 동시 미스를 하나의 목적지 요청으로 합치는 in-flight 표 (single-flight)
+ *
+ * 캐시 미스가 난 요청은 flight_join 으로 표에 들어간다. 처음 들어온 요청이 leader 가 되어
+ * 목적지에서 응답을 받아 flight_append 로 버퍼에 덧붙이고, 뒤따라온 follower 들은
+ * 그 버퍼를 flight_read 로 읽어 자기 클라이언트에게 보낸다.
+ *
+ * 버퍼는 캐시용 버퍼(cache_fill_t)와 같아서 MAX_OBJECT_SIZE 를 넘으면 버려진다.
+ * 그 경우나 leader 가 중간에 실패한 경우 flight 는 FLIGHT_BROKEN 이 되고, follower 는
+ * 아직 아무것도 보내지 않았으면 직접 목적지에서 받아 오고, 이미 일부를 보냈으면 연결을 닫아야 한다
+ * (다시 받은 응답이 leader 의 응답과 바이트 단위로 같다는 보장이 없다).
+ */
+#ifndef __FLIGHT_H__
+#define __FLIGHT_H__
+
+#include "cache.h"
+
+#define FLIGHT_HASH_BUCKETS 256     // in-flight 표의 버킷 수 (2의 거듭제곱)
+
+/* flight_read 의 반환값 (0 보다 크면 읽은 바이트 수) */
+#define FLIGHT_EOF      0           // leader 가 응답을 끝까지 받았고, 다 읽었다
+#define FLIGHT_BROKEN   -1          // leader 가 실패했거나 버퍼가 버려졌다: 직접 받아 와야 한다
+#define FLIGHT_AGAIN    -2          // 아직 새 데이터가 없다 (기다리지 않는 호출에서만)
+
+/* flight 의 진행 상태 */
+typedef enum {
+    FLIGHT_RUNNING,                 // leader 가 응답을 받는 중
+    FLIGHT_DONE,                    // 응답을 끝까지 받았다
+    FLIGHT_FAILED                   // leader 가 실패했거나 객체가 너무 커서 버퍼를 버렸다
+} flight_state_t;
+
+/* 스레드를 재울 수 없는 follower(이벤트 루프)를 깨우기 위한 대기자 */
+typedef struct flight_waiter {
+    void (*wake)(void *arg);        // 새 데이터가 오거나 상태가 바뀌면 flight 의 락을 잡은 채 호출된다
+    void *arg;
+    struct flight_waiter *next;
+} flight_waiter_t;
+
+/* 진행 중인 목적지 요청 하나 */
+typedef struct flight {
+    char *uri;                      // key: 요청 URI
+    uint64_t uri_hash;
+
+    pthread_mutex_t lock;           // 아래 필드를 보호한다
+    pthread_cond_t cond;            // 새 데이터가 오거나 상태가 바뀌면 broadcast
+    cache_fill_t fill;              // 지금까지 받은 응답
+    flight_state_t state;
+    flight_waiter_t *waiters;
+
+    atomic_int refcnt;              // leader(1) + follower 수
+    int linked;                     // 표에 들어 있으면 1 (표의 락으로 보호)
+    struct flight *next;            // 같은 버킷의 다음 flight
+} flight_t;
+
+flight_t *flight_join(char *uri, int *leader);
+void flight_append(flight_t *f, const char *data, int n);
+void flight_finish(flight_t *f, int ok);
+void flight_release(flight_t *f);
+int flight_read(flight_t *f, int off, char *buf, int maxlen, int wait);
+void flight_watch(flight_t *f, flight_waiter_t *w);
+void flight_unwatch(flight_t *f, flight_waiter_t *w);
+
+#endif /* __FLIGHT_H__ */
@@ -0,0 +1,261 @@
+/*
+ * framer.c - 목적지 서버 응답의 끝을 찾는 점진적 HTTP 응답 파서
+ *
+ * 상태 라인, 헤더, chunk 크기 줄처럼 줄 단위로 읽어야 하는 부분은 line 버퍼에 모아 한 줄씩 해석하고,
+ * 본문과 chunk 데이터는 남은 길이만큼 한 번에 건너뛴다.
+ */
+#include "framer.h"
+#include <limits.h>
+
+
+/**
+ * 쉼표로 구분된 헤더 값에 token 이 들어 있는지 대소문자 구분 없이 확인하는 함수
+ *
+ * 원소마다 앞뒤 공백(OWS)을 떼고 전체가 token 과 같은지 비교하므로 "keep-alive-foo" 나
+ * "xchunked" 는 맞지 않는다. ";" 나 "=" 뒤의 매개변수(예: private="Set-Cookie")는 무시한다.
+ *
+ * @param value 헤더 값 (예: "keep-alive, Upgrade", NULL 문자로 끝나지 않아도 된다)
+ * @param len 값의 길이
+ * @param token 찾을 토큰 (예: "close")
+ */
+int framer_has_token(const char *value, int len, const char *token) {
+    size_t token_len = strlen(token);
+    const char *end = value + len, *name_end;
+
+    while (value < end) {
+        while (value < end && (*value == ' ' || *value == '\t' || *value == ',')) {
+            value++;
+        }
+        // 원소의 이름: 쉼표, 매개변수, 공백 앞까지
+        for (name_end = value; name_end < end && !strchr(",;= \t", *name_end); name_end++) {
+            ;
+        }
+        if ((size_t)(name_end - value) == token_len && strncasecmp(value, token, token_len) == 0) {
+            return 1;
+        }
+        // 매개변수를 건너뛰고 다음 원소로
+        value = name_end;
+        while (value < end && *value != ',') {
+            value++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * 헤더가 끝났을 때(빈 줄) 본문의 길이를 어떻게 셀지 정하는 함수
+ */
+static void start_body(framer_t *fr) {
+    // 1xx, 204, 304 응답에는 본문이 없다.
+    if ((fr->status >= 100 && fr->status < 200) || fr->status == 204 || fr->status == 304) {
+        fr->state = FR_DONE;
+    } else if (fr->chunked) {
+        fr->state = FR_CHUNK_SIZE;
+    } else if (fr->content_length >= 0) {
+        fr->remaining = fr->content_length;
+        fr->state = (fr->remaining > 0) ? FR_BODY : FR_DONE;
+    } else {
+        // 길이를 알 수 없으면 연결이 닫혀야 응답이 끝나므로 연결을 다시 쓸 수 없다.
+        fr->state = FR_UNTIL_EOF;
+        fr->keep_alive = 0;
+    }
+}
+
+/**
+ * 완성된 한 줄(CRLF 제외)을 현재 상태에 맞게 해석하는 함수
+ */
+static void process_line(framer_t *fr, char *line) {
+    int minor;
+
+    switch (fr->state) {
+    case FR_STATUS:
+        if (sscanf(line, "HTTP/1.%d %d", &minor, &fr->status) != 2) {
+            fr->status = 0;
+            minor = 0;
+        }
+        // HTTP/1.1 은 기본이 persistent, HTTP/1.0 은 Connection: keep-alive 가 있어야 한다.
+        fr->keep_alive = (minor >= 1);
+        fr->state = FR_HEADER;
+        break;
+
+    case FR_HEADER:
+        if (*line == '\0') {
+            start_body(fr);
+        } else if (!strncasecmp(line, "Content-Length:", 15)) {
+            fr->content_length = strtoll(line + 15, NULL, 10);
+        } else if (!strncasecmp(line, "Transfer-Encoding:", 18)) {
+            fr->chunked = framer_has_token(line + 18, strlen(line + 18), "chunked");
+        } else if (!strncasecmp(line, "Cache-Control:", 14)) {
+            fr->no_store = framer_has_token(line + 14, strlen(line + 14), "no-store") ||
+                           framer_has_token(line + 14, strlen(line + 14), "private");
+        } else if (!strncasecmp(line, "Connection:", 11)) {
+            if (framer_has_token(line + 11, strlen(line + 11), "close")) {
+                fr->keep_alive = 0;
+            } else if (framer_has_token(line + 11, strlen(line + 11), "keep-alive")) {
+                fr->keep_alive = 1;
+            }
+        }
+        break;
+
+    case FR_CHUNK_SIZE:
+        // chunk 크기는 16진수이고, 뒤에 ";" 로 시작하는 확장이 붙을 수 있다.
+        fr->remaining = strtoll(line, NULL, 16);
+        fr->state = (fr->remaining > 0) ? FR_CHUNK_DATA : FR_TRAILER;
+        break;
+
+    case FR_CHUNK_END:
+        fr->state = FR_CHUNK_SIZE;
+        break;
+
+    case FR_TRAILER:
+        if (*line == '\0') {
+            fr->state = FR_DONE;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * 응답 파서를 새 응답을 읽을 수 있게 초기화하는 함수
+ */
+void framer_init(framer_t *fr) {
+    fr->state = FR_STATUS;
+    fr->status = 0;
+    fr->keep_alive = 0;
+    fr->chunked = 0;
+    fr->no_store = 0;
+    fr->header_len = 0;
+    fr->content_length = -1;
+    fr->remaining = 0;
+    fr->line_len = 0;
+}
+
+/**
+ * 목적지 서버에서 받은 조각을 파서에 넣는 함수
+ *
+ * 응답이 조각 중간에서 끝나면 거기까지만 소비한다. 나머지는 다음 응답의 바이트이거나
+ * 서버가 잘못 보낸 것이므로, 호출한 쪽은 그 연결을 다시 쓰지 않아야 한다.
+ *
+ * @param buf 받은 조각
+ * @param n 조각의 길이
+ * @return 이 응답에 속하는 바이트 수 (응답이 끝나지 않았으면 n)
+ */
+int framer_feed(framer_t *fr, const char *buf, int n) {
+    int pos = 0;
+
+    while (pos < n && fr->state != FR_DONE) {
+        if (fr->state == FR_UNTIL_EOF) {
+            return n;
+        }
+
+        // 본문과 chunk 데이터는 남은 길이만큼 한 번에 건너뛴다.
+        if (fr->state == FR_BODY || fr->state == FR_CHUNK_DATA) {
+            long long take = n - pos;
+            if (take > fr->remaining) {
+                take = fr->remaining;
+            }
+            pos += take;
+            fr->remaining -= take;
+            if (fr->remaining == 0) {
+                fr->state = (fr->state == FR_BODY) ? FR_DONE : FR_CHUNK_END;
+            }
+            continue;
+        }
+
+        // 줄 단위로 읽는 부분: '\n' 이 나올 때까지 line 버퍼에 모은다.
+        // 너무 긴 줄은 앞부분만 남기고 잘라도 길이 계산에는 영향이 없다.
+        const char *nl = memchr(buf + pos, '\n', n - pos);
+        int len = (nl != NULL) ? nl - (buf + pos) + 1 : n - pos;
+        int room = sizeof(fr->line) - 1 - fr->line_len;
+
+        memcpy(fr->line + fr->line_len, buf + pos, (len < room) ? len : room);
+        fr->line_len += (len < room) ? len : room;
+        pos += len;
+        if (fr->state == FR_STATUS || fr->state == FR_HEADER) {
+            fr->header_len += len;
+        }
+
+        if (nl != NULL) {
+            while (fr->line_len > 0 &&
+                   (fr->line[fr->line_len - 1] == '\n' || fr->line[fr->line_len - 1] == '\r')) {
+                fr->line_len--;
+            }
+            fr->line[fr->line_len] = '\0';
+            fr->line_len = 0;
+            process_line(fr, fr->line);
+        }
+    }
+
+    return pos;
+}
+
+/**
+ * 응답을 끝까지 읽었는지 확인하는 함수
+ */
+int framer_done(framer_t *fr) {
+    return fr->state == FR_DONE;
+}
+
+/**
+ * 지금 연결이 닫혀도 응답이 온전한지 확인하는 함수
+ *
+ * 길이 정보가 없는 응답은 연결이 닫히는 것이 정상적인 끝이다.
+ * 그 밖의 상태에서 닫혔다면 응답이 중간에 잘린 것이므로 캐시하면 안 된다.
+ */
+int framer_eof_ok(framer_t *fr) {
+    return fr->state == FR_DONE || fr->state == FR_UNTIL_EOF;
+}
+
+/**
+ * 응답을 끝까지 읽었고 그 뒤에도 연결을 계속 쓸 수 있는지 확인하는 함수
+ *
+ * 목적지 연결을 풀에 돌려놓을 때와, 클라이언트 연결에서 다음 요청을 기다릴지 정할 때 함께 쓴다.
+ * 응답을 받은 쪽은 같은 헤더를 보고 판단하므로 양쪽의 판단이 어긋나지 않는다.
+ */
+int framer_persistent(framer_t *fr) {
+    return fr->state == FR_DONE && fr->keep_alive;
+}
+
+/**
+ * 헤더만 보고 이 응답을 캐시하지 않을 것을 알 수 있는지 확인하는 함수
+ *
+ * Cache-Control 이 막고 있거나, Content-Length 로 보아 헤더와 본문을 합친 크기가
+ * MAX_OBJECT_SIZE 를 넘으면 캐시에 넣지 않는다. 206 응답은 객체의 일부이므로 캐시하지 않는다.
+ * 헤더를 다 읽기 전에는 0 이다.
+ */
+int framer_uncacheable(framer_t *fr) {
+    if (fr->state == FR_STATUS || fr->state == FR_HEADER) {
+        return 0;
+    }
+    return fr->no_store || fr->status == 206 || fr->header_len + fr->content_length > MAX_OBJECT_SIZE;
+}
+
+/**
+ * 남은 본문을 파싱 없이 그대로 옮겨도 되는 바이트 수를 얻는 함수
+ *
+ * Content-Length 본문이면 남은 길이, 연결이 닫힐 때까지가 본문이면 LLONG_MAX 이다.
+ * chunk 경계는 직접 세어야 하므로 chunked 응답과 헤더를 읽는 중에는 0 이다.
+ */
+long long framer_body_left(framer_t *fr) {
+    if (fr->state == FR_BODY) {
+        return fr->remaining;
+    }
+    return (fr->state == FR_UNTIL_EOF) ? LLONG_MAX : 0;
+}
+
+/**
+ * framer_feed 를 거치지 않고 옮긴 본문 n 바이트를 파서에 알리는 함수
+ *
+ * @param n 옮긴 바이트 수 (framer_body_left 이하)
+ */
+void framer_skip(framer_t *fr, long long n) {
+    if (fr->state == FR_BODY) {
+        fr->remaining -= n;
+        if (fr->remaining == 0) {
+            fr->state = FR_DONE;
+        }
+    }
+}
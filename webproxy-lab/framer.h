@@ -0,0 +1,54 @@
+/*
+ * framer.h - 목적지 서버 응답의 끝을 찾는 점진적(incremental) HTTP 응답 파서
+ *
+ * HTTP/1.1 persistent 연결에서는 연결이 닫히는 것으로 응답의 끝을 알 수 없으므로,
+ * Content-Length 나 chunked 인코딩을 보고 응답이 어디서 끝나는지 직접 세어야 한다.
+ * 받은 조각을 순서대로 framer_feed 에 넣으면 이 응답에 속하는 바이트 수를 알려 준다.
+ * 바이트는 바꾸지 않으므로 호출한 쪽은 받은 그대로 클라이언트에게 전달하면 된다.
+ *
+ * 캐시하지 않을 응답의 본문은 사용자 공간을 거치지 않고 splice 로 옮길 수 있다.
+ * 그때는 본문을 framer_feed 에 넣는 대신 옮긴 바이트 수를 framer_skip 으로 알려 준다.
+ */
+#ifndef __FRAMER_H__
+#define __FRAMER_H__
+
+#include "csapp.h"
+#include "cache.h"
+
+/* 파서가 지금 기다리는 부분 */
+typedef enum {
+    FR_STATUS,          // 상태 라인
+    FR_HEADER,          // 헤더 줄 (빈 줄이 나오면 본문으로)
+    FR_BODY,            // Content-Length 만큼의 본문
+    FR_CHUNK_SIZE,      // chunk 크기 줄
+    FR_CHUNK_DATA,      // chunk 데이터
+    FR_CHUNK_END,       // chunk 데이터 뒤의 CRLF
+    FR_TRAILER,         // 마지막 chunk 뒤의 trailer 헤더 (빈 줄이 나오면 끝)
+    FR_UNTIL_EOF,       // 길이 정보가 없다: 연결이 닫힐 때까지가 본문
+    FR_DONE             // 응답이 끝났다
+} framer_state_t;
+
+typedef struct {
+    framer_state_t state;
+    int status;                 // 상태 코드
+    int keep_alive;             // 응답이 끝난 뒤 연결을 다시 쓸 수 있으면 1
+    int chunked;                // Transfer-Encoding: chunked 이면 1
+    int no_store;               // Cache-Control 에 no-store 나 private 이 있으면 1
+    int header_len;             // 상태 라인과 헤더의 바이트 수 (빈 줄 포함)
+    long long content_length;   // Content-Length (없으면 -1)
+    long long remaining;        // FR_BODY / FR_CHUNK_DATA 에서 남은 바이트 수
+    char line[MAXLINE];         // 조각 경계에 걸친 줄을 모으는 버퍼
+    int line_len;
+} framer_t;
+
+void framer_init(framer_t *fr);
+int framer_feed(framer_t *fr, const char *buf, int n);
+int framer_done(framer_t *fr);
+int framer_eof_ok(framer_t *fr);
+int framer_persistent(framer_t *fr);
+int framer_uncacheable(framer_t *fr);
+long long framer_body_left(framer_t *fr);
+void framer_skip(framer_t *fr, long long n);
+int framer_has_token(const char *value, int len, const char *token);
+
+#endif /* __FRAMER_H__ */
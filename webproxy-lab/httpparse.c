@@ -0,0 +1,278 @@
+/*
+ * httpparse.c - 받은 버퍼 위에서 복사 없이 HTTP 요청을 나누는 점진적 파서
+ *
+ * 요청 라인과 헤더를 앞에서부터 한 번만 훑는다. 토큰의 끝은 scan 이 SIMD 로 찾고,
+ * 찾은 위치에서 구분자가 맞는지만 확인한다. 줄 끝은 CRLF 와 LF 를 모두 받는다.
+ */
+#include <string.h>
+#include <strings.h>
+#include "httpparse.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* hop-by-hop 헤더 표: (이름 길이 + 소문자로 바꾼 첫 글자) 의 하위 5비트가 칸 번호다 (서로 겹치지 않는다) */
+#define HOP_SLOT(len, c)    (((len) + ((c) | 0x20)) & 31)
+
+static const struct {
+    const char *name;
+    int len;
+    http_header_kind_t kind;
+} hop_table[32] = {
+    [HOP_SLOT(4, 'h')]  = { "Host", 4, HDR_HOST },
+    [HOP_SLOT(10, 'u')] = { "User-Agent", 10, HDR_USER_AGENT },
+    [HOP_SLOT(10, 'c')] = { "Connection", 10, HDR_CONNECTION },
+    [HOP_SLOT(16, 'p')] = { "Proxy-Connection", 16, HDR_PROXY_CONNECTION },
+    [HOP_SLOT(10, 'k')] = { "Keep-Alive", 10, HDR_KEEP_ALIVE },
+};
+
+
+/**
+ * 처음으로 구분자가 나오는 위치를 찾는 함수
+ *
+ * upto 이하의 바이트(제어 문자, upto 가 0x20 이면 공백도), DEL(0x7f), extra 에서 멈춘다.
+ * 0x80 이상의 바이트(obs-text)는 건너뛴다. 16바이트(AVX2 면 32바이트)씩 한 번에 비교하고
+ * 남은 꼬리만 한 바이트씩 본다.
+ *
+ * @return 구분자의 위치, 없으면 end
+ */
+static const char *scan(const char *p, const char *end, unsigned char upto, char extra) {
+#if defined(__AVX2__)
+    const __m256i lim = _mm256_set1_epi8((char)upto);
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    const __m256i ext = _mm256_set1_epi8(extra);
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, lim), v),
+                                      _mm256_or_si256(_mm256_cmpeq_epi8(v, del), _mm256_cmpeq_epi8(v, ext)));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i lim = _mm_set1_epi8((char)upto);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    const __m128i ext = _mm_set1_epi8(extra);
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        // min(v, upto) == v 이면 v <= upto (부호 없는 비교)
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, lim), v),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, del), _mm_cmpeq_epi8(v, ext)));
+        int mask = _mm_movemask_epi8(hit);
+
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    for (; p < end; p++) {
+        unsigned char c = *p;
+
+        if (c <= upto || c == 0x7f || c == (unsigned char)extra) {
+            return p;
+        }
+    }
+    return end;
+}
+
+/**
+ * 헤더 이름이 hop-by-hop 헤더인지 표를 한 번 찾아 분류하는 함수
+ */
+static http_header_kind_t classify(const char *name, int len) {
+    int slot = HOP_SLOT(len, (unsigned char)name[0]);
+
+    if (hop_table[slot].len == len && strncasecmp(name, hop_table[slot].name, len) == 0) {
+        return hop_table[slot].kind;
+    }
+    return HDR_OTHER;
+}
+
+/**
+ * 줄 끝(CRLF 또는 LF)을 건너뛰는 함수
+ *
+ * @return 건너뛰었으면 0, 아직 받지 못했으면 HTTP_PARSE_PARTIAL, 줄 끝이 아니면 HTTP_PARSE_ERROR
+ */
+static int skip_eol(const char **pp, const char *end) {
+    const char *p = *pp;
+
+    if (p == end) {
+        return HTTP_PARSE_PARTIAL;
+    }
+    if (*p == '\r' && ++p == end) {
+        return HTTP_PARSE_PARTIAL;
+    }
+    if (*p != '\n') {
+        return HTTP_PARSE_ERROR;
+    }
+    *pp = p + 1;
+    return 0;
+}
+
+/**
+ * 지난번에 받은 부분 뒤로 헤더 끝의 빈 줄이 도착했는지 확인하는 함수
+ *
+ * 경계에 걸친 빈 줄("\n\r\n")도 찾도록 이전 끝의 3바이트 앞부터 본다.
+ */
+static int head_complete(const char *buf, int len, int last_len) {
+    const char *p = buf + ((last_len > 3) ? last_len - 3 : 0), *end = buf + len;
+
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        if (++p == end) {
+            break;
+        }
+        if (*p == '\n' || (*p == '\r' && p + 1 < end && p[1] == '\n')) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * 헤더 줄들을 빈 줄까지 나누는 함수
+ *
+ * 줄 접기(obs-fold, 공백으로 시작하는 줄)는 받지 않는다.
+ *
+ * @param pp 헤더의 시작 (성공하면 빈 줄 다음으로 옮긴다)
+ * @return 성공하면 0, 아니면 HTTP_PARSE_PARTIAL / HTTP_PARSE_ERROR
+ */
+static int parse_headers(const char **pp, const char *end, http_header_t *headers, int *num_headers) {
+    const char *p = *pp, *name, *value, *vend;
+    http_header_t *h;
+    int n = 0, rc;
+
+    while (1) {
+        if (p == end) {
+            return HTTP_PARSE_PARTIAL;
+        }
+        if (*p == '\r' || *p == '\n') {
+            if ((rc = skip_eol(&p, end)) != 0) {
+                return rc;
+            }
+            break;      // 빈 줄: 헤더 끝
+        }
+        if (n == HTTP_MAX_HEADERS) {
+            return HTTP_PARSE_ERROR;
+        }
+
+        // 1. 이름: 콜론 앞까지 (공백이나 제어 문자가 먼저 나오면 잘못된 요청)
+        name = p;
+        if ((p = scan(p, end, 0x20, ':')) == end) {
+            return HTTP_PARSE_PARTIAL;
+        }
+        if (*p != ':' || p == name) {
+            return HTTP_PARSE_ERROR;
+        }
+        h = &headers[n];
+        h->name = name;
+        h->name_len = p - name;
+
+        // 2. 값: 앞 공백을 건너뛰고 줄 끝까지 (탭은 값 안에 올 수 있다)
+        for (p++; p < end && (*p == ' ' || *p == '\t'); p++) {
+            ;
+        }
+        value = p;
+        while ((p = scan(p, end, 0x1f, 0x7f)) < end && *p == '\t') {
+            p++;
+        }
+        vend = p;
+        if ((rc = skip_eol(&p, end)) != 0) {
+            return rc;
+        }
+        while (vend > value && (vend[-1] == ' ' || vend[-1] == '\t')) {
+            vend--;
+        }
+        h->value = value;
+        h->value_len = vend - value;
+        h->kind = classify(h->name, h->name_len);
+        n++;
+    }
+
+    *pp = p;
+    *num_headers = n;
+    return 0;
+}
+
+/**
+ * 요청 라인과 헤더를 나누는 함수
+ *
+ * @param buf 받은 데이터 (NULL 문자로 끝나지 않아도 된다)
+ * @param len 받은 바이트 수
+ * @param last_len 지난번 호출 때의 len (처음이면 0)
+ * @param req 나눈 결과 (buf 안을 가리킨다)
+ * @return 빈 줄까지의 바이트 수, 아직 다 받지 못했으면 HTTP_PARSE_PARTIAL, 요청이 아니면 HTTP_PARSE_ERROR
+ */
+int http_parse_request(const char *buf, int len, int last_len, http_request_t *req) {
+    const char *p = buf, *end = buf + len;
+    int rc;
+
+    // 1. 지난번까지 받은 부분에는 빈 줄이 없었으므로, 새로 받은 부분에도 없으면 다시 파싱하지 않는다.
+    if (last_len > 0 && !head_complete(buf, len, last_len)) {
+        return HTTP_PARSE_PARTIAL;
+    }
+
+    // 2. 요청 라인: 메서드 SP URI SP HTTP/1.x
+    req->method = p;
+    if ((p = scan(p, end, 0x20, 0x7f)) == end) {
+        return HTTP_PARSE_PARTIAL;
+    }
+    if (*p != ' ' || p == req->method) {
+        return HTTP_PARSE_ERROR;
+    }
+    req->method_len = p - req->method;
+
+    req->uri = ++p;
+    if ((p = scan(p, end, 0x20, 0x7f)) == end) {
+        return HTTP_PARSE_PARTIAL;
+    }
+    if (*p != ' ' || p == req->uri) {
+        return HTTP_PARSE_ERROR;
+    }
+    req->uri_len = p - req->uri;
+
+    p++;
+    if (memcmp(p, "HTTP/1.", (end - p < 7) ? end - p : 7) != 0) {
+        return HTTP_PARSE_ERROR;
+    }
+    if (end - p < 8) {
+        return HTTP_PARSE_PARTIAL;
+    }
+    if (p[7] < '0' || p[7] > '9') {
+        return HTTP_PARSE_ERROR;
+    }
+    req->minor_version = p[7] - '0';
+    p += 8;
+    if ((rc = skip_eol(&p, end)) != 0) {
+        return rc;
+    }
+
+    // 3. 헤더
+    if ((rc = parse_headers(&p, end, req->headers, &req->num_headers)) != 0) {
+        return rc;
+    }
+    return p - buf;
+}
+
+/**
+ * 요청 라인 없이 헤더 줄들만 나누는 함수 (요청 라인을 따로 읽은 경우)
+ *
+ * @param num_headers 나눈 헤더 수를 저장한다
+ * @return 빈 줄까지의 바이트 수, 아직 다 받지 못했으면 HTTP_PARSE_PARTIAL, 잘못되었으면 HTTP_PARSE_ERROR
+ */
+int http_parse_headers(const char *buf, int len, http_header_t *headers, int *num_headers) {
+    const char *p = buf;
+    int rc;
+
+    if ((rc = parse_headers(&p, buf + len, headers, num_headers)) != 0) {
+        return rc;
+    }
+    return p - buf;
+}
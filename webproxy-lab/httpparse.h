@@ -0,0 +1,55 @@
+/*
+ * httpparse.h - 받은 버퍼 위에서 복사 없이 HTTP 요청을 나누는 점진적(incremental) 파서
+ *
+ * picohttpparser 처럼 요청 라인과 헤더를 한 번 훑으며 나눈다. 메서드, URI, 헤더 이름과 값은
+ * 받은 버퍼 안을 가리키는 (포인터, 길이) 조각으로 돌려주므로 sscanf 나 줄마다의 복사가 없다.
+ * 구분자(공백, 콜론, 줄 끝)는 SSE2(AVX2 로 빌드하면 AVX2)로 16(32)바이트씩 한 번에 찾는다.
+ * 프록시가 따로 다뤄야 하는 hop-by-hop 헤더는 파싱하면서 표 한 번으로 분류해 둔다.
+ *
+ * 요청이 아직 다 오지 않았으면 HTTP_PARSE_PARTIAL 을 돌려준다. 데이터를 더 받은 뒤에는
+ * 지난번 길이(last_len)를 함께 넘기면 빈 줄을 새로 받은 부분에서만 찾으므로, 조금씩 도착하는
+ * 요청도 전체 길이에 비례하는 비용으로 파싱한다.
+ */
+#ifndef __HTTPPARSE_H__
+#define __HTTPPARSE_H__
+
+#define HTTP_MAX_HEADERS    100     // 요청 하나의 헤더 수 상한 (넘으면 에러)
+
+/* http_parse_request / http_parse_headers 의 반환값 (0 이상이면 빈 줄까지의 바이트 수) */
+#define HTTP_PARSE_ERROR    -1      // HTTP 요청이 아니다
+#define HTTP_PARSE_PARTIAL  -2      // 빈 줄까지 아직 다 받지 못했다
+
+/* 프록시가 다시 만들거나 연결에만 쓰는 헤더 (나머지는 HDR_OTHER) */
+typedef enum {
+    HDR_OTHER,                  // 목적지로 그대로 전달할 헤더
+    HDR_HOST,
+    HDR_USER_AGENT,
+    HDR_CONNECTION,
+    HDR_PROXY_CONNECTION,
+    HDR_KEEP_ALIVE
+} http_header_kind_t;
+
+/* 헤더 한 줄 (이름과 값은 받은 버퍼 안을 가리킨다, 값의 앞뒤 공백 제외) */
+typedef struct {
+    const char *name;
+    int name_len;
+    const char *value;
+    int value_len;
+    http_header_kind_t kind;
+} http_header_t;
+
+/* 요청 라인과 헤더들 */
+typedef struct {
+    const char *method;
+    int method_len;
+    const char *uri;
+    int uri_len;
+    int minor_version;          // HTTP/1.x 의 x
+    http_header_t headers[HTTP_MAX_HEADERS];
+    int num_headers;
+} http_request_t;
+
+int http_parse_request(const char *buf, int len, int last_len, http_request_t *req);
+int http_parse_headers(const char *buf, int len, http_header_t *headers, int *num_headers);
+
+#endif /* __HTTPPARSE_H__ */
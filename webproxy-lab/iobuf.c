@@ -0,0 +1,153 @@
+/*
+ * iobuf.c - 처리량에 따라 크기가 바뀌고 공용 풀에서 빌리는 읽기 버퍼
+ *
+ * 풀은 크기 등급마다 유휴 버퍼의 단일 연결 리스트이고, 다음 버퍼를 가리키는 포인터는
+ * 유휴 버퍼의 앞부분에 넣는다. 등급마다 락이 따로 있어 서로 다른 크기를 빌리는 스레드끼리는
+ * 경쟁하지 않는다.
+ */
+#include "csapp.h"
+#include "iobuf.h"
+
+/* 크기 등급 하나의 유휴 버퍼들 */
+typedef struct {
+    pthread_mutex_t lock;
+    char *head;                 // 유휴 버퍼 (앞 8바이트에 다음 버퍼의 주소)
+    int count;
+} iobuf_class_t;
+
+static iobuf_class_t pool[IOBUF_CLASSES] = {
+    [0 ... IOBUF_CLASSES - 1] = { PTHREAD_MUTEX_INITIALIZER, NULL, 0 }
+};
+
+
+/**
+ * 버퍼 크기(2의 거듭제곱)의 등급 번호를 구하는 함수
+ */
+static int class_of(int size) {
+    return __builtin_ctz(size) - IOBUF_MIN_SHIFT;
+}
+
+/**
+ * 풀에서 size 바이트 버퍼를 빌리는 함수 (유휴 버퍼가 없으면 새로 할당한다)
+ */
+static char *pool_get(int size) {
+    iobuf_class_t *cl = &pool[class_of(size)];
+    char *buf;
+
+    pthread_mutex_lock(&cl->lock);
+    if ((buf = cl->head) != NULL) {
+        cl->head = *(char **)buf;
+        cl->count--;
+    }
+    pthread_mutex_unlock(&cl->lock);
+
+    return (buf != NULL) ? buf : Malloc(size);
+}
+
+/**
+ * 빌린 버퍼를 풀에 돌려주는 함수 (등급의 유휴 버퍼가 IOBUF_POOL_KEEP 개면 해제한다)
+ */
+static void pool_put(char *buf, int size) {
+    iobuf_class_t *cl = &pool[class_of(size)];
+
+    pthread_mutex_lock(&cl->lock);
+    if (cl->count < IOBUF_POOL_KEEP) {
+        *(char **)buf = cl->head;
+        cl->head = buf;
+        cl->count++;
+        buf = NULL;
+    }
+    pthread_mutex_unlock(&cl->lock);
+
+    free(buf);
+}
+
+/**
+ * 읽을 파일 디스크립터와 처음 버퍼 크기를 정하는 함수
+ *
+ * @param size 처음 버퍼 크기 (IOBUF_MIN ~ IOBUF_MAX 로 맞추고 2의 거듭제곱으로 올린다)
+ */
+void iobuf_init(iobuf_t *b, int fd, int size) {
+    b->fd = fd;
+    b->size = IOBUF_MIN;
+    while (b->size < size && b->size < IOBUF_MAX) {
+        b->size *= 2;
+    }
+    b->small = 0;
+    b->buf = b->bufptr = NULL;
+    b->bufsize = 0;
+    b->cnt = 0;
+}
+
+/**
+ * 읽지 않은 바이트를 복사하지 않고 보여 주는 함수
+ *
+ * 읽지 않은 바이트가 없을 때만 풀에서 버퍼를 빌려 read 를 한 번 한다. 그 결과로 다음 버퍼의
+ * 크기를 정한다: 가득 찼으면 두 배, 1/4 도 못 채운 read 가 IOBUF_SHRINK_AFTER 번 이어졌으면 절반.
+ * 읽지 못했으면 버퍼를 바로 돌려준다.
+ *
+ * @param bufp 읽지 않은 첫 바이트를 저장한다 (iobuf_consume 로 다 소비할 때까지 유효하다)
+ * @return 읽지 않은 바이트 수, EOF 면 0, 에러면 -1 (errno 는 read 의 것)
+ */
+ssize_t iobuf_peek(iobuf_t *b, char **bufp) {
+    ssize_t n;
+    int saved;
+
+    if (b->cnt == 0) {
+        b->buf = pool_get(b->size);
+        b->bufsize = b->size;
+        while ((n = read(b->fd, b->buf, b->bufsize)) < 0 && errno == EINTR) {
+            ;
+        }
+        if (n <= 0) {
+            saved = errno;
+            iobuf_release(b);
+            errno = saved;
+            return n;
+        }
+
+        b->bufptr = b->buf;
+        b->cnt = n;
+        if (n == b->bufsize) {
+            b->small = 0;
+            if (b->size < IOBUF_MAX) {
+                b->size *= 2;
+            }
+        } else if (n >= b->bufsize / 4) {
+            b->small = 0;
+        } else if (++b->small >= IOBUF_SHRINK_AFTER) {
+            b->small = 0;
+            if (b->size > IOBUF_MIN) {
+                b->size /= 2;
+            }
+        }
+    }
+
+    *bufp = b->bufptr;
+    return b->cnt;
+}
+
+/**
+ * iobuf_peek 으로 본 바이트 중 앞의 n 바이트를 읽은 것으로 하는 함수
+ *
+ * 다 소비하면 버퍼를 풀에 돌려준다.
+ */
+void iobuf_consume(iobuf_t *b, size_t n) {
+    if (n >= (size_t)b->cnt) {
+        iobuf_release(b);
+        return;
+    }
+    b->bufptr += n;
+    b->cnt -= n;
+}
+
+/**
+ * 읽지 않은 바이트를 버리고 버퍼를 풀에 돌려주는 함수 (빌린 버퍼가 없으면 아무 일도 하지 않는다)
+ */
+void iobuf_release(iobuf_t *b) {
+    if (b->buf != NULL) {
+        pool_put(b->buf, b->bufsize);
+    }
+    b->buf = b->bufptr = NULL;
+    b->cnt = 0;
+}
@@ -0,0 +1,43 @@
+/*
+ * iobuf.h - 처리량에 따라 크기가 바뀌고 공용 풀에서 빌리는 읽기 버퍼 (rio_t 의 변형)
+ *
+ * rio_t 는 8KB 버퍼가 구조체 안에 고정되어 있어, 빠른 목적지에서 큰 응답을 받을 때도
+ * read 한 번에 8KB 씩만 옮긴다 (1MB 에 read 가 약 125번). iobuf_t 는 버퍼 크기를 처음에 정하고,
+ * read 가 버퍼를 가득 채우면 다음 버퍼를 두 배로(최대 IOBUF_MAX), 작은 read 가 이어지면
+ * 절반으로(최소 IOBUF_MIN) 바꾼다.
+ *
+ * 버퍼는 크기 등급별 공용 풀에서 읽지 않은 바이트가 있는 동안만 빌린다. 다 소비하면 바로 풀에
+ * 돌려주므로, 목적지를 기다리거나 다음 요청을 기다리는 연결은 버퍼를 들고 있지 않는다.
+ *
+ * rio_peekb / rio_consumeb 처럼 iobuf_peek 으로 받은 바이트를 보고 iobuf_consume 으로 소비한다.
+ * 소켓이 non-blocking 이면 iobuf_peek 은 EAGAIN 으로 실패할 수 있다.
+ */
+#ifndef __IOBUF_H__
+#define __IOBUF_H__
+
+#include <sys/types.h>
+
+#define IOBUF_MIN_SHIFT     12                      // 가장 작은 등급: 4KB
+#define IOBUF_MAX_SHIFT     18                      // 가장 큰 등급: 256KB
+#define IOBUF_MIN           (1 << IOBUF_MIN_SHIFT)
+#define IOBUF_MAX           (1 << IOBUF_MAX_SHIFT)
+#define IOBUF_CLASSES       (IOBUF_MAX_SHIFT - IOBUF_MIN_SHIFT + 1)
+#define IOBUF_POOL_KEEP     8                       // 등급마다 풀에 남겨 두는 유휴 버퍼 수 (넘으면 free)
+#define IOBUF_SHRINK_AFTER  4                       // 버퍼의 1/4 도 못 채운 read 가 이만큼 이어지면 줄인다
+
+typedef struct {
+    int fd;
+    int size;                   // 다음에 빌릴 버퍼 크기 (2의 거듭제곱, IOBUF_MIN ~ IOBUF_MAX)
+    int small;                  // 버퍼의 1/4 도 못 채운 read 가 이어진 횟수
+    char *buf;                  // 풀에서 빌린 버퍼 (읽지 않은 바이트가 없으면 NULL)
+    int bufsize;                // 빌린 버퍼의 크기 (빌린 뒤에 size 가 바뀔 수 있다)
+    char *bufptr;               // 읽지 않은 첫 바이트
+    int cnt;                    // 읽지 않은 바이트 수
+} iobuf_t;
+
+void iobuf_init(iobuf_t *b, int fd, int size);
+ssize_t iobuf_peek(iobuf_t *b, char **bufp);
+void iobuf_consume(iobuf_t *b, size_t n);
+void iobuf_release(iobuf_t *b);
+
+#endif /* __IOBUF_H__ */
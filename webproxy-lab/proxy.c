@@ -1,41 +1,47 @@
 #include <stdio.h>
-#include "csapp.h"
-
-/* Recommended max cache and object sizes */
-#define MAX_CACHE_SIZE 1049000
-#define MAX_OBJECT_SIZE 102400
+#include <poll.h>
+#include "proxy.h"
+#include "sbuf.h"
+#include "flight.h"
+#include "framer.h"
+#include "upstream.h"
+#include "dns.h"
+#include "connect.h"
+#include "relay.h"
+#include "range.h"
+#include "iobuf.h"
+#include "respfilter.h"
 
 /* You won't lose style points for including this long line in your code */
 static const char *user_agent_hdr = "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:10.0.3) Gecko/20120305 Firefox/10.0.3\r\n";
 
-/* --------------- Cache Data Structures --------------- */
-// 캐시 블록 하나를 나타내는 구조체
-typedef struct CacheBlock {
-    char uri[MAXLINE];                      // key: 요청 URI
-    char object_data[MAX_OBJECT_SIZE];      // value: 웹 객체 데이터
-    int object_size;                        // 객체의 크기
-
-    struct CacheBlock *prev;                // 이전 블록을 가리키는 포인터
-    struct CacheBlock *next;                // 다음 블록을 가리키는 포인터
-} CacheBlock;
-
-// 캐시 전체를 관리하기 위한 전역 변수
-CacheBlock *cache_root;     // 캐시 연결 리스트의 시작점 (가장 최근에 사용한 블록)
-CacheBlock *cache_tail;     // 캐시 연결 리스트의 마지막 블록
-int total_cache_size;       // 현재 캐시에 저장된 모든 객체 크기의 합
-/* ----------------------------------------------------- */
-
 void doit(int fd);
-void read_requesthdrs(rio_t *rp, char *other_header);
-void parse_uri(char *uri, char *hostname, char *port, char *path);
-void reassemble(char *req, char *path, char *hostname, char *other_header);
 void forward_response(int serve_df, int  fd);
-void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg);
 void *handle_client_request(void *vargp);
-void init_cache();
-CacheBlock* find_cache_block(char *uri);
-void add_to_cache(char *uri, char *data, int size);
-void evict_lru_block();
+static void serve_client(int connfd);
+static int serve_request(int connfd, rio_t *rio_client);
+static void *pool_worker(void *vargp);
+static void usage(char *prog);
+static int open_origin(char *hostname, char *port, long deadline);
+static int wait_ready(int fd, short events, long deadline);
+static void sigusr1_handler(int sig);
+static int format_error_body(char *body, int maxlen, char *cause, char *errnum, char *shortmsg, char *longmsg);
+
+// 실행 옵션 (기본값: 연결마다 스레드 하나)
+proxy_config_t config = {
+    .mode = MODE_THREAD,
+    .nthreads = 16,
+    .queue_depth = 64,
+    .nresolvers = 4,
+    .connect_stagger_ms = 250,
+    .connect_attempt_ms = 5000,
+    .connect_timeout_ms = 10000,
+    .first_byte_timeout_ms = 30000,
+    .idle_timeout_ms = 30000,
+    .request_timeout_ms = 120000,
+};
+
+static sbuf_t conn_queue;   // pool 모드에서 메인 스레드와 작업 스레드가 공유하는 연결 대기열
 
 
 /**
@@ -46,19 +52,105 @@ void evict_lru_block();
  * @return 프로그램 종료 코드
  */
 int main(int argc, char **argv) {
-    int listenfd, connfd;
+    int listenfd, connfd, opt, i;
     char hostname[MAXLINE], port[MAXLINE];
     socklen_t clientlen;
     struct sockaddr_storage clientaddr;
 
+    /* 실행 옵션을 읽는다. */
+    while ((opt = getopt(argc, argv, "m:n:q:r:s:a:c:f:i:t:")) != -1) {
+        switch (opt) {
+        case 'm':
+            if (!strcmp(optarg, "thread")) {
+                config.mode = MODE_THREAD;
+            } else if (!strcmp(optarg, "pool")) {
+                config.mode = MODE_POOL;
+            } else if (!strcmp(optarg, "epoll")) {
+                config.mode = MODE_EPOLL;
+            } else {
+                usage(argv[0]);
+            }
+            break;
+        case 'n':
+            if ((config.nthreads = atoi(optarg)) <= 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 'q':
+            if ((config.queue_depth = atoi(optarg)) <= 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 'r':
+            if ((config.nresolvers = atoi(optarg)) <= 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 's':
+            if ((config.connect_stagger_ms = atoi(optarg)) <= 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 'a':
+            if ((config.connect_attempt_ms = atoi(optarg)) <= 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 'c':
+            if ((config.connect_timeout_ms = atoi(optarg)) <= 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 'f':
+            if ((config.first_byte_timeout_ms = atoi(optarg)) <= 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 'i':
+            if ((config.idle_timeout_ms = atoi(optarg)) <= 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 't':
+            if ((config.request_timeout_ms = atoi(optarg)) <= 0) {
+                usage(argv[0]);
+            }
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
     /* 프로그램 실행 시 포트 번호를 입력했는지 확인한다. */
-    if (argc != 2) {
-        fprintf(stderr, "usage: %s <port>\n", argv[0]);
-        exit(1);
+    if (optind != argc - 1) {
+        usage(argv[0]);
     }
 
+    // 클라이언트가 먼저 연결을 끊어도 SIGPIPE 로 프로세스 전체가 죽지 않도록 한다.
+    Signal(SIGPIPE, SIG_IGN);
+
+    // kill -USR1 로 DNS 캐시가 제대로 동작하는지 확인할 수 있게 한다.
+    Signal(SIGUSR1, sigusr1_handler);
+
+    init_cache();
+
     // 입력한 포트 번호로 클라이언트 연결을 기다리는 서버 소켓 열기
-    listenfd = Open_listenfd(argv[1]);
+    listenfd = Open_listenfd(argv[optind]);
+
+    // epoll 모드에서는 하나의 이벤트 루프가 모든 연결을 상태 기계로 처리한다.
+    if (config.mode == MODE_EPOLL) {
+        evloop_run(listenfd);
+        exit(0);
+    }
+
+    // pool 모드에서는 작업 스레드를 미리 만들어 두고 연결 대기열에서 꺼내 처리하게 한다.
+    if (config.mode == MODE_POOL) {
+        sbuf_init(&conn_queue, config.queue_depth);
+        for (i = 0; i < config.nthreads; i++) {
+            pthread_t tid;
+            Pthread_create(&tid, NULL, pool_worker, NULL);
+        }
+    }
 
     while (1) {
         clientlen = sizeof(clientaddr);
@@ -66,9 +158,17 @@ int main(int argc, char **argv) {
         connfd = Accept(listenfd, (SA *)&clientaddr, &clientlen);
 
         // 접속한 클라이언트의 IP 주소와 포트 번호 얻기
-        Getnameinfo((SA *)&clientaddr, clientlen, hostname, MAXLINE, port, MAXLINE, 0);
+        // (역방향 DNS 조회로 accept 루프가 멈추지 않도록 숫자 주소만 얻는다.)
+        Getnameinfo((SA *)&clientaddr, clientlen, hostname, MAXLINE, port, MAXLINE,
+                    NI_NUMERICHOST | NI_NUMERICSERV);
         printf("Accepted connection from (%s, %s)", hostname, port);
 
+        if (config.mode == MODE_POOL) {
+            // 대기열이 가득 차 있으면 작업 스레드가 연결을 꺼낼 때까지 기다린다.
+            sbuf_insert(&conn_queue, connfd);
+            continue;
+        }
+
         // doit 을 실행할 새로운 스레드 생성
         pthread_t tid;
 
@@ -76,11 +176,59 @@ int main(int argc, char **argv) {
         *connfd_ptr = connfd;
 
         // Pthread_create(스레드_식별자, 스레드_속성, 스레드가_수행할_함수, 스레드가_수행할_함수에_전달할_인자)
+        // 스레드는 handle_client_request 안에서 스스로 분리되어 종료 시 자원이 자동으로 해제된다.
         Pthread_create(&tid, NULL, handle_client_request, connfd_ptr);
+    }
+}
 
-        // 생성된 스레드를 즉시 분리하여 자원을 자동으로 해제하도록 함.
-        // Pthread_detach(tid);
+/**
+ * 사용법을 출력하고 종료하는 함수
+ *
+ * @param prog 실행 파일 이름
+ */
+static void usage(char *prog) {
+    fprintf(stderr, "usage: %s <port> [-m thread|pool|epoll] [-n nthreads] [-q queue_depth] [-r nresolvers]\n"
+                    "          [-s connect_stagger_ms] [-a connect_attempt_ms] [-c connect_timeout_ms]\n"
+                    "          [-f first_byte_timeout_ms] [-i idle_timeout_ms] [-t request_timeout_ms]\n", prog);
+    exit(1);
+}
+
+/**
+ * SIGUSR1 을 받으면 DNS 캐시의 히트/미스 수를 출력하는 핸들러
+ *
+ * 시그널 핸들러 안에서는 printf 대신 async-signal-safe 한 sio 함수를 쓴다.
+ */
+static void sigusr1_handler(int sig) {
+    long hits, misses;
+    int olderrno = errno;
+
+    dns_stats(&hits, &misses);
+    Sio_puts("DNS cache: hits=");
+    Sio_putl(hits);
+    Sio_puts(" misses=");
+    Sio_putl(misses);
+    Sio_puts("\n");
+    errno = olderrno;
+}
+
+/**
+ * pool 모드의 작업 스레드 함수
+ *
+ * 연결 대기열에서 connfd 를 하나씩 꺼내 처리하는 일을 반복한다.
+ * 스레드를 연결마다 새로 만들지 않으므로 clone 과 스택 매핑 비용이 없다.
+ *
+ * @param vargp 사용하지 않음
+ * @return 돌아오지 않는다
+ */
+static void *pool_worker(void *vargp) {
+    Pthread_detach(pthread_self());
+
+    while (1) {
+        int connfd = sbuf_remove(&conn_queue);
+        serve_client(connfd);
+        Close(connfd);
     }
+    return NULL;
 }
 
 /**
@@ -93,6 +241,7 @@ void doit(int fd) {
     char other_header[MAXLINE];                             // 헤더를 확인하고 저장할 버퍼
     char hostname[MAXLINE], port[MAXLINE], path[MAXLINE];   // 목적지 서버에 연결하기 위한 정보를 담을 버퍼
     char request_buf[MAXLINE];                              // 목적지 서버로 보낼 요청을 담을 버퍼
+    int keep_alive = 0;
     rio_t rio;
 
     // 4. GET, 메서드가 아니면 에러를 보낸다.
@@ -102,7 +251,7 @@ void doit(int fd) {
     }
     
     // 5. 나머지 요청 헤더를 읽는다.
-    read_requesthdrs(&rio, other_header);
+    read_requesthdrs(&rio, other_header, &keep_alive);
 
     // 6. URI를 파싱하여 호스트명, 포트, 경로를 추출한다.
     parse_uri(uri, hostname, port, path);
@@ -126,28 +275,114 @@ void doit(int fd) {
     forward_response(serve_df, fd);
 }
 
+/**
+ * 요청 라인과 헤더를 빈 줄까지 읽어 한 버퍼에 모으는 함수
+ *
+ * 다음 요청이 같은 rio 버퍼에 이어서 들어 있을 수 있으므로 빈 줄까지만 읽는다.
+ * 클라이언트 연결이 끊기거나 시간이 지나도 프로세스가 끝나지 않도록 rio_readlineb 를 쓴다.
+ * 모은 버퍼는 http_parse_request / http_parse_headers 가 복사 없이 나눈다.
+ *
+ * @param rp 읽기 작업을 수행할 rio 구조체 포인터
+ * @param buf 읽은 줄들을 저장할 버퍼
+ * @param maxlen buf 의 크기
+ * @return 빈 줄까지의 바이트 수, 그 전에 연결이 끊겼으면 0, buf 가 넘치면 -1
+ */
+int read_request_head(rio_t *rp, char *buf, int maxlen) {
+    int len = 0, n;
+
+    while (len < maxlen - 1 && (n = rio_readlineb(rp, buf + len, maxlen - len)) > 0) {
+        len += n;
+        if (buf[len - 1] != '\n') {
+            break;          // 줄이 버퍼를 넘었거나, 줄 중간에서 끊겼다
+        }
+        if (n == 1 || (n == 2 && buf[len - 2] == '\r')) {
+            return len;     // 빈 줄
+        }
+    }
+    return (len == maxlen - 1) ? -1 : 0;
+}
+
 /**
  * HTTP 요청 헤더를 읽고 필요한 헤더만 저장하는 함수
- * 
+ *
+ * 요청 라인은 이미 읽었을 때 쓴다.
+ *
  * @param rp 읽기 작업을 수행할 rio 구조체 포인터
  * @param other_header 유지할 헤더들을 저장할 버퍼
+ * @param keep_alive Connection 헤더를 보고 클라이언트가 연결을 유지하려는지 갱신한다
+ * @return 빈 줄까지 읽었으면 0, 그 전에 연결이 끊겼거나 헤더가 잘못되었으면 -1
  */
-void read_requesthdrs(rio_t *rp, char *other_header) {
-    char buf[MAXLINE];
+int read_requesthdrs(rio_t *rp, char *other_header, int *keep_alive) {
+    char buf[MAXBUF];
+    http_header_t headers[HTTP_MAX_HEADERS];
+    int len, num_headers;
 
     other_header[0] = '\0';
+    if ((len = read_request_head(rp, buf, sizeof(buf))) <= 0 ||
+        http_parse_headers(buf, len, headers, &num_headers) < 0) {
+        return -1;
+    }
+    filter_headers(headers, num_headers, other_header, MAXLINE, keep_alive);
+    return 0;
+}
 
-    while (Rio_readlineb(rp, buf, MAXLINE) > 0 && strcmp(buf, "\r\n")) {
-        // 무시할 헤더들 : reassemble 함수에서 새로 생성할 헤더들이다.
-        if (!strncasecmp(buf, "Host:", 5) ||
-            !strncasecmp(buf, "User-Agent:", 11) ||
-            !strncasecmp(buf, "Connection:", 11) ||
-            !strncasecmp(buf, "Proxy-Connection:", 17)) {
-            continue;
-        } else {
-            strcat(other_header, buf);
+/**
+ * 파서가 나눈 헤더들 중 목적지로 전달할 헤더만 모으는 함수
+ *
+ * 헤더의 종류는 파서가 이미 분류해 두었으므로 이름을 다시 비교하지 않는다.
+ * Host 와 User-Agent 는 reassemble 이 새로 만들고, Connection 계열과 Keep-Alive 는
+ * 클라이언트와의 연결에만 해당하는 hop-by-hop 헤더라서 버린다.
+ * keep_alive 는 요청 버전의 기본값(HTTP/1.1 이면 1)으로 시작하고, Connection / Proxy-Connection 이
+ * 있으면 그 값을 따른다. 스레드 모드와 epoll 모드가 함께 사용한다.
+ *
+ * @param headers http_parse_request / http_parse_headers 가 나눈 헤더들
+ * @param num_headers 헤더 수
+ * @param other_header 전달할 헤더 줄들을 저장할 버퍼
+ * @param maxlen other_header 의 크기 (넘치는 헤더는 버린다)
+ * @param keep_alive 갱신할 값
+ */
+void filter_headers(http_header_t *headers, int num_headers, char *other_header, int maxlen, int *keep_alive) {
+    http_header_t *h;
+    int len = 0, i;
+
+    for (i = 0; i < num_headers; i++) {
+        h = &headers[i];
+        if (h->kind == HDR_CONNECTION || h->kind == HDR_PROXY_CONNECTION) {
+            // 값은 쉼표로 구분된 토큰 목록이다. 둘 다 있으면 close 를 따른다.
+            if (framer_has_token(h->value, h->value_len, "close")) {
+                *keep_alive = 0;
+            } else if (framer_has_token(h->value, h->value_len, "keep-alive")) {
+                *keep_alive = 1;
+            }
+        } else if (h->kind == HDR_OTHER && len + h->name_len + h->value_len + 4 < maxlen) {
+            memcpy(other_header + len, h->name, h->name_len);
+            len += h->name_len;
+            memcpy(other_header + len, ": ", 2);
+            len += 2;
+            memcpy(other_header + len, h->value, h->value_len);
+            len += h->value_len;
+            memcpy(other_header + len, "\r\n", 2);
+            len += 2;
         }
     }
+    other_header[len] = '\0';
+}
+
+/**
+ * 파서가 나눈 요청 라인에서 메서드와 URI 를 NULL 문자로 끝나는 문자열로 꺼내는 함수
+ *
+ * @param req http_parse_request 의 결과
+ * @param method 메서드를 저장할 버퍼 (MAXLINE)
+ * @param uri URI 를 저장할 버퍼 (MAXLINE)
+ */
+void copy_request_line(http_request_t *req, char *method, char *uri) {
+    int mlen = (req->method_len < MAXLINE) ? req->method_len : MAXLINE - 1;
+    int ulen = (req->uri_len < MAXLINE) ? req->uri_len : MAXLINE - 1;
+
+    memcpy(method, req->method, mlen);
+    method[mlen] = '\0';
+    memcpy(uri, req->uri, ulen);
+    uri[ulen] = '\0';
 }
 
 /**
@@ -212,11 +447,10 @@ void parse_uri(char *uri, char *hostname, char *port, char *path) {
  */
 void reassemble(char *req, char *path, char *hostname, char *other_header) {
     snprintf(req, MAXLINE,
-        "GET %s HTTP/1.0\r\n"
+        "GET %s HTTP/1.1\r\n"
         "Host: %s\r\n"
         "%s"
-        "Connection: close\r\n"
-        "Proxy-Connection: close\r\n"
+        "Connection: keep-alive\r\n"
         "%s"
         "\r\n",
         path,
@@ -233,19 +467,19 @@ void reassemble(char *req, char *path, char *hostname, char *other_header) {
  * @param fd        클라이언트와 연결된 파일 디스크립터
  */
 void forward_response(int serve_df, int fd) {
-    rio_t serve_rio;
-    char response_buf[MAXBUF];
-
-    Rio_readinitb(&serve_rio, serve_df);
+    iobuf_t serve_buf;
+    char *data;
     ssize_t n;
 
+    iobuf_init(&serve_buf, serve_df, MAXBUF);
 
     // 목적지 서버가 아직 응답을 보내지 않아 소켓에 읽을 데이터가 없다면
-    // 이 프로그램은 Rio_readnb 라인에서 실행을 멈추고 대기(block)한다.
-    // 목적지 서버가 응답 데이터를 보내기 시작하면 serve_df 소켓으로 데이터가 수신된다.
-    while ((n = Rio_readnb(&serve_rio, response_buf, MAXBUF)) > 0) {
-        // 원래의 클라이언트(fd)에게 수신 데이터를 전달
-        rio_writen(fd, response_buf, n);
+    // 이 프로그램은 iobuf_peek 라인에서 실행을 멈추고 대기(block)한다.
+    // 받은 데이터는 사용자 버퍼로 옮기지 않고 읽은 버퍼에서 바로 클라이언트(fd)에게 보낸다.
+    // 한 번에 도착하는 양이 많으면 버퍼가 커져 read 횟수가 줄어든다.
+    while ((n = iobuf_peek(&serve_buf, &data)) > 0) {
+        rio_writen(fd, data, n);
+        iobuf_consume(&serve_buf, n);
     }
 }
 
@@ -260,10 +494,28 @@ void forward_response(int serve_df, int fd) {
  * @param longmsg 긴 에러 메시지
  */
 void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg){
-    char buf[MAXLINE], body[MAXBUF];
+    char body[MAXBUF];
+    rio_iov_t resp;
+    int len = format_error_body(body, sizeof(body), cause, errnum, shortmsg, longmsg);
+
+    // 헤더와 본문을 한 버퍼로 복사해 합치지 않고, 두 조각을 writev 한 번으로 보낸다.
+    rio_iovinit(&resp);
+    rio_iovprintf(&resp,
+            "HTTP/1.0 %s %s\r\n"           // 상태줄 예: HTTP/1.0 404 Not Found
+            "Content-type: text/html\r\n"  // MIME 타입 명시: HTML이라는 것을 알려줌
+            "Content-length: %d\r\n\r\n",  // 본문 길이 알려줌 + 빈 줄로 헤더 종료
+            errnum, shortmsg, len);
+    rio_iovadd(&resp, body, len);
+    rio_writev(fd, &resp);
+}
 
-    /* Build the HTTP response body */
-    snprintf(body, MAXBUF,
+/**
+ * 에러 응답의 HTML 본문을 만드는 함수 (clienterror 와 format_clienterror 가 함께 쓴다)
+ *
+ * @return 본문의 길이
+ */
+static int format_error_body(char *body, int maxlen, char *cause, char *errnum, char *shortmsg, char *longmsg) {
+    int len = snprintf(body, maxlen,
             "<html><title>Proxy Error</title>"
             "<body bgcolor=\"ffffff\">\r\n"
             "%s: %s\r\n"
@@ -271,200 +523,466 @@ void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longms
             "<hr><em>The Tiny Proxy server</em>\r\n"
             "</body></html>", errnum, shortmsg, longmsg, cause);
 
+    return (len < maxlen) ? len : maxlen - 1;
+}
+
+/**
+ * 에러 응답 전체(상태줄 + 헤더 + HTML 본문)를 버퍼에 만드는 함수
+ *
+ * 블로킹 소켓에 바로 쓰는 clienterror 와 달리, epoll 모드처럼
+ * 응답을 나눠서 보내야 하는 곳에서 사용한다.
+ *
+ * @param buf 응답을 저장할 버퍼
+ * @param maxlen 버퍼의 크기
+ * @return 만들어진 응답의 길이
+ */
+int format_clienterror(char *buf, int maxlen, char *cause, char *errnum, char *shortmsg, char *longmsg) {
+    char body[MAXBUF];
+    int len = format_error_body(body, sizeof(body), cause, errnum, shortmsg, longmsg);
+
     /* Print the HTTP response */
-    snprintf(buf, MAXLINE, "HTTP/1.0 %s %s\r\n", errnum, shortmsg);
-    Rio_writen(fd, buf, strlen(buf)); // 상태줄 전송 예: HTTP/1.0 404 Not Found
-    snprintf(buf, MAXLINE, "Content-type: text/html\r\n");
-    Rio_writen(fd, buf, strlen(buf)); // MIME 타입 명시: HTML이라는 것을 알려줌
-    snprintf(buf, MAXLINE, "Content-length: %d\r\n\r\n", (int)strlen(body));
-    Rio_writen(fd, buf, strlen(buf)); // 본문 길이 알려줌 + 빈 줄로 헤더 종료
-    Rio_writen(fd, body, strlen(body)); // 위에서 만든 HTML을 클라이언트에게 전송
+    len = snprintf(buf, maxlen,
+            "HTTP/1.0 %s %s\r\n"           // 상태줄 예: HTTP/1.0 404 Not Found
+            "Content-type: text/html\r\n"  // MIME 타입 명시: HTML이라는 것을 알려줌
+            "Content-length: %d\r\n\r\n"   // 본문 길이 알려줌 + 빈 줄로 헤더 종료
+            "%s",                           // 위에서 만든 HTML 본문
+            errnum, shortmsg, len, body);
+
+    return (len < maxlen) ? len : maxlen - 1;
 }
 
 
 /**
- * 클라이언트의 요청을 처리하는 스레드 함수
+ * 클라이언트의 요청을 처리하는 스레드 함수 (thread 모드)
  * 
  * @param vargp 클라이언트와 연결된 소켓 파일 디스크립터의 포인터
  * @return NULL (스레드 종료)
  */
 void *handle_client_request(void *vargp) {
-    char buf[MAXLINE], method[MAXLINE], uri[MAXLINE], version[MAXLINE];
-    char other_header[MAXLINE];                             // 헤더를 확인하고 저장할 버퍼
-    char hostname[MAXLINE], port[MAXLINE], path[MAXLINE];   // 목적지 서버에 연결하기 위한 정보를 담을 버퍼
-    char request_buf[MAXLINE];                              // 목적지 서버로 보낼 요청을 담을 버퍼
-    char response_buf[MAXLINE];
-    rio_t rio_client;
-    rio_t rio_server;
-
     // 인자에서 connfd 값을 안전하게 추출
     int connfd = *((int *) vargp);
 
     // 값 추출 후 즉시 메모리 해제 (더 이상 사용하지 않으므로)
     free(vargp);
 
-    // 1. 소켓에서 데이터를 읽을 준비하기
-    Rio_readinitb(&rio_client, connfd);
+    // 스레드를 분리하여 종료 시 스택 등 자원이 자동으로 해제되도록 한다.
+    Pthread_detach(pthread_self());
 
-    // 2. 클라이언트가 보낸 요청의 첫 줄(요청 라인) 읽기
-    Rio_readlineb(&rio_client, buf, MAXLINE);
-    printf("Request headers:\n");
-    printf("%s", buf);
+    serve_client(connfd);
 
-    // 3. 요청 라인에서 메서드 ,URI, HTTP 버전을 분리해 각 변수에 저장하기
-    sscanf(buf, "%s %s %s", method, uri, version);
+    // 연결 종료
+    Close(connfd);
 
-    CacheBlock *cache_block = find_cache_block(uri);
+    return NULL;
+}
 
-    if (cache_block != NULL) { // 캐시 히트
-        Rio_writen(connfd, cache_block->object_data, cache_block->object_size);
-    } else {                  // 캐시 미스
-        // 실제 요청 처리
-        // GET, 메서드가 아니면 에러를 보낸다.
-        if (strcasecmp(method, "GET") != 0) {
-            clienterror(connfd, method, "501", "Not implemented", "Tiny does not implement this method");
-            return NULL;
-        }
+/**
+ * 목적지 서버와 새로 연결하는 함수 (open_clientfd 를 대신한다)
+ *
+ * 주소는 DNS 캐시에서 얻고, 주소를 하나씩 블로킹 connect 로 시도하는 대신
+ * 여러 주소를 stagger 간격으로 경쟁시켜 가장 먼저 연결된 소켓을 쓴다.
+ * 그래서 응답 없는 주소가 목록 앞에 있어도 커널의 SYN 타임아웃을 기다리지 않는다.
+ *
+ * @param deadline 이 시각(ms)까지 연결하지 못하면 포기한다
+ * @return 연결된 소켓, 조회나 연결에 실패하면 CONNRACE_FAIL, 시간이 지나면 CONNRACE_TIMEOUT
+ */
+static int open_origin(char *hostname, char *port, long deadline) {
+    dns_result_t *res;
+    int fd, err;
 
-        // 나머지 요청 헤더를 읽는다.
-        read_requesthdrs(&rio_client, other_header);
+    if ((res = dns_lookup(hostname, port, &err)) == NULL) {
+        return CONNRACE_FAIL;
+    }
+    fd = race_connect(res->addrs, config.connect_stagger_ms, config.connect_attempt_ms, deadline);
+    dns_release(res);
+    return fd;
+}
 
-        // URI를 파싱하여 호스트명, 포트, 경로를 추출한다.
-        parse_uri(uri, hostname, port, path);
+/**
+ * 소켓이 준비될 때까지 deadline 까지만 기다리는 함수
+ *
+ * 블로킹 read 는 응답하지 않는 서버 앞에서 스레드를 영원히 붙잡으므로, 읽기 전에 poll 로 기다린다.
+ *
+ * @param events 기다릴 준비 상태 (POLLIN 또는 POLLOUT)
+ * @return 준비되었으면 (또는 연결 오류면) 1, 시각이 지나면 0
+ */
+static int wait_ready(int fd, short events, long deadline) {
+    struct pollfd pfd = { .fd = fd, .events = events };
+    long timeout;
+    int rc;
+
+    do {
+        timeout = deadline - monotonic_ms();
+        rc = poll(&pfd, 1, (timeout > 0) ? timeout : 0);
+    } while (rc < 0 && errno == EINTR);
+    return rc != 0;
+}
 
-        // 목적지 서버와 연결할 새로운 소켓을 생성한다.
-        int server_fd = Open_clientfd(hostname, port);
+/**
+ * 캐시하지 않을 응답의 남은 본문을 splice 로 목적지 소켓에서 클라이언트 소켓으로 옮기는 함수
+ *
+ * 바이트는 사용자 공간으로 복사되지 않고 파이프(커널 버퍼)를 거쳐 옮겨진다.
+ * 본문을 보지 않으므로 framer 에는 옮긴 바이트 수만 알려 준다.
+ * 양쪽 모두 idle_timeout_ms 동안 진행이 없거나 요청 전체의 deadline 이 지나면 멈춘다.
+ *
+ * @return 본문을 끝까지 옮겼으면 1, 목적지가 연결을 닫았으면 0, 실패하면 -1
+ */
+static ssize_t splice_body(int server_fd, int connfd, relay_t *rl, framer_t *fr, long deadline,
+                           int *client_gone, int *timed_out) {
+    long wait_until;
+    ssize_t n;
 
-        // Open_clientfd는 실패 시 -1을 반환하므로, 에러 처리가 필요하다.
-        if (server_fd < 0) {
-            clienterror(connfd, hostname, "502", "Bad Gateway", "Proxy could not connect to the host");
-            return NULL;
+    while (!framer_done(fr)) {
+        // 1. 목적지 소켓에서 파이프로 옮긴다.
+        wait_until = monotonic_ms() + config.idle_timeout_ms;
+        if (!wait_ready(server_fd, POLLIN, (wait_until < deadline) ? wait_until : deadline)) {
+            *timed_out = 1;
+            return -1;
+        }
+        if ((n = relay_fill(rl, server_fd, framer_body_left(fr))) <= 0) {
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            return n;
         }
+        framer_skip(fr, n);
+
+        // 2. 파이프에 든 바이트를 모두 클라이언트 소켓으로 옮긴다.
+        while (rl->len > 0) {
+            if (relay_drain(rl, connfd) >= 0 || errno == EINTR) {
+                continue;
+            }
+            wait_until = monotonic_ms() + config.idle_timeout_ms;
+            if (errno == EAGAIN &&
+                wait_ready(connfd, POLLOUT, (wait_until < deadline) ? wait_until : deadline)) {
+                continue;
+            }
+            *client_gone = 1;
+            return -1;
+        }
+    }
+    return 1;
+}
 
-        // 목적지 서버로 보낼 HTTP 요청 메시지를 새로 조립한다.
-        reassemble(request_buf, path, hostname, other_header);
+/**
+ * 목적지 서버에 요청을 보내고 응답을 받는 대로 클라이언트에게 전달하는 함수
+ *
+ * 응답 전체를 모은 뒤에 보내면 첫 바이트가 전체 다운로드 시간만큼 늦어지고 큰 응답은 버퍼를 넘치므로,
+ * 조각을 받을 때마다 바로 보내면서(tee) leader 라면 같은 조각을 flight 버퍼에도 덧붙인다.
+ *
+ * 목적지 연결은 keep-alive 풀에서 먼저 찾고, 응답의 끝을 framer 로 세어 끝까지 읽었으면 풀에 돌려놓는다.
+ *
+ * 연결, 첫 바이트, 조각 사이의 유휴 시간, 요청 전체에 각각 제한 시간을 두고, 하나라도 지나면 포기한다.
+ * 클라이언트에게 아직 아무것도 보내지 않았다면 504 를 보낸다.
+ *
+ * 헤더로 보아 캐시하지 않을 응답(너무 크거나 Cache-Control 이 막는 응답)이면 flight 에서 빠지고,
+ * 길이를 아는 본문은 splice_body 로 사용자 공간을 거치지 않고 옮긴다.
+ *
+ * 클라이언트에게는 respfilter 를 거쳐 hop-by-hop 헤더를 고쳐 쓴 응답을 보낸다.
+ * flight 버퍼에는 목적지의 응답을 그대로 덧붙인다 (follower 와 캐시 히트도 보낼 때 같은 필터를 거친다).
+ *
+ * @param connfd 클라이언트 소켓
+ * @param request_buf 목적지 서버로 보낼 요청
+ * @param flight leader 로서 채울 flight (직접 받아 오는 follower 면 NULL)
+ * @param rf 클라이언트에게 보낼 응답의 필터 (respfilter_init 으로 준비한 것)
+ * @param start 요청을 받은 시각 (ms, 전체 제한 시간의 기준)
+ * @return 응답이 끝까지 전달되었고 클라이언트 연결을 계속 쓸 수 있으면 1
+ */
+static int fetch_origin(int connfd, char *hostname, char *port, char *request_buf,
+                         flight_t *flight, respfilter_t *rf, long start) {
+    char *data;                 // iobuf 안의 읽은 조각
+    iobuf_t in;                 // 목적지 응답을 읽는 버퍼 (빠른 목적지면 커진다)
+    framer_t fr;
+    relay_t relay;
+    int server_fd, reused, attempt, got, client_gone = 0, extra = 0, timed_out = 0;
+    int replied = 0;            // 클라이언트에게 응답을 보내기 시작했으면 1
+    long deadline = start + config.request_timeout_ms, wait_until;
+    ssize_t n, len;
+
+    for (attempt = 0; ; attempt++) {
+        // 1. 풀에 유휴 연결이 있으면 다시 쓰고, 없으면 새로 연결한다.
+        //    (Open_clientfd 와 달리 open_origin 은 실패해도 프로세스를 끝내지 않으므로 직접 반환값을 확인한다.)
+        server_fd = (attempt == 0) ? upstream_get(hostname, port) : -1;
+        reused = (server_fd >= 0);
+        if (!reused) {
+            wait_until = monotonic_ms() + config.connect_timeout_ms;
+            server_fd = open_origin(hostname, port, (wait_until < deadline) ? wait_until : deadline);
+        }
 
-        // 조립한 HTTP 요청(request_bf)을 목적지 서버와 연결된 소켓(serve_df)을 통해 전송한다.
-        Rio_writen(server_fd, request_buf, strlen(request_buf));
+        // 2. 조립한 HTTP 요청(request_buf)을 목적지 서버와 연결된 소켓(server_fd)을 통해 전송한다.
+        if (server_fd >= 0 && rio_writen(server_fd, request_buf, strlen(request_buf)) < 0) {
+            Close(server_fd);
+            server_fd = CONNRACE_FAIL;
+            if (reused) {
+                continue;       // 풀에 있는 동안 서버가 닫은 연결: 새 연결로 다시 시도
+            }
+        }
+        if (server_fd < 0) {
+            if (replied) {
+                ;               // 응답을 보내기 시작했다면 에러 응답을 끼워 넣을 수 없다.
+            } else if (server_fd == CONNRACE_TIMEOUT) {
+                clienterror(connfd, hostname, "504", "Gateway Timeout", "Proxy timed out connecting to the host");
+            } else {
+                clienterror(connfd, hostname, "502", "Bad Gateway", "Proxy could not connect to the host");
+            }
+            if (flight != NULL) {
+                flight_finish(flight, 0);
+            }
+            return 0;
+        }
 
-        char full_response_buf[MAX_OBJECT_SIZE];
-        int total_size = 0;
-        ssize_t n;
-        rio_readinitb(&rio_server, server_fd);
+        // 3. iobuf_peek 은 rio_readnb 와 달리 버퍼를 다 채울 때까지 기다리지 않고 도착한 만큼 돌려준다.
+        //    한 번에 도착하는 양이 버퍼를 채우면 다음 read 의 버퍼를 키워(최대 256KB) read 횟수를 줄인다.
+        //    framer 가 응답의 끝이라고 알려 주면 연결이 닫히기를 기다리지 않고 멈춘다.
+        //    읽기 전에는 첫 바이트(또는 다음 조각)와 요청 전체의 제한 시간 중 이른 쪽까지만 기다린다.
+        framer_init(&fr);
+        iobuf_init(&in, server_fd, MAXBUF);
+        got = 0;
+        wait_until = monotonic_ms() + config.first_byte_timeout_ms;
+        for (;;) {
+            if (!wait_ready(server_fd, POLLIN, (wait_until < deadline) ? wait_until : deadline)) {
+                timed_out = 1;
+                n = -1;
+                break;
+            }
+            if ((n = iobuf_peek(&in, &data)) == 0) {
+                break;
+            }
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;          // 목적지 서버와의 연결 오류
+            }
+            got += n;
+            wait_until = monotonic_ms() + config.idle_timeout_ms;
+
+            len = framer_feed(&fr, data, n);
+            extra = (len < n);  // 응답 뒤에 남는 바이트가 있으면 그 연결은 다시 쓰지 않는다.
+
+            if (respfilter_write(connfd, rf, data, len) < 0) {
+                if (rf->state == RF_ERROR) {
+                    // 고쳐 쓸 수 없을 만큼 큰 헤더: 아직 아무것도 보내지 않았다
+                    clienterror(connfd, hostname, "502", "Bad Gateway", "Response header from the host is too large");
+                } else {
+                    client_gone = 1;    // 클라이언트가 연결을 끊었거나 받지 않은 채 유휴 시간이 지났다
+                }
+                break;
+            }
+            replied = (rf->state != RF_HEAD);   // 필터가 헤더를 다 모아 보냈다
+
+            // 캐시하지 않을 응답이면 flight 에서 빠진다. follower 들은 직접 받아 온다.
+            if (flight != NULL && framer_uncacheable(&fr)) {
+                flight_finish(flight, 0);
+                flight = NULL;
+            }
+            if (flight != NULL) {
+                flight_append(flight, data, len);
+            }
+            iobuf_consume(&in, n);      // 다 썼으므로 버퍼를 풀에 돌려준다
+            if (framer_done(&fr)) {
+                break;
+            }
+
+            // 캐시하지 않을 응답의 남은 본문은 splice 로 옮긴다.
+            if (framer_uncacheable(&fr) && framer_body_left(&fr) > 0 && relay_open(&relay) == 0) {
+                n = splice_body(server_fd, connfd, &relay, &fr, deadline, &client_gone, &timed_out);
+                relay_close(&relay);
+                break;
+            }
+        }
+        iobuf_release(&in);
 
-        // 목적지 서버로부터 받은 응답을 저장하기
-        while ((n = Rio_readnb(&rio_server, response_buf, MAXBUF)) > 0) {
-            memcpy(full_response_buf + total_size, response_buf, n);
-            total_size += n;
+        // 풀에서 꺼낸 연결이 한 바이트도 보내지 않고 닫혔다면 서버가 먼저 닫은 것이다.
+        if (reused && got == 0 && !client_gone && !timed_out) {
+            Close(server_fd);
+            continue;
         }
+        break;
+    }
 
-        // 캐시에 추가
-        add_to_cache(uri, full_response_buf, total_size);
+    // 제한 시간이 지났는데 아직 아무것도 보내지 않았다면 504 로 알린다.
+    if (timed_out && !replied) {
+        clienterror(connfd, hostname, "504", "Gateway Timeout", "Proxy timed out waiting for the host");
+    }
 
-        // full_response_buf 를 클라이언트에게 전송
-        Rio_writen(connfd, full_response_buf, total_size);
+    // 4. 응답을 온전히 받았고 크기 제한 안이면 캐시에 추가하고 follower 들에게 끝을 알린다.
+    //    길이 정보 없이 끝까지 읽은 응답이 아니라면, 연결이 닫혔다는 것은 응답이 잘렸다는 뜻이다.
+    if (flight != NULL) {
+        flight_finish(flight, !client_gone && (framer_done(&fr) || (n == 0 && framer_eof_ok(&fr))));
+    }
 
-        // 연결 종료
+    // 5. 응답을 끝까지 읽은 persistent 연결은 풀에 돌려놓고, 아니면 닫는다.
+    if (!client_gone && framer_persistent(&fr) && !extra) {
+        upstream_put(hostname, port, server_fd);
+    } else {
         Close(server_fd);
     }
 
-    // 연결 종료
-    Close(connfd);
-
-    return NULL;
+    return !client_gone && framer_done(&fr) && respfilter_persistent(rf);
 }
 
-
 /**
- * 캐시를 초기화하는 함수
- * 
- * 캐시의 루트와 테일 포인터를 NULL로 설정하고
- * 총 캐시 크기를 0으로 초기화한다.
+ * 클라이언트 연결 하나의 요청들을 차례로 처리하는 함수
+ *
+ * thread 모드와 pool 모드가 함께 사용한다. connfd 는 호출한 쪽에서 닫는다.
+ *
+ * HTTP/1.1 keep-alive 연결에서는 같은 rio 버퍼로 요청을 계속 읽는다. 클라이언트가 응답을 기다리지 않고
+ * 보낸(pipelined) 요청은 이미 rio 버퍼에 들어 있고, 한 번에 하나씩 처리하므로 응답 순서가 지켜진다.
+ * 다음 요청이 CLIENT_IDLE_TIMEOUT 초 안에 오지 않으면 연결을 닫아 작업 스레드를 놓아준다.
+ * 응답을 보내는 도중 클라이언트가 idle_timeout_ms 동안 받지 않아도 연결을 닫는다.
+ *
+ * @param connfd 클라이언트와 연결된 소켓 파일 디스크립터
  */
-void init_cache() {
-    cache_root = NULL;
-    cache_tail = NULL;
-    total_cache_size = 0;
-}
+static void serve_client(int connfd) {
+    struct timeval timeout = { CLIENT_IDLE_TIMEOUT, 0 };
+    struct timeval send_timeout = { config.idle_timeout_ms / 1000, (config.idle_timeout_ms % 1000) * 1000 };
+    rio_t rio_client;
 
-/**
- * 주어진 URI에 해당하는 캐시 블록을 찾는 함수
- * 
- * @param uri 검색할 URI 문자열
- * @return 찾은 캐시 블록의 포인터, 없으면 NULL
- */
-CacheBlock* find_cache_block(char *uri) {
-    CacheBlock *current = cache_root;
+    // 1. 소켓에서 데이터를 읽을 준비하기
+    //    응답을 받지 않는 클라이언트 때문에 쓰기가 막히면 유휴 시간이 지난 뒤 실패하게 한다.
+    Rio_readinitb(&rio_client, connfd);
+    setsockopt(connfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(connfd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
 
-    while (current != NULL) {
-        // current-> uri 와 uri 가 같으면 캐시 히트
-        if (strcmp(current->uri, uri) == 0) {
-            return current;
-        }
-        current = current->next;
+    // 2. 응답 뒤에도 연결을 유지할 수 있는 동안 다음 요청을 처리한다.
+    while (serve_request(connfd, &rio_client)) {
+        ;
     }
-
-    return NULL;
 }
 
 /**
- * 새로운 웹 객체를 캐시에 추가하는 함수
- * 
- * @param uri 캐시할 객체의 URI
- * @param data 캐시할 객체의 데이터
- * @param size 캐시할 객체의 크기
+ * 클라이언트 연결에서 요청 하나를 읽고 응답하는 함수
+ *
+ * 응답을 받은 클라이언트는 응답 헤더(버전, Connection, 길이 정보)를 보고 연결을 계속 쓸지 정한다.
+ * 그래서 클라이언트가 keep-alive 를 원하고, 클라이언트가 응답의 끝을 알 수 있을 때만 연결을 유지하고,
+ * 보내는 응답의 Connection 헤더는 respfilter 가 이 판단대로 고쳐 쓴다.
+ *
+ * @param connfd 클라이언트와 연결된 소켓 파일 디스크립터
+ * @param rio_client connfd 의 rio 버퍼 (요청 사이에 유지된다)
+ * @return 다음 요청을 계속 읽어도 되면 1, 연결을 닫아야 하면 0
  */
-void add_to_cache(char *uri, char *data, int size) {
-    // 1. 공간이 부족하면 충분해질 때까지 가장 오래된 블록을 제거한다.
-    while ((total_cache_size + size) > MAX_CACHE_SIZE) {
-        // evict_lru_block();
+static int serve_request(int connfd, rio_t *rio_client) {
+    char head[MAXBUF];                                      // 줄 단위로 모은 요청 라인과 헤더 (빈 줄까지)
+    char *view;                                             // rio 버퍼 안의 요청 (복사하지 않고 나눈 경우)
+    char method[MAXLINE], uri[MAXLINE];
+    char other_header[MAXLINE];                             // 헤더를 확인하고 저장할 버퍼
+    char hostname[MAXLINE], port[MAXLINE], path[MAXLINE];   // 목적지 서버에 연결하기 위한 정보를 담을 버퍼
+    char request_buf[MAXLINE];                              // 목적지 서버로 보낼 요청을 담을 버퍼
+    char response_buf[MAXBUF];                              // follower 가 leader 의 버퍼에서 읽어 온 조각
+    http_request_t req;                                     // 요청을 나눈 결과
+    respfilter_t rf;                                        // 클라이언트에게 보낼 응답의 hop-by-hop 헤더를 고쳐 쓰는 필터
+    int head_len, keep_alive, persistent = 0;
+    long start;                                             // 요청을 다 읽은 시각 (전체 제한 시간의 기준)
+
+    // 1. 요청 라인과 헤더를 빈 줄까지 읽는다. 다음 요청의 시작을 찾으려면 캐시 히트여도 끝까지 읽어야 한다.
+    //    요청이 rio 버퍼에 다 들어 있으면 복사하지 않고 그 자리에서 나누고(httpparse.c),
+    //    아직 다 오지 않았을 때만 줄 단위로 head 에 모은다.
+    //    연결이 닫혔거나 유휴 시간이 지나 읽지 못하면 연결을 끝낸다.
+    if ((head_len = rio_peekb(rio_client, &view)) <= 0) {
+        return 0;
+    }
+    if ((head_len = http_parse_request(view, head_len, 0, &req)) == HTTP_PARSE_PARTIAL) {
+        view = NULL;
+        if ((head_len = read_request_head(rio_client, head, sizeof(head))) <= 0) {
+            if (head_len < 0) {
+                clienterror(connfd, "", "400", "Bad Request", "Request header is too large");
+            }
+            return 0;
+        }
+        head_len = http_parse_request(head, head_len, 0, &req);
     }
+    start = monotonic_ms();
 
-    // 2. 새로운 캐시 블록을 위한 메모리 할당
-    CacheBlock *new_block = (CacheBlock *) malloc(sizeof(CacheBlock));
-
-    // 3. 새 블록에 데이터 복사 및 초기화
-    strcpy(new_block->uri, uri);
-    memcpy(new_block->object_data, data, size);  // 바이너리 데이터이므로 memcpy 사용
-    new_block->object_size = size;
-    new_block->prev = NULL;
-
-    // 4. 연결 리스트에 새 블록 삽입
-    if (cache_root == NULL) {    // 리스트가 비어 있을 경우
-        cache_tail = new_block;
-        new_block->next = NULL;
-    } else {                     // 기존 리스트가 있을 경우
-        cache_root->prev = new_block;
-        new_block->next = cache_root;
+    // 2. 나눈 조각들은 rio 버퍼나 head 안을 가리킨다. 요청이 아니면 400 을 보낸다.
+    if (head_len < 0) {
+        clienterror(connfd, "", "400", "Bad Request", "Proxy could not parse the request");
+        return 0;
     }
+    copy_request_line(&req, method, uri);
+    printf("Request headers:\n");
+    printf("%s %s HTTP/1.%d\n", method, uri, req.minor_version);
 
-    cache_root = new_block;     // cache_root 업데이트
-    total_cache_size += size;   // 캐시 사이즈 업데이트
-}
+    // 3. 목적지로 전달할 헤더만 모은다. Connection 계열은 클라이언트 연결을 유지할지 정하는 데 쓴다.
+    keep_alive = (req.minor_version >= 1);
+    filter_headers(req.headers, req.num_headers, other_header, sizeof(other_header), &keep_alive);
+    respfilter_init(&rf, req.minor_version == 0, keep_alive);
 
-/**
- * 가장 오래전에 사용된(Least Recently Used) 캐시 블록을 제거하는 함수
- */
-void evict_lru_block() {
-    // 캐시가 비어 있으면 아무것도 하지 않고 함수 종료
-    if (cache_tail == NULL) {
-        return;
+    // 필요한 조각은 모두 옮겨 적었으므로, rio 버퍼에서 나눈 요청은 이제 읽은 것으로 한다.
+    if (view != NULL) {
+        rio_consumeb(rio_client, head_len);
     }
 
-    // 캐시 용량 업데이트
-    total_cache_size -= cache_tail->object_size;
+    // GET 메서드가 아니면 에러를 보낸다. 본문이 있을 수 있으므로 연결은 닫는다.
+    if (strcasecmp(method, "GET") != 0) {
+        clienterror(connfd, method, "501", "Not implemented", "Tiny does not implement this method");
+        return 0;
+    }
 
-    CacheBlock *old_tail = cache_tail;
+    CacheBlock *cache_block = find_cache_block(uri);
 
-    // 리스트에 블록이 한 개만 있는 경우
-    if (cache_root == cache_tail) {
-        cache_root = NULL;
-        cache_tail = NULL;
-    } else {
-        cache_tail = cache_tail->prev;
-        cache_tail->next = NULL;
+    if (cache_block != NULL) { // 캐시 히트
+        // 블록은 고정되어 있어 전송 도중 evict 되어도 해제되지 않는다.
+        // 클라이언트가 끊겨 쓰기가 실패해도 블록은 반드시 놓아줘야 하므로 rio_writev 를 쓴다.
+        // 객체는 목적지가 보낸 그대로이므로 respfilter 로 헤더를 고쳐 쓰면서 보낸다.
+        // Range 요청이면 새로 쓴 헤더와 객체의 구간을 가리키는 조각들로 만든 206 응답을 대신 보낸다.
+        // 206 / 416 은 길이가 정해져 있으므로 클라이언트가 원하는 대로 연결을 유지한다.
+        rio_iov_t resp;
+
+        rio_iovinit(&resp);
+        if (range_reply(cache_block->object_data, cache_block->object_size, other_header, keep_alive, &resp)) {
+            persistent = (rio_writev(connfd, &resp) >= 0);
+        } else if (respfilter_write(connfd, &rf, cache_block->object_data, cache_block->object_size) >= 0) {
+            persistent = respfilter_persistent(&rf);
+        }
+        release_cache_block(cache_block);
+    } else {                  // 캐시 미스
+        // URI를 파싱하여 호스트명, 포트, 경로를 추출한다.
+        parse_uri(uri, hostname, port, path);
+
+        // 목적지 서버로 보낼 HTTP 요청 메시지를 새로 조립한다.
+        reassemble(request_buf, path, hostname, other_header);
+
+        // Range 요청은 Range 헤더째 전달하고, 받은 응답(객체의 일부)은 캐시하지 않는다.
+        // 같은 URI 의 다른 요청과 응답이 다르므로 flight 에도 참여하지 않는다.
+        // 연결을 닫을 요청이어도 응답은 보내야 하므로 fetch_origin 을 먼저 부른다.
+        if (range_requested(other_header)) {
+            persistent = fetch_origin(connfd, hostname, port, request_buf, NULL, &rf, start);
+            return keep_alive && persistent;
+        }
+
+        // 같은 URI 를 이미 받아 오고 있는 스레드가 있으면 그 응답을 따라 읽는다.
+        int leader;
+        flight_t *flight = flight_join(uri, &leader);
+
+        if (leader) {
+            persistent = fetch_origin(connfd, hostname, port, request_buf, flight, &rf, start);
+        } else {
+            int sent = 0, n;
+
+            // leader 의 버퍼에 새 데이터가 올 때마다 깨어나 필터를 거쳐 클라이언트에게 보낸다.
+            while ((n = flight_read(flight, sent, response_buf, MAXBUF, 1)) > 0) {
+                if (respfilter_write(connfd, &rf, response_buf, n) < 0) {
+                    if (rf.state == RF_ERROR) {
+                        clienterror(connfd, hostname, "502", "Bad Gateway", "Response header from the host is too large");
+                    }
+                    break;      // 클라이언트가 연결을 끊었다
+                }
+                sent += n;
+            }
+            flight_release(flight);
+            persistent = (n == FLIGHT_EOF) && respfilter_persistent(&rf);
+
+            // leader 가 실패했거나 객체가 너무 커서 버퍼가 버려졌다.
+            // 필터가 헤더를 모으는 중이라 아직 아무것도 보내지 않았으면 필터를 비우고 직접 받아 온다.
+            // 새로 받은 응답은 leader 가 받던 응답과 바이트 단위로 같다는 보장이 없으므로
+            // (Date, chunk 크기, 동적인 본문 등), 이미 일부를 보냈다면 이어 붙이지 않고 연결을 닫는다.
+            if (n == FLIGHT_BROKEN && rf.state == RF_HEAD) {
+                respfilter_init(&rf, req.minor_version == 0, keep_alive);
+                persistent = fetch_origin(connfd, hostname, port, request_buf, NULL, &rf, start);
+            }
+        }
     }
 
-    // 메모리 해제
-    free(old_tail);
-}
\ No newline at end of file
+    return keep_alive && persistent;
+}
@@ -0,0 +1,49 @@
+/*
+ * proxy.h - 프록시 서버의 여러 소스 파일이 함께 사용하는 선언
+ */
+#ifndef __PROXY_H__
+#define __PROXY_H__
+
+#include "csapp.h"
+#include "cache.h"
+#include "httpparse.h"
+
+/* 연결을 처리하는 방식 */
+typedef enum {
+    MODE_THREAD,        // 연결마다 스레드 하나를 만든다
+    MODE_POOL,          // 미리 만든 작업 스레드들이 연결 대기열에서 꺼내 처리한다
+    MODE_EPOLL          // 하나의 epoll 이벤트 루프가 모든 연결을 처리한다
+} proxy_mode_t;
+
+/* 실행 옵션 */
+typedef struct {
+    proxy_mode_t mode;  // -m: 연결 처리 방식
+    int nthreads;       // -n: pool 모드의 작업 스레드 수
+    int queue_depth;    // -q: pool 모드의 연결 대기열 크기
+    int nresolvers;     // -r: epoll 모드에서 주소 조회를 맡는 resolver 스레드 수
+    int connect_stagger_ms;     // -s: 앞 connect 시도를 기다렸다가 다음 주소를 시작하기까지의 시간 (ms)
+    int connect_attempt_ms;     // -a: connect 시도 하나의 제한 시간 (ms)
+    int connect_timeout_ms;     // -c: 주소 조회와 연결을 마쳐야 하는 시간 (ms)
+    int first_byte_timeout_ms;  // -f: 요청을 보낸 뒤 응답의 첫 바이트가 와야 하는 시간 (ms)
+    int idle_timeout_ms;        // -i: 응답을 주고받는 도중 아무것도 오가지 않아도 되는 시간 (ms)
+    int request_timeout_ms;     // -t: 요청 하나를 끝내야 하는 전체 시간 (ms)
+} proxy_config_t;
+
+extern proxy_config_t config;
+
+#define CLIENT_IDLE_TIMEOUT 10  // keep-alive 클라이언트 연결이 다음 요청 없이 기다릴 수 있는 시간 (초)
+
+/* proxy.c */
+int read_request_head(rio_t *rp, char *buf, int maxlen);
+int read_requesthdrs(rio_t *rp, char *other_header, int *keep_alive);
+void filter_headers(http_header_t *headers, int num_headers, char *other_header, int maxlen, int *keep_alive);
+void copy_request_line(http_request_t *req, char *method, char *uri);
+void parse_uri(char *uri, char *hostname, char *port, char *path);
+void reassemble(char *req, char *path, char *hostname, char *other_header);
+void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg);
+int format_clienterror(char *buf, int maxlen, char *cause, char *errnum, char *shortmsg, char *longmsg);
+
+/* evloop.c */
+void evloop_run(int listenfd);
+
+#endif /* __PROXY_H__ */
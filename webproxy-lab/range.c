@@ -0,0 +1,286 @@
+/*
+ * range.c - 캐시된 객체로 Range 요청에 답하는 206 Partial Content 응답 생성기
+ *
+ * 캐시 블록에는 목적지 서버가 보낸 응답이 헤더까지 그대로 들어 있다. 길이가 정해진 온전한 200 응답이면
+ * 새로 쓰는 줄과 객체 안의 구간을 가리키는 조각들(rio_iov_t)로 새 응답을 만들어 writev 로 보낸다.
+ * 원래 헤더는 대부분 그대로 두고, 상태 라인과 길이 관련 헤더(Content-Length, Content-Range,
+ * 여러 구간이면 Content-Type)만 바꾼다. 요청한 바이트만 보내고, 본문은 복사하지 않는다.
+ */
+#include <ctype.h>
+#include <limits.h>
+#include "range.h"
+#include "framer.h"
+#include "respfilter.h"
+
+/* multipart/byteranges 에서 구간마다 앞에 붙는 경계와 부분 헤더 */
+#define PART_HEADER "\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %lld-%lld/%lld\r\n\r\n"
+#define PART_END    "\r\n--%s--\r\n"
+
+
+/**
+ * CRLF 로 끝나는 헤더 줄들에서 헤더 하나의 값을 찾는 함수
+ *
+ * @param headers 헤더 줄들 (NULL 문자로 끝나지 않아도 된다)
+ * @param len headers 의 길이
+ * @param name 찾을 헤더 이름 (콜론 포함, 예: "Range:")
+ * @param value 앞뒤 공백을 뺀 값을 저장할 버퍼
+ * @param maxlen value 의 크기
+ * @return 찾았으면 1, 없으면 0
+ */
+static int find_header(const char *headers, int len, const char *name, char *value, int maxlen) {
+    const char *line = headers, *end = headers + len, *eol;
+    int nlen = strlen(name), vlen;
+
+    for (; line < end; line = eol + 1) {
+        for (eol = line; eol < end && *eol != '\n'; eol++) {
+            ;
+        }
+        if (eol - line < nlen || strncasecmp(line, name, nlen) != 0) {
+            continue;
+        }
+        line += nlen;
+        while (line < eol && (*line == ' ' || *line == '\t')) {
+            line++;
+        }
+        vlen = eol - line;
+        while (vlen > 0 && isspace((unsigned char)line[vlen - 1])) {
+            vlen--;
+        }
+        if (vlen >= maxlen) {
+            return 0;       // 너무 긴 값은 없는 것으로 본다
+        }
+        memcpy(value, line, vlen);
+        value[vlen] = '\0';
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * "bytes=0-99,200-,-50" 같은 Range 값을 객체 크기에 맞는 구간들로 바꾸는 함수
+ *
+ * 끝이 없는 구간(200-)은 객체 끝까지, 뒤에서부터 센 구간(-50)은 마지막 50바이트다.
+ * 끝이 객체 크기를 넘으면 객체 끝으로 줄이고, 시작이 객체 밖인 구간은 뺀다.
+ * 문법이 틀렸거나 구간이 max 개를 넘으면 Range 헤더가 없는 것처럼 전체를 보내도록 0 을 돌려준다.
+ *
+ * @param value Range 헤더의 값
+ * @param size 본문의 크기
+ * @param ranges 구간을 저장할 배열
+ * @param max 배열의 크기
+ * @return 구간의 수, 무시해야 하면 0, 객체 안에 드는 구간이 없으면 RANGE_UNSATISFIABLE
+ */
+int parse_range(char *value, long long size, byte_range_t *ranges, int max) {
+    char *p, *end;
+    long long first, last;
+    int n = 0, specs = 0;
+
+    if (strncasecmp(value, "bytes=", 6) != 0) {
+        return 0;
+    }
+    for (p = value + 6; ; p = end + 1) {
+        p += strspn(p, " \t");
+        if (*p == ',') {
+            end = p;
+            continue;       // 빈 항목은 건너뛴다
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (++specs > max) {
+            return 0;
+        }
+
+        if (*p == '-') {
+            // 뒤에서부터 센 구간: -N
+            if (!isdigit((unsigned char)p[1])) {
+                return 0;
+            }
+            last = strtoll(p + 1, &end, 10);
+            first = (last < size) ? size - last : 0;
+            last = (last > 0) ? size - 1 : -1;
+        } else {
+            // first-last 또는 first-
+            if (!isdigit((unsigned char)*p)) {
+                return 0;
+            }
+            first = strtoll(p, &end, 10);
+            if (*end != '-') {
+                return 0;
+            }
+            p = end + 1;
+            if (isdigit((unsigned char)*p)) {
+                last = strtoll(p, &end, 10);
+                if (last < first) {
+                    return 0;
+                }
+            } else {
+                last = LLONG_MAX;
+                end = p;
+            }
+            if (last >= size) {
+                last = size - 1;
+            }
+        }
+        end += strspn(end, " \t");
+        if (*end != ',' && *end != '\0') {
+            return 0;
+        }
+
+        // 객체 안에 드는 구간만 남긴다.
+        if (first < size && first <= last) {
+            ranges[n].first = first;
+            ranges[n].last = last;
+            n++;
+        }
+        if (*end == '\0') {
+            break;
+        }
+    }
+
+    if (specs == 0) {
+        return 0;
+    }
+    return (n > 0) ? n : RANGE_UNSATISFIABLE;
+}
+
+/**
+ * 클라이언트 요청에 Range 헤더가 있는지 확인하는 함수
+ *
+ * @param headers 목적지로 전달할 요청 헤더들 (read_requesthdrs 가 모은 other_header)
+ * @return Range 헤더가 있으면 1
+ */
+int range_requested(char *headers) {
+    char value[MAXLINE];
+
+    return find_header(headers, strlen(headers), "Range:", value, sizeof(value));
+}
+
+/**
+ * 206 / 416 응답에 옮기지 않을 원래 응답의 헤더인지 확인하는 함수
+ *
+ * 목적지 연결에만 해당하는 hop-by-hop 헤더도 옮기지 않는다 (Connection 은 새로 쓴다).
+ *
+ * @param line 원래 응답의 헤더 한 줄
+ * @param len 줄의 길이
+ * @param single 구간이 하나면 1 (본문의 Content-Type 이 그대로 맞는다)
+ * @param tokens 원래 응답의 Connection 헤더 값 (없으면 "")
+ */
+static int is_replaced_header(const char *line, int len, int single, const char *tokens) {
+    return is_hop_header(line, len, tokens) ||
+           !strncasecmp(line, "Content-Length:", 15) ||
+           !strncasecmp(line, "Content-Range:", 14) ||
+           (!single && !strncasecmp(line, "Content-Type:", 13));
+}
+
+/**
+ * 캐시된 객체에서 Range 요청에 맞는 응답을 만드는 함수
+ *
+ * 다음 경우에는 0 을 돌려주고, 호출한 쪽은 객체를 그대로(200) 보낸다.
+ * - 요청에 Range 가 없거나 문법이 틀렸다.
+ * - 객체가 길이가 정해진 200 응답이 아니다 (에러 응답, chunked 본문 등).
+ * - If-Range 의 검증자가 객체의 ETag / Last-Modified 와 다르다.
+ * - 새로 만드는 헤더가 resp 에 다 들어가지 않는다.
+ *
+ * 응답은 복사해 만들지 않는다. 새로 만드는 줄(상태 라인, 길이 헤더, 부분 헤더)만 resp 에 적고,
+ * 원래 헤더와 본문의 구간은 객체 안을 가리키는 조각으로 넣는다. 그래서 보낼 때까지 객체가
+ * 해제되지 않아야 한다 (캐시 블록을 고정해 둔다).
+ *
+ * @param object 캐시된 응답 (상태 라인, 헤더, 본문)
+ * @param size 응답의 크기
+ * @param headers 클라이언트의 요청 헤더들
+ * @param keep_alive 클라이언트가 응답 뒤에도 연결을 유지하려 하면 1 (응답의 Connection 헤더가 된다)
+ * @param resp 206 또는 416 응답의 조각들을 담을 곳 (rio_iovinit 으로 비워 둔 것)
+ * @return resp 에 응답을 만들었으면 1, 객체를 그대로 보내야 하면 0
+ */
+int range_reply(char *object, int size, char *headers, int keep_alive, rio_iov_t *resp) {
+    char range[MAXLINE], cond[MAXLINE], validator[MAXLINE], ctype[MAXLINE], boundary[64], tokens[MAXLINE];
+    byte_range_t ranges[MAX_RANGES];
+    framer_t fr;
+    char *line, *eol, *body, *hdr_end, *name;
+    long long body_len, total = 0;
+    int n, i, ok;
+
+    // 1. Range 헤더가 없으면 객체를 그대로 보낸다.
+    if (!find_header(headers, strlen(headers), "Range:", range, sizeof(range))) {
+        return 0;
+    }
+
+    // 2. 본문을 잘라 낼 수 있는 객체인지 확인한다: Content-Length 가 있는 온전한 200 응답
+    framer_init(&fr);
+    framer_feed(&fr, object, size);
+    if (fr.status != 200 || fr.chunked || fr.content_length < 0 ||
+        fr.header_len + fr.content_length != size) {
+        return 0;
+    }
+    body = object + fr.header_len;
+    body_len = fr.content_length;
+    hdr_end = body - 2;     // 헤더 끝의 빈 줄
+
+    // 3. If-Range 가 있으면 검증자가 캐시된 객체와 같을 때만 구간을 보낸다.
+    //    따옴표로 시작하면 ETag, 아니면 Last-Modified 날짜다.
+    if (find_header(headers, strlen(headers), "If-Range:", cond, sizeof(cond))) {
+        name = (cond[0] == '"') ? "ETag:" : "Last-Modified:";
+        if (!find_header(object, fr.header_len, name, validator, sizeof(validator)) ||
+            strcmp(cond, validator) != 0) {
+            return 0;
+        }
+    }
+
+    if ((n = parse_range(range, body_len, ranges, MAX_RANGES)) == 0) {
+        return 0;
+    }
+
+    // 4. 상태 라인은 원래 버전으로 새로 쓰고, 원래 헤더는 바꿀 것만 빼고 객체 안을 가리킨다.
+    //    이어진 줄들은 rio_iovadd 가 한 조각으로 합친다. 길이가 정해진 응답이므로 연결 유지는
+    //    클라이언트가 원하는 대로 한다.
+    if (!find_header(object, fr.header_len, "Connection:", tokens, sizeof(tokens))) {
+        tokens[0] = '\0';
+    }
+    ok = rio_iovprintf(resp, "HTTP/1.%c %s\r\n", object[7],
+                       (n == RANGE_UNSATISFIABLE) ? "416 Range Not Satisfiable" : "206 Partial Content") == 0;
+    for (line = (char *)memchr(object, '\n', fr.header_len) + 1; ok && line < hdr_end; line = eol) {
+        eol = (char *)memchr(line, '\n', hdr_end - line) + 1;
+        if (!is_replaced_header(line, eol - line, n == 1, tokens)) {
+            ok = rio_iovadd(resp, line, eol - line) == 0;
+        }
+    }
+    ok = ok && rio_iovprintf(resp, "Connection: %s\r\n", keep_alive ? "keep-alive" : "close") == 0;
+
+    // 5. 구간에 맞는 헤더를 새로 쓰고, 본문은 객체의 구간을 가리킨다.
+    if (!ok) {
+        ;
+    } else if (n == RANGE_UNSATISFIABLE) {
+        ok = rio_iovprintf(resp, "Content-Range: bytes */%lld\r\nContent-Length: 0\r\n\r\n", body_len) == 0;
+    } else if (n == 1) {
+        total = ranges[0].last - ranges[0].first + 1;
+        ok = rio_iovprintf(resp, "Content-Range: bytes %lld-%lld/%lld\r\nContent-Length: %lld\r\n\r\n",
+                           ranges[0].first, ranges[0].last, body_len, total) == 0 &&
+             rio_iovadd(resp, body + ranges[0].first, total) == 0;
+    } else {
+        // 여러 구간: 본문의 길이(부분 헤더 + 구간들 + 마지막 경계)를 먼저 센다.
+        if (!find_header(object, fr.header_len, "Content-Type:", ctype, sizeof(ctype))) {
+            strcpy(ctype, "application/octet-stream");
+        }
+        snprintf(boundary, sizeof(boundary), "PROXY%llx%x", body_len, (unsigned)(uintptr_t)object);
+        for (i = 0; i < n; i++) {
+            total += ranges[i].last - ranges[i].first + 1;
+            total += snprintf(NULL, 0, PART_HEADER, boundary, ctype,
+                              ranges[i].first, ranges[i].last, body_len);
+        }
+        total += snprintf(NULL, 0, PART_END, boundary);
+
+        ok = rio_iovprintf(resp, "Content-Type: multipart/byteranges; boundary=%s\r\nContent-Length: %lld\r\n\r\n",
+                           boundary, total) == 0;
+        for (i = 0; ok && i < n; i++) {
+            ok = rio_iovprintf(resp, PART_HEADER, boundary, ctype, ranges[i].first, ranges[i].last, body_len) == 0 &&
+                 rio_iovadd(resp, body + ranges[i].first, ranges[i].last - ranges[i].first + 1) == 0;
+        }
+        ok = ok && rio_iovprintf(resp, PART_END, boundary) == 0;
+    }
+
+    // 만들다 만 응답은 버리고 객체를 그대로 보낸다 (Range 를 무시해도 올바른 응답이다).
+    if (!ok) {
+        rio_iovinit(resp);
+    }
+    return ok;
+}
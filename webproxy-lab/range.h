@@ -0,0 +1,27 @@
+/*
+ * range.h - 캐시된 객체로 Range 요청에 답하는 206 Partial Content 응답 생성기
+ *
+ * 동영상을 넘겨 보거나 끊긴 다운로드를 이어 받는 클라이언트는 "Range: bytes=..." 로 객체의 일부만
+ * 요청한다. 캐시에 온전한 200 응답이 있으면 요청한 구간만 잘라 206 응답(구간이 여럿이면
+ * multipart/byteranges)을 만들어 보내고, 캐시에 없으면 Range 헤더를 그대로 목적지로 전달한다.
+ * 206 응답은 객체의 일부이므로 캐시하지 않는다.
+ */
+#ifndef __RANGE_H__
+#define __RANGE_H__
+
+#include "csapp.h"
+
+#define MAX_RANGES          16      // 한 요청에서 받아 주는 구간 수 (넘으면 Range 를 무시하고 전체를 보낸다)
+#define RANGE_UNSATISFIABLE -1      // parse_range: 객체 안에 드는 구간이 하나도 없다 (416)
+
+/* 요청한 바이트 구간 [first, last] */
+typedef struct {
+    long long first;
+    long long last;
+} byte_range_t;
+
+int parse_range(char *value, long long size, byte_range_t *ranges, int max);
+int range_requested(char *headers);
+int range_reply(char *object, int size, char *headers, int keep_alive, rio_iov_t *resp);
+
+#endif /* __RANGE_H__ */
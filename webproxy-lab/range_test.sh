@@ -0,0 +1,98 @@
+#!/bin/bash
+#
+# range_test.sh - Regression checks for Range requests through the proxy
+#     ("make check"). Starts tiny and the proxy in each mode and fetches
+#     byte ranges on a cache miss and on a cache hit, including requests
+#     that ask to close the connection.
+#
+#     usage: ./range_test.sh
+#
+
+TIMEOUT=5
+TINY_DIR="./tiny"
+FILE="godzilla.gif"
+failures=0
+
+#
+# check - compare a result with the expected value
+# usage: check <got> <expected> <what>
+#
+function check {
+    if [ "$1" != "$2" ]; then
+        echo "FAIL $3 (got '$1', expected '$2')"
+        failures=$((failures + 1))
+    fi
+}
+
+#
+# wait_for_server - spin until a server answers on the port (5 seconds)
+# usage: wait_for_server <port>
+#
+function wait_for_server {
+    for i in $(seq 50); do
+        curl --silent --max-time 1 --output /dev/null http://localhost:$1/ && return 0
+        (( $? == 52 || $? == 56 )) && return 0
+        sleep 0.1
+    done
+    return 1
+}
+
+#
+# fetch_range - fetch a range of the test file through the proxy and
+#     print "<status> <md5 of the body>"
+# usage: fetch_range <range> [curl options]
+#
+function fetch_range {
+    local range=$1
+    shift
+    : > ${tmp}
+    curl --silent --max-time ${TIMEOUT} --proxy http://localhost:${proxy_port} \
+         --range ${range} --output ${tmp} --write-out "%{http_code}" "$@" \
+         http://localhost:${tiny_port}/${FILE}
+    echo " $(md5sum < ${tmp} | cut -d' ' -f1)"
+}
+
+#
+# expected - print "206 <md5 of bytes first..last of the test file>"
+# usage: expected <first> <last>
+#
+function expected {
+    echo "206 $(tail -c +$(($1 + 1)) ${TINY_DIR}/${FILE} | head -c $(($2 - $1 + 1)) | md5sum | cut -d' ' -f1)"
+}
+
+tmp=$(mktemp)
+trap 'kill ${proxy_pid} ${tiny_pid} 2> /dev/null; rm -f ${tmp}' EXIT
+
+for mode in thread pool epoll; do
+    tiny_port=$(((RANDOM % 20000) + 20000))
+    proxy_port=$((tiny_port + 1))
+
+    (cd ${TINY_DIR}; exec ./tiny ${tiny_port} &> /dev/null) &
+    tiny_pid=$!
+    ./proxy ${proxy_port} -m ${mode} &> /dev/null &
+    proxy_pid=$!
+    if ! wait_for_server ${tiny_port} || ! wait_for_server ${proxy_port}; then
+        echo "FAIL ${mode}: servers did not start"
+        failures=$((failures + 1))
+        continue
+    fi
+
+    # Cache miss: ranged requests are forwarded even when the client closes the connection.
+    check "$(fetch_range 0-9 -H 'Connection: close')" "$(expected 0 9)" "${mode}: miss with Connection: close"
+    check "$(fetch_range 10-19 --http1.0 -H 'Proxy-Connection:')" "$(expected 10 19)" "${mode}: miss from HTTP/1.0"
+    check "$(fetch_range 20-29)" "$(expected 20 29)" "${mode}: miss with keep-alive"
+
+    # Cache hit: fill the cache with the whole object, then take ranges from it.
+    curl --silent --max-time ${TIMEOUT} --proxy http://localhost:${proxy_port} \
+         --output /dev/null http://localhost:${tiny_port}/${FILE}
+    check "$(fetch_range 30-39 -H 'Connection: close')" "$(expected 30 39)" "${mode}: hit with Connection: close"
+    check "$(fetch_range 40-49)" "$(expected 40 49)" "${mode}: hit with keep-alive"
+
+    kill ${proxy_pid} ${tiny_pid}
+    wait ${proxy_pid} ${tiny_pid} 2> /dev/null
+done
+
+if [ ${failures} == 0 ]; then
+    echo "range: all tests passed"
+fi
+exit $((failures != 0))
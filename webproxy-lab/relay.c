@@ -0,0 +1,88 @@
+/*
+ * relay.c - splice 로 소켓에서 소켓으로 바이트를 옮기는 pass-through 전달기
+ *
+ * splice 와 pipe2 는 GNU 확장이라 _GNU_SOURCE 가 필요하다. csapp.h 의 gai_error 가
+ * GNU 확장의 같은 이름과 충돌하므로 이 파일에서는 csapp.h 를 포함하지 않는다.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <unistd.h>
+#include "relay.h"
+
+
+/**
+ * 파이프를 열지 않은 상태로 초기화하는 함수
+ */
+void relay_init(relay_t *r) {
+    r->pipefd[0] = r->pipefd[1] = -1;
+    r->size = 0;
+    r->len = 0;
+}
+
+/**
+ * 옮기는 데 쓸 파이프를 여는 함수
+ *
+ * 파이프를 키우지 못하면 기본 크기(보통 64KB)로 쓴다.
+ *
+ * @return 성공하면 0, 파이프를 열 수 없으면 -1 (호출한 쪽은 read/write 로 전달한다)
+ */
+int relay_open(relay_t *r) {
+    if (pipe2(r->pipefd, O_NONBLOCK | O_CLOEXEC) < 0) {
+        r->pipefd[0] = r->pipefd[1] = -1;
+        return -1;
+    }
+    if ((r->size = fcntl(r->pipefd[1], F_SETPIPE_SZ, RELAY_PIPE_SIZE)) < 0) {
+        r->size = fcntl(r->pipefd[1], F_GETPIPE_SZ);
+    }
+    r->len = 0;
+    return 0;
+}
+
+/**
+ * 파이프를 닫는 함수 (열지 않았으면 아무 일도 하지 않는다)
+ *
+ * 파이프에 남은 바이트는 함께 버려진다.
+ */
+void relay_close(relay_t *r) {
+    if (r->pipefd[0] >= 0) {
+        close(r->pipefd[0]);
+        close(r->pipefd[1]);
+    }
+    relay_init(r);
+}
+
+/**
+ * 소켓에서 파이프로 최대 max 바이트를 옮기는 함수 (파이프가 비어 있을 때 부른다)
+ *
+ * @param from 읽을 소켓
+ * @param max 옮길 최대 바이트 수 (파이프 크기를 넘으면 파이프 크기만큼)
+ * @return 옮긴 바이트 수, 소켓이 닫혔으면 0, 실패하면 -1 (errno)
+ */
+ssize_t relay_fill(relay_t *r, int from, long long max) {
+    ssize_t n;
+
+    if (max > r->size) {
+        max = r->size;
+    }
+    n = splice(from, NULL, r->pipefd[1], NULL, max, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n > 0) {
+        r->len += n;
+    }
+    return n;
+}
+
+/**
+ * 파이프에 든 바이트를 소켓으로 옮기는 함수
+ *
+ * @param to 쓸 소켓
+ * @return 옮긴 바이트 수, 실패하면 -1 (errno)
+ */
+ssize_t relay_drain(relay_t *r, int to) {
+    ssize_t n;
+
+    n = splice(r->pipefd[0], NULL, to, NULL, r->len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE);
+    if (n > 0) {
+        r->len -= n;
+    }
+    return n;
+}
@@ -0,0 +1,30 @@
+/*
+ * relay.h - splice 로 소켓에서 소켓으로 바이트를 옮기는 pass-through 전달기
+ *
+ * read/write 로 전달하면 바이트가 커널 → 사용자 버퍼 → 커널로 두 번 복사된다.
+ * 캐시하지 않을 응답은 사용자 공간에서 볼 필요가 없으므로, 파이프를 사이에 두고
+ * splice(목적지 소켓 → 파이프 → 클라이언트 소켓)로 커널 안에서만 옮긴다.
+ *
+ * 파이프가 빈 뒤에만 relay_fill 을 부르고, 채운 바이트는 relay_drain 으로 모두 비운다.
+ * 소켓이 non-blocking 이면 두 함수 모두 EAGAIN 으로 실패할 수 있다.
+ */
+#ifndef __RELAY_H__
+#define __RELAY_H__
+
+#include <sys/types.h>
+
+#define RELAY_PIPE_SIZE     (256 * 1024)    // 파이프 크기 (한 번에 옮길 수 있는 최대 바이트 수)
+
+typedef struct {
+    int pipefd[2];              // [0] 읽는 쪽, [1] 쓰는 쪽 (열지 않았으면 -1)
+    int size;                   // 파이프에 담을 수 있는 바이트 수
+    int len;                    // 지금 파이프에 들어 있는 바이트 수
+} relay_t;
+
+void relay_init(relay_t *r);
+int relay_open(relay_t *r);
+void relay_close(relay_t *r);
+ssize_t relay_fill(relay_t *r, int from, long long max);
+ssize_t relay_drain(relay_t *r, int to);
+
+#endif /* __RELAY_H__ */
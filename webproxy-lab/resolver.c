@@ -0,0 +1,146 @@
+/*
+ * resolver.c - 이벤트 루프를 멈추지 않는 비동기 주소 조회 서비스
+ *
+ * 요청 대기열과 완료 목록을 하나의 락으로 보호한다. 작업 스레드는 대기열에서 요청을 꺼내
+ * dns_lookup 으로 조회하고(결과는 DNS 캐시에도 들어간다), 완료 목록에 옮긴 뒤 eventfd 에 쓴다.
+ *
+ * 요청한 연결이 그 사이에 닫힐 수 있으므로 요청은 취소 표시만 하고, 해제는 항상
+ * resolver_complete 가 한다. 취소 표시와 완료 처리는 모두 이벤트 루프 스레드에서 일어난다.
+ */
+#include "resolver.h"
+#include <sys/eventfd.h>
+
+static pthread_mutex_t resolver_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t resolver_cond = PTHREAD_COND_INITIALIZER;    // 대기열에 요청이 들어오면 signal
+static resolve_job_t *pending_head;     // 조회를 기다리는 요청 (FIFO)
+static resolve_job_t *pending_tail;
+static resolve_job_t *completed;        // 조회가 끝나 이벤트 루프가 처리할 요청
+static int resolver_efd = -1;           // 완료를 알리는 eventfd
+
+
+/**
+ * 대기열에서 요청을 꺼내 조회하는 작업 스레드 함수
+ */
+static void *resolver_thread(void *vargp) {
+    resolve_job_t *job;
+    uint64_t one = 1;
+
+    Pthread_detach(pthread_self());
+
+    while (1) {
+        pthread_mutex_lock(&resolver_lock);
+        while (pending_head == NULL) {
+            pthread_cond_wait(&resolver_cond, &resolver_lock);
+        }
+        job = pending_head;
+        if ((pending_head = job->next) == NULL) {
+            pending_tail = NULL;
+        }
+        pthread_mutex_unlock(&resolver_lock);
+
+        // 락 없이 조회한다. 오래 걸려도 다른 작업 스레드와 이벤트 루프는 멈추지 않는다.
+        job->res = dns_lookup(job->hostname, job->port, &job->err);
+
+        pthread_mutex_lock(&resolver_lock);
+        job->next = completed;
+        completed = job;
+        pthread_mutex_unlock(&resolver_lock);
+
+        // eventfd 의 카운터를 올리면 이벤트 루프의 epoll_wait 가 깨어난다.
+        if (write(resolver_efd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            fprintf(stderr, "resolver eventfd write error: %s\n", strerror(errno));
+        }
+    }
+    return NULL;
+}
+
+/**
+ * 작업 스레드들을 만들고 완료를 알릴 eventfd 를 여는 함수
+ *
+ * @param nthreads 작업 스레드 수 (동시에 진행할 수 있는 느린 조회의 수)
+ * @return 이벤트 루프가 epoll 에 등록할 eventfd (non-blocking)
+ */
+int resolver_init(int nthreads) {
+    int i;
+    pthread_t tid;
+
+    if ((resolver_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        unix_error("eventfd error");
+    }
+    for (i = 0; i < nthreads; i++) {
+        Pthread_create(&tid, NULL, resolver_thread, NULL);
+    }
+    return resolver_efd;
+}
+
+/**
+ * 조회를 요청하는 함수 (기다리지 않고 바로 돌아온다)
+ *
+ * @param done 조회가 끝나면 resolver_complete 안에서 호출할 함수
+ * @param arg done 에 넘길 인자
+ * @return 요청 (취소할 때 resolver_cancel 에 넘긴다)
+ */
+resolve_job_t *resolver_submit(char *hostname, char *port,
+                               void (*done)(void *arg, dns_result_t *res, int err), void *arg) {
+    resolve_job_t *job = Calloc(1, sizeof(resolve_job_t));
+
+    job->hostname = strdup(hostname);
+    job->port = strdup(port);
+    job->done = done;
+    job->arg = arg;
+
+    pthread_mutex_lock(&resolver_lock);
+    if (pending_tail != NULL) {
+        pending_tail->next = job;
+    } else {
+        pending_head = job;
+    }
+    pending_tail = job;
+    pthread_cond_signal(&resolver_cond);
+    pthread_mutex_unlock(&resolver_lock);
+
+    return job;
+}
+
+/**
+ * 요청한 쪽이 더 이상 결과를 기다리지 않을 때 부르는 함수 (이벤트 루프 스레드에서 호출)
+ *
+ * 작업 스레드가 아직 조회 중일 수 있으므로 해제하지 않고 표시만 한다.
+ * 결과는 resolver_complete 가 done 을 부르지 않고 놓는다.
+ */
+void resolver_cancel(resolve_job_t *job) {
+    job->cancelled = 1;
+}
+
+/**
+ * 끝난 조회들의 done 콜백을 실행하는 함수 (eventfd 가 읽을 수 있게 되면 이벤트 루프가 호출)
+ *
+ * eventfd 를 먼저 비운 뒤 완료 목록을 가져오므로, 그 뒤에 끝난 조회는 다시 eventfd 를 깨운다.
+ */
+void resolver_complete() {
+    resolve_job_t *job, *next;
+    uint64_t count;
+
+    while (read(resolver_efd, &count, sizeof(count)) < 0 && errno == EINTR) {
+        ;
+    }
+
+    pthread_mutex_lock(&resolver_lock);
+    job = completed;
+    completed = NULL;
+    pthread_mutex_unlock(&resolver_lock);
+
+    for (; job != NULL; job = next) {
+        next = job->next;
+        if (job->cancelled) {
+            if (job->res != NULL) {
+                dns_release(job->res);
+            }
+        } else {
+            job->done(job->arg, job->res, job->err);
+        }
+        free(job->hostname);
+        free(job->port);
+        free(job);
+    }
+}
@@ -0,0 +1,33 @@
+/*
+ * resolver.h - 이벤트 루프를 멈추지 않는 비동기 주소 조회 서비스
+ *
+ * 캐시에 없는 이름의 getaddrinfo 는 몇 초씩 걸릴 수 있어, 이벤트 루프에서 직접 부르면
+ * 그동안 모든 연결이 멈춘다. 조회는 작은 전용 스레드 풀이 DNS 캐시를 통해 대신 하고,
+ * 끝난 조회는 완료 목록에 넣은 뒤 eventfd 로 이벤트 루프를 깨운다.
+ * 이벤트 루프는 eventfd 가 읽을 수 있게 되면 resolver_complete 로 완료 콜백들을 실행한다.
+ */
+#ifndef __RESOLVER_H__
+#define __RESOLVER_H__
+
+#include "csapp.h"
+#include "dns.h"
+
+/* 조회 요청 하나 */
+typedef struct resolve_job {
+    char *hostname;
+    char *port;
+    void (*done)(void *arg, dns_result_t *res, int err);   // 이벤트 루프 스레드에서 호출된다
+    void *arg;
+    dns_result_t *res;              // 조회 결과 (실패하면 NULL, 소유권은 done 으로 넘어간다)
+    int err;                        // 실패한 조회의 getaddrinfo 에러 코드
+    int cancelled;                  // 요청한 쪽이 더 이상 결과를 기다리지 않으면 1
+    struct resolve_job *next;
+} resolve_job_t;
+
+int resolver_init(int nthreads);
+resolve_job_t *resolver_submit(char *hostname, char *port,
+                               void (*done)(void *arg, dns_result_t *res, int err), void *arg);
+void resolver_cancel(resolve_job_t *job);
+void resolver_complete();
+
+#endif /* __RESOLVER_H__ */
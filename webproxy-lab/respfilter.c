@@ -0,0 +1,205 @@
+/*
+ * respfilter.c - 목적지 응답을 클라이언트 연결에 맞게 고쳐 보내는 필터
+ *
+ * 헤더와 chunk 크기 줄은 framer 에 한 줄씩 넣어 구조를 세고, 본문과 chunk 데이터는
+ * 받은 조각 안을 가리키는 조각으로 out 에 넣는다. 헤더는 다 모은 뒤 한 번에 고쳐 쓴다.
+ */
+#include "respfilter.h"
+
+
+/**
+ * 목적지 연결에만 해당해서 클라이언트에게 넘기지 않을 헤더인지 확인하는 함수
+ *
+ * Connection 헤더에 이름이 적힌 헤더도 hop-by-hop 이다.
+ *
+ * @param line 헤더 한 줄 (NULL 문자로 끝나지 않아도 된다)
+ * @param len 줄의 길이
+ * @param tokens 응답의 Connection 헤더 값들 (없으면 "")
+ */
+int is_hop_header(const char *line, int len, const char *tokens) {
+    static const char *hop[] = { "Connection", "Keep-Alive", "Proxy-Connection", "TE", "Trailer", "Upgrade" };
+    const char *colon = memchr(line, ':', len);
+    char name[MAXLINE];
+    int i, name_len;
+
+    if (colon == NULL || (name_len = colon - line) >= (int)sizeof(name)) {
+        return 0;
+    }
+    for (i = 0; i < (int)(sizeof(hop) / sizeof(hop[0])); i++) {
+        if (name_len == (int)strlen(hop[i]) && !strncasecmp(line, hop[i], name_len)) {
+            return 1;
+        }
+    }
+    memcpy(name, line, name_len);
+    name[name_len] = '\0';
+    return tokens[0] != '\0' && framer_has_token(tokens, strlen(tokens), name);
+}
+
+/**
+ * 헤더 줄 하나가 name 헤더인지 확인하는 함수 (name 은 콜론까지 포함한다, 예: "Content-Length:")
+ */
+static int is_header(const char *line, int len, const char *name) {
+    int name_len = strlen(name);
+
+    return len >= name_len && !strncasecmp(line, name, name_len);
+}
+
+/**
+ * 다 모은 응답 헤더를 클라이언트 연결에 맞게 그 자리에서 고쳐 쓰는 함수
+ *
+ * 1. Connection 헤더들의 값을 모아 두고 (거기에 적힌 헤더도 뺀다)
+ * 2. 상태 라인은 두고 hop-by-hop 헤더를 뺀다. chunked 응답의 Content-Length 는 본문 길이가 아니므로 빼고,
+ *    chunk 를 풀어 보낼 때는 Transfer-Encoding 도 뺀다.
+ * 3. 헤더 끝의 빈 줄 앞에 클라이언트 쪽에서 정한 Connection 헤더를 붙인다.
+ *
+ * 클라이언트가 응답의 끝을 알 수 있을 때만(길이 정보가 있거나 본문이 없을 때) 연결을 유지한다.
+ */
+static void rewrite_head(respfilter_t *rf) {
+    char tokens[MAXLINE] = "";
+    char *line, *eol, *end = rf->head + rf->head_len, *dst;
+    int len, dechunk, tlen = 0, vlen;
+
+    dechunk = rf->http10 && rf->fr.chunked && rf->fr.state != FR_DONE;
+    rf->persistent = rf->keep_alive && rf->fr.state != FR_UNTIL_EOF && !dechunk;
+    rf->state = dechunk ? RF_DECHUNK : RF_BODY;
+
+    // 1. Connection 헤더에 적힌 이름들 (여러 줄이면 쉼표로 잇는다)
+    line = (char *)memchr(rf->head, '\n', rf->head_len) + 1;
+    for (; line < end; line = eol) {
+        eol = (char *)memchr(line, '\n', end - line) + 1;
+        if (!is_header(line, eol - line, "Connection:")) {
+            continue;
+        }
+        for (vlen = eol - line - 11; vlen > 0 && (line[10 + vlen] == '\r' || line[10 + vlen] == '\n'); vlen--) {
+            ;
+        }
+        if (tlen + vlen + 2 < (int)sizeof(tokens)) {
+            tokens[tlen++] = ',';
+            memcpy(tokens + tlen, line + 11, vlen);
+            tlen += vlen;
+            tokens[tlen] = '\0';
+        }
+    }
+
+    // 2. 남길 줄만 앞으로 당긴다 (빼기만 하므로 쓰는 위치가 읽는 위치를 앞지르지 않는다).
+    line = dst = (char *)memchr(rf->head, '\n', rf->head_len) + 1;
+    for (; line < end; line = eol) {
+        eol = (char *)memchr(line, '\n', end - line) + 1;
+        len = eol - line;
+        if (line[0] == '\r' || line[0] == '\n') {
+            break;          // 헤더 끝의 빈 줄
+        }
+        if (is_hop_header(line, len, tokens) ||
+            (rf->fr.chunked && is_header(line, len, "Content-Length:")) ||
+            (rf->http10 && rf->fr.chunked && is_header(line, len, "Transfer-Encoding:"))) {
+            continue;
+        }
+        memmove(dst, line, len);
+        dst += len;
+    }
+
+    // 3. 빈 줄 대신 Connection 헤더와 빈 줄을 쓴다 (RF_HEAD_SLACK 안에 든다).
+    len = sprintf(dst, "Connection: %s\r\n\r\n", rf->persistent ? "keep-alive" : "close");
+    rf->head_len = dst + len - rf->head;
+}
+
+/**
+ * 클라이언트 연결 하나에 보낼 응답 하나의 필터를 준비하는 함수
+ *
+ * @param http10 클라이언트의 요청이 HTTP/1.0 이면 1
+ * @param keep_alive 클라이언트가 응답 뒤에도 연결을 유지하려 하면 1
+ */
+void respfilter_init(respfilter_t *rf, int http10, int keep_alive) {
+    rf->state = RF_HEAD;
+    rf->http10 = http10;
+    rf->keep_alive = keep_alive;
+    rf->persistent = 0;
+    framer_init(&rf->fr);
+    rf->head_len = 0;
+    rio_iovinit(&rf->out);
+}
+
+/**
+ * 응답의 다음 조각을 필터에 넣고, 클라이언트에게 보낼 조각들을 rf->out 에 새로 채우는 함수
+ *
+ * out 에 조각이 RIO_IOVMAX 개 차면 거기서 멈추므로, 호출한 쪽은 out 을 보낸 뒤
+ * 남은 바이트로 다시 부른다. 헤더를 모으는 동안에는 out 이 비어 있을 수 있다.
+ *
+ * @param buf 목적지 응답의 조각 (이 응답에 속하는 바이트만)
+ * @param n 조각의 길이
+ * @return 필터가 소비한 바이트 수, 헤더가 RF_HEAD_MAX 를 넘으면 -1
+ */
+int respfilter_feed(respfilter_t *rf, const char *buf, int n) {
+    const char *nl;
+    int pos = 0, take;
+
+    rio_iovinit(&rf->out);
+    while (pos < n) {
+        if (rf->state == RF_ERROR) {
+            return -1;
+        }
+        if (rf->state == RF_BODY) {
+            rio_iovadd(&rf->out, (char *)buf + pos, n - pos);  // out 에는 많아야 고쳐 쓴 헤더 하나가 있다
+            return n;
+        }
+        if (rf->state == RF_DECHUNK && rf->fr.state == FR_DONE) {
+            return n;       // 마지막 chunk 뒤 (호출한 쪽은 응답의 바이트만 넘긴다)
+        }
+
+        if (rf->state == RF_DECHUNK && rf->fr.state == FR_CHUNK_DATA) {
+            // chunk 데이터는 그대로 보낸다.
+            take = (n - pos < rf->fr.remaining) ? n - pos : rf->fr.remaining;
+            if (rio_iovadd(&rf->out, (char *)buf + pos, take) < 0) {
+                break;
+            }
+        } else {
+            // 헤더와 chunk 크기 줄, trailer 는 한 줄씩 framer 에 넣는다. 헤더만 모아 둔다.
+            nl = memchr(buf + pos, '\n', n - pos);
+            take = (nl != NULL) ? nl - (buf + pos) + 1 : n - pos;
+            if (rf->state == RF_HEAD) {
+                if (rf->head_len + take > RF_HEAD_MAX) {
+                    rf->state = RF_ERROR;
+                    return -1;
+                }
+                memcpy(rf->head + rf->head_len, buf + pos, take);
+                rf->head_len += take;
+            }
+        }
+        framer_feed(&rf->fr, buf + pos, take);
+        pos += take;
+
+        // 헤더가 끝났으면 고쳐 쓴 헤더를 맨 앞에 넣는다 (out 은 아직 비어 있다).
+        if (rf->state == RF_HEAD && rf->fr.state != FR_STATUS && rf->fr.state != FR_HEADER) {
+            rewrite_head(rf);
+            rio_iovadd(&rf->out, rf->head, rf->head_len);
+        }
+    }
+    return pos;
+}
+
+/**
+ * 응답의 조각을 필터를 거쳐 블로킹 소켓에 모두 쓰는 함수 (thread / pool 모드)
+ *
+ * @return 성공하면 0, 쓰기에 실패했거나 헤더가 너무 크면 -1 (rf->state 가 RF_ERROR 면 헤더 문제)
+ */
+int respfilter_write(int fd, respfilter_t *rf, const char *buf, int n) {
+    int used;
+
+    while (n > 0) {
+        if ((used = respfilter_feed(rf, buf, n)) < 0 || rio_writev(fd, &rf->out) < 0) {
+            return -1;
+        }
+        buf += used;
+        n -= used;
+    }
+    return 0;
+}
+
+/**
+ * 응답을 끝까지 보낸 뒤 클라이언트 연결을 계속 쓸 수 있는지 확인하는 함수
+ *
+ * 보낸 헤더의 Connection 과 같은 판단이다. 응답이 끝났는지는 호출한 쪽이 확인한다.
+ */
+int respfilter_persistent(respfilter_t *rf) {
+    return rf->state != RF_HEAD && rf->state != RF_ERROR && rf->persistent;
+}
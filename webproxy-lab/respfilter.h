@@ -0,0 +1,50 @@
+/*
+ * respfilter.h - 목적지 응답을 클라이언트 연결에 맞게 고쳐 보내는 필터
+ *
+ * 목적지와는 HTTP/1.1 keep-alive 로 이야기하므로, 목적지의 응답에는 목적지 연결에만 해당하는
+ * hop-by-hop 헤더(Connection, Keep-Alive 등)와 chunked 본문이 들어 있을 수 있다.
+ * 이것을 그대로 넘기면 클라이언트는 프록시와의 연결을 목적지의 판단대로 다루게 되고,
+ * HTTP/1.0 클라이언트는 chunked 본문을 읽지 못한다.
+ *
+ * 필터는 응답 헤더를 모아 hop-by-hop 헤더를 빼고, 프록시가 클라이언트 쪽에서 정한 대로
+ * "Connection: keep-alive" 또는 "Connection: close" 를 붙인다. HTTP/1.0 클라이언트에게는
+ * chunk 를 풀어 본문만 보내고, 본문의 끝은 연결을 닫아 알린다.
+ *
+ * 본문은 복사하지 않는다. respfilter_feed 는 고쳐 쓴 헤더와 받은 조각 안의 구간을 가리키는
+ * 조각들을 out 에 채우므로, 호출한 쪽은 out 을 다 보낼 때까지 받은 조각을 놓지 않아야 한다.
+ */
+#ifndef __RESPFILTER_H__
+#define __RESPFILTER_H__
+
+#include "csapp.h"
+#include "framer.h"
+
+#define RF_HEAD_MAX     MAXBUF      // 모을 수 있는 응답 헤더의 크기 (넘으면 RF_ERROR)
+#define RF_HEAD_SLACK   32          // 고쳐 쓴 헤더에 붙는 Connection 헤더의 자리
+
+/* 필터가 지금 기다리는 부분 */
+typedef enum {
+    RF_HEAD,            // 상태 라인과 헤더를 모으는 중
+    RF_BODY,            // 본문을 그대로 보낸다
+    RF_DECHUNK,         // chunk 를 풀어 본문만 보낸다 (HTTP/1.0 클라이언트)
+    RF_ERROR            // 헤더가 너무 크다
+} respfilter_state_t;
+
+typedef struct {
+    respfilter_state_t state;
+    int http10;                 // 클라이언트가 HTTP/1.0 이면 1 (chunked 를 받지 못한다)
+    int keep_alive;             // 클라이언트가 응답 뒤에도 연결을 유지하려 하면 1
+    int persistent;             // 헤더를 고쳐 쓴 뒤: 응답을 끝까지 보내면 연결을 계속 쓸 수 있으면 1
+    framer_t fr;                // 헤더의 끝과 chunk 경계를 세는 파서
+    char head[RF_HEAD_MAX + RF_HEAD_SLACK];     // 모은 헤더 (그 자리에서 고쳐 쓴다)
+    int head_len;
+    rio_iov_t out;              // respfilter_feed 가 채운, 클라이언트에게 보낼 조각들
+} respfilter_t;
+
+void respfilter_init(respfilter_t *rf, int http10, int keep_alive);
+int respfilter_feed(respfilter_t *rf, const char *buf, int n);
+int respfilter_write(int fd, respfilter_t *rf, const char *buf, int n);
+int respfilter_persistent(respfilter_t *rf);
+int is_hop_header(const char *line, int len, const char *tokens);
+
+#endif /* __RESPFILTER_H__ */
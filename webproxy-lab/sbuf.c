@@ -0,0 +1,51 @@
+/*
+ * sbuf.c - 생산자-소비자 방식의 유한 크기 공유 버퍼 (CS:APP 12.5.4)
+ *
+ * 메인 스레드(생산자)가 accept 한 연결을 넣고, 미리 만들어 둔 작업 스레드들(소비자)이
+ * 꺼내 처리한다. 버퍼가 가득 차면 생산자가, 비어 있으면 소비자가 기다린다.
+ */
+#include "sbuf.h"
+
+/**
+ * n 개의 슬롯을 가진 빈 버퍼를 만드는 함수
+ */
+void sbuf_init(sbuf_t *sp, int n) {
+    sp->buf = Calloc(n, sizeof(int));
+    sp->n = n;                      // 최대 n 개의 항목을 담는다
+    sp->front = sp->rear = 0;       // front == rear 이면 비어 있다
+    Sem_init(&sp->mutex, 0, 1);     // 잠금용 이진 세마포어
+    Sem_init(&sp->slots, 0, n);     // 처음에는 n 개의 빈 슬롯이 있다
+    Sem_init(&sp->items, 0, 0);     // 처음에는 항목이 없다
+}
+
+/**
+ * 버퍼를 해제하는 함수
+ */
+void sbuf_deinit(sbuf_t *sp) {
+    Free(sp->buf);
+}
+
+/**
+ * 버퍼의 뒤쪽에 항목을 넣는 함수 (빈 슬롯이 없으면 기다린다)
+ */
+void sbuf_insert(sbuf_t *sp, int item) {
+    P(&sp->slots);                          // 빈 슬롯을 기다린다
+    P(&sp->mutex);                          // 버퍼를 잠근다
+    sp->buf[(++sp->rear) % (sp->n)] = item; // 항목을 넣는다
+    V(&sp->mutex);                          // 버퍼 잠금을 푼다
+    V(&sp->items);                          // 항목이 생겼음을 알린다
+}
+
+/**
+ * 버퍼의 앞쪽에서 항목을 꺼내는 함수 (항목이 없으면 기다린다)
+ */
+int sbuf_remove(sbuf_t *sp) {
+    int item;
+
+    P(&sp->items);                          // 항목을 기다린다
+    P(&sp->mutex);                          // 버퍼를 잠근다
+    item = sp->buf[(++sp->front) % (sp->n)];// 항목을 꺼낸다
+    V(&sp->mutex);                          // 버퍼 잠금을 푼다
+    V(&sp->slots);                          // 빈 슬롯이 생겼음을 알린다
+    return item;
+}
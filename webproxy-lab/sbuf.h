@@ -0,0 +1,24 @@
+/*
+ * sbuf.h - 생산자-소비자 방식의 유한 크기 공유 버퍼 (CS:APP 12.5.4)
+ */
+#ifndef __SBUF_H__
+#define __SBUF_H__
+
+#include "csapp.h"
+
+typedef struct {
+    int *buf;       // 원형 버퍼 (연결 소켓 디스크립터를 담는다)
+    int n;          // 최대 슬롯 수
+    int front;      // buf[(front+1)%n] 이 첫 번째 항목
+    int rear;       // buf[rear%n] 이 마지막 항목
+    sem_t mutex;    // buf 접근을 보호하는 세마포어
+    sem_t slots;    // 비어 있는 슬롯 수
+    sem_t items;    // 채워진 항목 수
+} sbuf_t;
+
+void sbuf_init(sbuf_t *sp, int n);
+void sbuf_deinit(sbuf_t *sp);
+void sbuf_insert(sbuf_t *sp, int item);
+int sbuf_remove(sbuf_t *sp);
+
+#endif /* __SBUF_H__ */
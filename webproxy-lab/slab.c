@@ -0,0 +1,178 @@
+/*
+ * slab.c - 캐시 객체용 크기 등급(2의 거듭제곱) 메모리 할당기
+ *
+ * 시작할 때 arena 를 한 번에 할당해 두고, 그 안에서 64B ~ 128KB 의 2의 거듭제곱 크기
+ * 블록을 나눠 준다. 요청 크기는 가장 가까운 등급으로 올림하므로 낭비는 절반을 넘지 않는다.
+ *
+ * 등급마다 free list 를 두고, 필요한 등급이 비어 있으면 더 큰 블록을 반으로 쪼갠다(buddy).
+ * 해제할 때 짝(buddy) 블록도 비어 있으면 다시 합친다. 그래서 arena 가 작아도 어떤 등급이
+ * 빈 블록을 독차지해 다른 등급이 굶는 일이 없다.
+ *
+ * arena 크기가 곧 캐시가 쓸 수 있는 실제 메모리이므로, 할당이 실패하면 캐시가 evict 해야 한다.
+ */
+#include "csapp.h"
+#include "slab.h"
+
+#define SLAB_NCLASSES (SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1)
+#define SLAB_UNIT     (1UL << SLAB_MIN_SHIFT)       // 메타데이터 한 칸이 가리키는 크기
+#define FREE_MARK     0x80                          // order_map: 빈 블록의 시작이라는 표시
+
+/* 빈 블록 안에 직접 저장되는 free list 노드 */
+typedef struct slab_node {
+    struct slab_node *prev;
+    struct slab_node *next;
+} slab_node_t;
+
+static char *arena;                                 // 미리 할당한 메모리
+static size_t arena_size;                           // SLAB_MAX_SHIFT 크기의 배수
+static unsigned char *order_map;                    // 블록 시작 칸마다 등급(+빈 블록이면 FREE_MARK)
+static slab_node_t free_lists[SLAB_NCLASSES];       // 등급별 빈 블록 목록 (원형, 머리 노드)
+static pthread_mutex_t slab_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void list_push(int cls, slab_node_t *node) {
+    slab_node_t *head = &free_lists[cls];
+
+    node->prev = head;
+    node->next = head->next;
+    head->next->prev = node;
+    head->next = node;
+}
+
+static void list_remove(slab_node_t *node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+}
+
+/**
+ * size 바이트가 들어가는 가장 작은 등급 번호를 구하는 함수
+ *
+ * @return 등급 번호 (0 = 64B), 가장 큰 등급보다 크면 -1
+ */
+static int size_to_class(size_t size) {
+    int shift = SLAB_MIN_SHIFT;
+
+    while ((1UL << shift) < size) {
+        if (++shift > SLAB_MAX_SHIFT) {
+            return -1;
+        }
+    }
+    return shift - SLAB_MIN_SHIFT;
+}
+
+/**
+ * arena 를 할당하고 모두 가장 큰 등급의 빈 블록으로 만드는 함수
+ *
+ * @param size 사용할 최대 메모리 (가장 큰 등급 크기의 배수로 내림한다)
+ */
+void slab_init(size_t size) {
+    size_t chunk = 1UL << SLAB_MAX_SHIFT;
+    size_t off;
+    int i;
+
+    pthread_mutex_lock(&slab_lock);
+
+    arena_size = size / chunk * chunk;
+    arena = Mmap(NULL, arena_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    order_map = Calloc(arena_size / SLAB_UNIT, 1);
+
+    for (i = 0; i < SLAB_NCLASSES; i++) {
+        free_lists[i].prev = free_lists[i].next = &free_lists[i];
+    }
+    for (off = 0; off < arena_size; off += chunk) {
+        order_map[off / SLAB_UNIT] = (SLAB_NCLASSES - 1) | FREE_MARK;
+        list_push(SLAB_NCLASSES - 1, (slab_node_t *)(arena + off));
+    }
+
+    pthread_mutex_unlock(&slab_lock);
+}
+
+/**
+ * size 바이트 이상의 블록을 할당하는 함수
+ *
+ * @return 할당된 블록, arena 에 맞는 빈 블록이 없으면 NULL
+ */
+void *slab_alloc(size_t size) {
+    int cls = size_to_class(size), k;
+    slab_node_t *node;
+    size_t off;
+
+    if (cls < 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&slab_lock);
+
+    // 1. 원하는 등급 이상에서 빈 블록이 있는 가장 작은 등급을 찾는다.
+    for (k = cls; k < SLAB_NCLASSES && free_lists[k].next == &free_lists[k]; k++)
+        ;
+    if (k == SLAB_NCLASSES) {
+        pthread_mutex_unlock(&slab_lock);
+        return NULL;
+    }
+
+    node = free_lists[k].next;
+    list_remove(node);
+    off = (char *)node - arena;
+
+    // 2. 원하는 등급이 될 때까지 반으로 쪼개고, 뒤쪽 절반은 한 등급 아래 free list 에 넣는다.
+    while (k > cls) {
+        k--;
+        size_t buddy = off + (SLAB_UNIT << k);
+        order_map[buddy / SLAB_UNIT] = k | FREE_MARK;
+        list_push(k, (slab_node_t *)(arena + buddy));
+    }
+
+    order_map[off / SLAB_UNIT] = cls;       // 사용 중인 블록: FREE_MARK 없이 등급만 기록
+
+    pthread_mutex_unlock(&slab_lock);
+    return node;
+}
+
+/**
+ * slab_alloc 으로 할당한 블록을 돌려주는 함수
+ *
+ * 짝 블록도 같은 등급의 빈 블록이면 합쳐서 한 등급 위로 올린다.
+ */
+void slab_free(void *ptr) {
+    size_t off = (char *)ptr - arena, buddy;
+    int cls;
+
+    pthread_mutex_lock(&slab_lock);
+
+    cls = order_map[off / SLAB_UNIT];
+    while (cls < SLAB_NCLASSES - 1) {
+        buddy = off ^ (SLAB_UNIT << cls);
+        if (order_map[buddy / SLAB_UNIT] != (cls | FREE_MARK)) {
+            break;      // 짝이 사용 중이거나 더 잘게 쪼개져 있다
+        }
+        list_remove((slab_node_t *)(arena + buddy));
+        order_map[buddy / SLAB_UNIT] = 0;
+        order_map[off / SLAB_UNIT] = 0;
+        off = (off < buddy) ? off : buddy;
+        cls++;
+    }
+
+    order_map[off / SLAB_UNIT] = cls | FREE_MARK;
+    list_push(cls, (slab_node_t *)(arena + off));
+
+    pthread_mutex_unlock(&slab_lock);
+}
+
+/**
+ * 할당된 블록이 arena 에서 실제로 차지하는 바이트 수를 돌려주는 함수
+ */
+size_t slab_size(void *ptr) {
+    size_t off = (char *)ptr - arena;
+
+    return SLAB_UNIT << order_map[off / SLAB_UNIT];
+}
+
+/**
+ * size 바이트를 할당하면 실제로 차지하게 될 바이트 수 (0 이면 할당할 수 없는 크기)
+ */
+size_t slab_class_size(size_t size) {
+    int cls = size_to_class(size);
+
+    return (cls < 0) ? 0 : SLAB_UNIT << cls;
+}
@@ -0,0 +1,18 @@
+/*
+ * slab.h - 캐시 객체용 크기 등급(2의 거듭제곱) 메모리 할당기
+ */
+#ifndef __SLAB_H__
+#define __SLAB_H__
+
+#include <stddef.h>
+
+#define SLAB_MIN_SHIFT 6        // 가장 작은 등급: 64 바이트
+#define SLAB_MAX_SHIFT 17       // 가장 큰 등급: 128 KB (URI + MAX_OBJECT_SIZE 가 들어간다)
+
+void slab_init(size_t arena_size);
+void *slab_alloc(size_t size);
+void slab_free(void *ptr);
+size_t slab_size(void *ptr);
+size_t slab_class_size(size_t size);
+
+#endif /* __SLAB_H__ */
@@ -0,0 +1,210 @@
+/*
+ * timer.c - 이벤트 루프용 계층형 타이밍 휠
+ *
+ * 타이머는 남은 시간에 따라 단계를 고르고, 울릴 시각의 해당 비트로 칸을 고른다.
+ * timer_advance 는 눈금을 하나씩 넘기며 0단계의 칸을 비우고, 0단계가 한 바퀴 돌 때마다
+ * 위 단계의 칸 하나를 아래로 다시 나눈다. 휠이 비어 있으면 눈금을 건너뛴다.
+ */
+#include <stddef.h>
+#include "timer.h"
+
+#define TW_ROOT_MASK    (TW_ROOT_SIZE - 1)
+#define TW_LEVEL_MASK   (TW_LEVEL_SIZE - 1)
+#define TW_MAX_DELTA    ((1L << (TW_ROOT_BITS + TW_LEVELS * TW_LEVEL_BITS)) - 1)
+
+
+/**
+ * level 단계(1부터)의 칸을 고르기 위해 울릴 시각을 미는 비트 수
+ */
+static int level_shift(int level) {
+    return TW_ROOT_BITS + (level - 1) * TW_LEVEL_BITS;
+}
+
+/**
+ * 타이머를 남은 시간에 맞는 칸에 넣는 함수
+ */
+static void link_timer(timer_wheel_t *tw, tw_timer_t *t) {
+    long delta = t->expires - tw->now;
+    tw_timer_t **slot;
+    int level;
+
+    if (delta < 0) {
+        slot = &tw->root[tw->now & TW_ROOT_MASK];   // 이미 지났으면 다음 눈금에 울린다
+    } else if (delta < TW_ROOT_SIZE) {
+        slot = &tw->root[t->expires & TW_ROOT_MASK];
+    } else {
+        if (delta > TW_MAX_DELTA) {
+            t->expires = tw->now + TW_MAX_DELTA;    // 표현할 수 있는 가장 먼 시각으로 줄인다
+        }
+        delta = t->expires - tw->now;
+        for (level = 1; level < TW_LEVELS; level++) {
+            if (delta < (1L << (level_shift(level) + TW_LEVEL_BITS))) {
+                break;
+            }
+        }
+        slot = &tw->level[level - 1][(t->expires >> level_shift(level)) & TW_LEVEL_MASK];
+    }
+
+    t->next = *slot;
+    t->pprev = slot;
+    if (*slot != NULL) {
+        (*slot)->pprev = &t->next;
+    }
+    *slot = t;
+}
+
+/**
+ * 타이머를 칸에서 빼는 함수
+ *
+ * pprev 로 앞 포인터를 바로 고치므로 칸을 찾을 필요가 없다.
+ */
+static void unlink_timer(tw_timer_t *t) {
+    *t->pprev = t->next;
+    if (t->next != NULL) {
+        t->next->pprev = t->pprev;
+    }
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+/**
+ * 위 단계의 칸 하나를 비우고 그 타이머들을 아래 단계로 다시 나누는 함수
+ *
+ * @return 칸 번호 (0 이면 이 단계도 한 바퀴를 돌았으므로 더 위 단계도 내려야 한다)
+ */
+static int cascade(timer_wheel_t *tw, int level) {
+    int idx = (tw->now >> level_shift(level)) & TW_LEVEL_MASK;
+    tw_timer_t *t = tw->level[level - 1][idx], *next;
+
+    tw->level[level - 1][idx] = NULL;
+    for (; t != NULL; t = next) {
+        next = t->next;
+        link_timer(tw, t);
+    }
+    return idx;
+}
+
+/**
+ * 빈 휠을 만드는 함수
+ *
+ * @param now 현재 시각 (ms)
+ */
+void timer_wheel_init(timer_wheel_t *tw, long now) {
+    int i, level;
+
+    tw->now = now;
+    tw->count = 0;
+    for (i = 0; i < TW_ROOT_SIZE; i++) {
+        tw->root[i] = NULL;
+    }
+    for (level = 0; level < TW_LEVELS; level++) {
+        for (i = 0; i < TW_LEVEL_SIZE; i++) {
+            tw->level[level][i] = NULL;
+        }
+    }
+}
+
+/**
+ * 타이머가 울리면 부를 함수를 정하는 함수 (휠에는 넣지 않는다)
+ */
+void timer_init(tw_timer_t *t, void (*fn)(void *arg), void *arg) {
+    t->fn = fn;
+    t->arg = arg;
+    t->pending = 0;
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+/**
+ * 타이머를 expires 에 울리도록 맞추는 함수 (이미 휠에 있으면 옮긴다)
+ *
+ * 같은 시각으로 다시 맞추면 아무 일도 하지 않으므로, 상태가 바뀔 때마다 불러도 된다.
+ */
+void timer_set(timer_wheel_t *tw, tw_timer_t *t, long expires) {
+    if (t->pending) {
+        if (t->expires == expires) {
+            return;
+        }
+        timer_del(tw, t);
+    }
+    t->expires = expires;
+    t->pending = 1;
+    tw->count++;
+    link_timer(tw, t);
+}
+
+/**
+ * 타이머를 휠에서 빼는 함수 (휠에 없으면 아무 일도 하지 않는다)
+ */
+void timer_del(timer_wheel_t *tw, tw_timer_t *t) {
+    if (!t->pending) {
+        return;
+    }
+    unlink_timer(t);
+    t->pending = 0;
+    tw->count--;
+}
+
+/**
+ * now 까지의 눈금을 처리해 시각이 된 타이머들을 울리는 함수
+ *
+ * 울리는 함수 안에서 타이머를 다시 맞추거나 지워도 된다. 울리기 전에 칸을 통째로 떼어 내므로,
+ * 울리는 도중에 맞춘 타이머는 같은 칸(256ms 뒤)에 들어가도 이번 눈금에 다시 울리지 않는다.
+ */
+void timer_advance(timer_wheel_t *tw, long now) {
+    tw_timer_t **slot, *list, *t;
+    int level;
+
+    while (tw->now <= now) {
+        if (tw->count == 0) {
+            tw->now = now + 1;      // 휠이 비어 있으면 처리할 눈금이 없다
+            return;
+        }
+
+        // 0단계가 한 바퀴를 돌면 위 단계의 칸을 차례로 내린다.
+        if ((tw->now & TW_ROOT_MASK) == 0) {
+            for (level = 1; level <= TW_LEVELS && cascade(tw, level) == 0; level++) {
+                ;
+            }
+        }
+
+        slot = &tw->root[tw->now & TW_ROOT_MASK];
+        tw->now++;
+        if ((list = *slot) == NULL) {
+            continue;
+        }
+        *slot = NULL;
+        list->pprev = &list;        // 떼어 낸 목록에서도 timer_del 로 뺄 수 있게 한다
+        while ((t = list) != NULL) {
+            unlink_timer(t);
+            t->pending = 0;
+            tw->count--;
+            t->fn(t->arg);
+        }
+    }
+}
+
+/**
+ * 다음에 타이머가 울릴 수 있는 가장 이른 시각(ms)을 얻는 함수
+ *
+ * 0단계의 칸을 앞에서부터 살펴 처음으로 비어 있지 않은 칸의 시각을 돌려준다.
+ * 0단계가 비어 있으면 위 단계의 칸이 내려오는 시각(0단계의 다음 바퀴)까지는 울릴 타이머가 없다.
+ *
+ * @return 울릴 시각, 타이머가 없으면 -1
+ */
+long timer_next_expiry(timer_wheel_t *tw) {
+    long tick;
+
+    if (tw->count == 0) {
+        return -1;
+    }
+    for (tick = tw->now; tick < tw->now + TW_ROOT_SIZE; tick++) {
+        if (tw->root[tick & TW_ROOT_MASK] != NULL) {
+            return tick;
+        }
+        if (((tick + 1) & TW_ROOT_MASK) == 0) {
+            return tick + 1;        // 여기서 위 단계가 내려온다
+        }
+    }
+    return tw->now + TW_ROOT_SIZE;
+}
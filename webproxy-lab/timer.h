@@ -0,0 +1,46 @@
+/*
+ * timer.h - 이벤트 루프용 계층형 타이밍 휠 (hierarchical timing wheel)
+ *
+ * 연결마다 제한 시간 타이머를 하나씩 두면 연결 수만큼 타이머가 생기고, 대부분은 울리기 전에
+ * 다시 맞춰지거나 지워진다. 정렬된 자료구조 대신 타이밍 휠을 쓰면 추가와 삭제가 O(1) 이다.
+ *
+ * 눈금 하나는 1ms 이다. 0단계는 256칸(256ms), 1~3단계는 64칸씩이라 약 18시간까지 표현하고,
+ * 그보다 먼 타이머는 가장 먼 칸에 넣는다. 위 단계의 칸은 아래 단계가 한 바퀴 돌 때마다
+ * 아래로 내려와(cascade) 다시 나뉜다.
+ *
+ * 잠금이 없으므로 한 스레드(이벤트 루프)에서만 써야 한다.
+ */
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+#define TW_ROOT_BITS    8
+#define TW_LEVEL_BITS   6
+#define TW_ROOT_SIZE    (1 << TW_ROOT_BITS)     // 0단계의 칸 수
+#define TW_LEVEL_SIZE   (1 << TW_LEVEL_BITS)    // 1~3단계의 칸 수
+#define TW_LEVELS       3                       // 0단계 위의 단계 수
+
+/* 타이머 하나 (보통 다른 구조체 안에 넣어 쓴다) */
+typedef struct tw_timer {
+    long expires;                   // 울릴 시각 (ms)
+    void (*fn)(void *arg);          // 울리면 호출할 함수
+    void *arg;
+    int pending;                    // 휠에 들어 있으면 1
+    struct tw_timer *next;          // 같은 칸의 다음 타이머
+    struct tw_timer **pprev;        // 나를 가리키는 포인터 (칸의 머리 또는 앞 타이머의 next)
+} tw_timer_t;
+
+typedef struct {
+    long now;                       // 다음에 처리할 눈금 (ms)
+    int count;                      // 휠에 들어 있는 타이머 수
+    tw_timer_t *root[TW_ROOT_SIZE];
+    tw_timer_t *level[TW_LEVELS][TW_LEVEL_SIZE];
+} timer_wheel_t;
+
+void timer_wheel_init(timer_wheel_t *tw, long now);
+void timer_init(tw_timer_t *t, void (*fn)(void *arg), void *arg);
+void timer_set(timer_wheel_t *tw, tw_timer_t *t, long expires);
+void timer_del(timer_wheel_t *tw, tw_timer_t *t);
+void timer_advance(timer_wheel_t *tw, long now);
+long timer_next_expiry(timer_wheel_t *tw);
+
+#endif /* __TIMER_H__ */
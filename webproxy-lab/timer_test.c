@@ -0,0 +1,120 @@
+/*
+ * timer_test.c - timer.c 의 타이밍 휠 회귀 검사 ("make check" 로 실행한다)
+ *
+ * 실패한 검사마다 한 줄을 출력하고, 하나라도 실패하면 1 로 끝난다.
+ */
+#include <stdio.h>
+#include "timer.h"
+
+static timer_wheel_t wheel;
+static int failures;
+
+/* 울린 횟수를 세고, 남은 횟수만큼 period 뒤로 자신을 다시 맞추는 타이머 */
+typedef struct {
+    tw_timer_t timer;
+    long period;
+    int rearms;
+    int fired;
+    long last;                      // 마지막으로 울린 눈금
+} rearm_t;
+
+/* 같은 칸의 다른 타이머를 지우는 타이머 */
+typedef struct {
+    tw_timer_t timer;
+    tw_timer_t *victim;
+    int fired;
+} killer_t;
+
+
+static void expect(int cond, const char *what) {
+    if (!cond) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static void on_rearm(void *arg) {
+    rearm_t *r = arg;
+
+    r->fired++;
+    r->last = wheel.now - 1;
+    if (r->rearms-- > 0) {
+        timer_set(&wheel, &r->timer, r->timer.expires + r->period);
+    }
+}
+
+static void on_kill(void *arg) {
+    killer_t *k = arg;
+
+    k->fired++;
+    timer_del(&wheel, k->victim);
+}
+
+static void on_count(void *arg) {
+    (*(int *)arg)++;
+}
+
+/**
+ * 울리는 함수 안에서 같은 칸(TW_ROOT_SIZE 뒤)으로 다시 맞춘 타이머는 이번 눈금에 다시 울리면 안 된다
+ */
+static void test_rearm_same_slot(void) {
+    rearm_t r = { .period = TW_ROOT_SIZE, .rearms = 4 };
+
+    timer_wheel_init(&wheel, 1000);
+    timer_init(&r.timer, on_rearm, &r);
+    timer_set(&wheel, &r.timer, 1010);
+
+    timer_advance(&wheel, 1010);
+    expect(r.fired == 1, "rearm: fires once at its tick");
+    timer_advance(&wheel, 1010 + TW_ROOT_SIZE - 1);
+    expect(r.fired == 1, "rearm: does not fire early");
+    timer_advance(&wheel, 1010 + TW_ROOT_SIZE);
+    expect(r.fired == 2 && r.last == 1010 + TW_ROOT_SIZE, "rearm: fires again one period later");
+}
+
+/**
+ * 울리는 함수 안에서 시각이 이미 지난 시각으로 다시 맞춘 타이머는 다음 눈금에 울린다
+ */
+static void test_rearm_past(void) {
+    rearm_t r = { .period = 0, .rearms = 1 };
+
+    timer_wheel_init(&wheel, 0);
+    timer_init(&r.timer, on_rearm, &r);
+    timer_set(&wheel, &r.timer, 5);
+
+    timer_advance(&wheel, 5);
+    expect(r.fired == 1, "past: fires once per tick");
+    timer_advance(&wheel, 6);
+    expect(r.fired == 2, "past: fires on the next tick");
+}
+
+/**
+ * 울리는 함수가 같은 칸에서 아직 울리지 않은 타이머를 지우면 그 타이머는 울리지 않는다
+ */
+static void test_delete_in_slot(void) {
+    killer_t k = { 0 };
+    tw_timer_t victim;
+    int count = 0;
+
+    timer_wheel_init(&wheel, 0);
+    timer_init(&victim, on_count, &count);
+    timer_init(&k.timer, on_kill, &k);
+    k.victim = &victim;
+    timer_set(&wheel, &victim, 20);
+    timer_set(&wheel, &k.timer, 20);    // 칸의 머리에 들어가므로 먼저 울린다
+
+    timer_advance(&wheel, 20);
+    expect(k.fired == 1 && count == 0, "delete: victim removed before firing");
+    expect(wheel.count == 0, "delete: wheel is empty");
+}
+
+int main(void) {
+    test_rearm_same_slot();
+    test_rearm_past();
+    test_delete_in_slot();
+
+    if (failures == 0) {
+        printf("timer: all tests passed\n");
+    }
+    return failures != 0;
+}
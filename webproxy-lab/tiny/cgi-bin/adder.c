@@ -3,38 +3,45 @@
  */
 /* $begin adder */
 #include "csapp.h"
+#include "cgiworker.h"
 
 int main(void)
 {
   char *buf, *p;
   char arg1[MAXLINE], arg2[MAXLINE], content[MAXLINE];
-  int n1 = 0, n2 = 0;
+  int n1, n2;
 
-  /* Extract the two arguments */
-  if ((buf = getenv("QUERY_STRING")) != NULL)
+  /* Serve one request as a plain CGI program, or many as a tiny -w worker */
+  while (cgi_accept() >= 0)
   {
-    p = strchr(buf, '&');
-    *p = '\0';
-    strcpy(arg1, buf);
-    strcpy(arg2, p + 1);
-    n1 = atoi(strchr(arg1, '=') + 1);
-    n2 = atoi(strchr(arg2, '=') + 1);
-  }
+    n1 = n2 = 0;
+
+    /* Extract the two arguments */
+    if ((buf = getenv("QUERY_STRING")) != NULL)
+    {
+      p = strchr(buf, '&');
+      *p = '\0';
+      strcpy(arg1, buf);
+      strcpy(arg2, p + 1);
+      n1 = atoi(strchr(arg1, '=') + 1);
+      n2 = atoi(strchr(arg2, '=') + 1);
+    }
 
-  /* Make the response body */
-  sprintf(content, "QUERY_STRING=%s\r\n<p>", buf);
-  sprintf(content + strlen(content), "Welcome to add.com: ");
-  sprintf(content + strlen(content), "THE Internet addition portal.\r\n<p>");
-  sprintf(content + strlen(content), "The answer is: %d + %d = %d\r\n<p>",
-          n1, n2, n1 + n2);
-  sprintf(content + strlen(content), "Thanks for visiting!\r\n");
+    /* Make the response body */
+    sprintf(content, "QUERY_STRING=%s\r\n<p>", buf);
+    sprintf(content + strlen(content), "Welcome to add.com: ");
+    sprintf(content + strlen(content), "THE Internet addition portal.\r\n<p>");
+    sprintf(content + strlen(content), "The answer is: %d + %d = %d\r\n<p>",
+            n1, n2, n1 + n2);
+    sprintf(content + strlen(content), "Thanks for visiting!\r\n");
 
-  /* Generate the HTTP response */
-  printf("Content-type: text/html\r\n");
-  printf("Content-length: %d\r\n", (int)strlen(content));
-  printf("\r\n");
-  printf("%s", content);
-  fflush(stdout);
+    /* Generate the HTTP response */
+    printf("Content-type: text/html\r\n");
+    printf("Content-length: %d\r\n", (int)strlen(content));
+    printf("\r\n");
+    printf("%s", content);
+    fflush(stdout);
+  }
 
   exit(0);
 }
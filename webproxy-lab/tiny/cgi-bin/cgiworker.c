@@ -0,0 +1,80 @@
+/*
+ * cgiworker.c - CGI 프로그램을 tiny 의 상주 worker 로도 돌 수 있게 하는 요청 루프
+ *
+ * worker 로 띄워지면 표준 입력이 tiny 와 연결된 SOCK_SEQPACKET 소켓이다. 메시지 하나가 요청 하나로,
+ * 본문은 QUERY_STRING, 제어 메시지(SCM_RIGHTS)는 응답을 쓸 클라이언트 소켓이다.
+ * 응답을 다 쓰면 클라이언트 소켓을 닫고 'R' 한 바이트로 다음 요청을 받을 수 있다고 알린다.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "cgiworker.h"
+
+#define CGI_WORKER_ENV  "TINY_CGI_WORKER"   // tiny/cgipool.h 와 같아야 한다
+#define MAX_ARGS        8192                // QUERY_STRING 의 최대 길이
+
+
+/**
+ * @brief 다음 요청을 받는 함수
+ *
+ * 1. 앞 요청의 응답을 모두 내보내고, 표준 출력을 /dev/null 로 바꿔 클라이언트 소켓을 닫는다.
+ * 2. tiny 에게 'R' 을 보내고 다음 요청 메시지를 기다린다.
+ * 3. QUERY_STRING 을 설정하고, 받은 클라이언트 소켓을 표준 출력으로 삼는다.
+ *
+ * @return int 요청을 받았으면 0, 더 처리할 요청이 없으면(보통 CGI 의 두 번째 호출, tiny 가 끝남) -1
+ */
+int cgi_accept(void) {
+  static int calls, devnull = -1;
+  char args[MAX_ARGS], ctl[CMSG_SPACE(sizeof(int))];
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  ssize_t n;
+  int fd;
+
+  // 보통 CGI 로 실행되었으면 한 번만 처리한다.
+  if (getenv(CGI_WORKER_ENV) == NULL) {
+    return (calls++ == 0) ? 0 : -1;
+  }
+
+  // 1. 앞 응답을 마무리한다. 클라이언트가 먼저 끊었으면 남은 출력은 버린다.
+  fflush(stdout);
+  clearerr(stdout);
+  if (devnull < 0 && (devnull = open("/dev/null", O_WRONLY)) < 0) {
+    return -1;
+  }
+  dup2(devnull, STDOUT_FILENO);
+
+  // 2. 준비되었음을 알리고 다음 요청을 기다린다.
+  if (send(STDIN_FILENO, "R", 1, MSG_NOSIGNAL) != 1) {
+    return -1;
+  }
+
+  iov.iov_base = args;
+  iov.iov_len = sizeof(args) - 1;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctl;
+  msg.msg_controllen = sizeof(ctl);
+  while ((n = recvmsg(STDIN_FILENO, &msg, 0)) < 0 && errno == EINTR) {
+    ;
+  }
+  cmsg = CMSG_FIRSTHDR(&msg);
+  if (n <= 0 || cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS) {
+    return -1;      // tiny 가 끝났다
+  }
+  memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  args[n] = '\0';
+
+  // 3. 새 요청의 환경을 꾸민다.
+  setenv("QUERY_STRING", args, 1);
+  dup2(fd, STDOUT_FILENO);
+  close(fd);
+  calls++;
+  return 0;
+}
@@ -0,0 +1,19 @@
+/*
+ * cgiworker.h - CGI 프로그램을 tiny 의 상주 worker 로도 돌 수 있게 하는 요청 루프
+ *
+ * 프로그램 본문을 다음과 같이 감싸면 된다.
+ *
+ *     while (cgi_accept() >= 0) {
+ *       ... getenv("QUERY_STRING") 을 읽고 표준 출력으로 응답을 쓴다 ...
+ *     }
+ *
+ * 보통 CGI 로 실행되면 cgi_accept 는 처음 한 번만 0 을 돌려주므로 예전과 똑같이 동작한다.
+ * tiny -w 가 worker 로 띄우면 요청이 올 때마다 QUERY_STRING 과 표준 출력(클라이언트 소켓)을
+ * 바꿔 주고 0 을 돌려준다. 본문에서 exit 하면 worker 도 끝나므로 루프 끝까지 가야 한다.
+ */
+#ifndef __CGIWORKER_H__
+#define __CGIWORKER_H__
+
+int cgi_accept(void);
+
+#endif /* __CGIWORKER_H__ */
@@ -0,0 +1,209 @@
+/*
+ * cgipool.c - CGI 프로그램마다 상주 worker 프로세스를 두는 FastCGI 비슷한 실행 방식
+ *
+ * 프로그램(파일 경로)마다 worker 표를 하나씩 두고, 모든 표를 하나의 락으로 보호한다.
+ * worker 는 요청을 넘기면 busy 가 되고, 'R' 을 받으면 다시 쉬는 상태가 된다. 새로 띄운 worker 도
+ * 첫 'R' 을 보내기 전까지는 busy 로 친다. 'R' 은 busy 인 worker 를 고를 때만 기다리지 않고 확인한다.
+ *
+ * 쉬는 worker 가 없으면 -w 까지 worker 를 하나 더 띄우고, 이번 요청은 호출한 쪽이 fork/execve 로
+ * 처리하게 한다. 그래서 느린 요청이 몰려도 worker 뒤에 줄을 서지 않는다.
+ * 한 번도 'R' 을 보내지 않고 끝난 worker 의 프로그램은 프로토콜을 모르는 것으로 보고 더 띄우지 않는다.
+ */
+#include "tiny.h"
+#include "cgipool.h"
+
+/* worker 하나 */
+typedef struct {
+  int sock;                       // worker 와 연결된 SOCK_SEQPACKET 소켓
+  int busy;                       // 요청을 처리 중이거나 아직 준비되지 않았으면 1
+  int started;                    // 'R' 을 한 번이라도 보냈으면 1
+} cgi_worker_t;
+
+/* CGI 프로그램 하나의 worker 표 */
+typedef struct {
+  char *filename;                 // key: CGI 프로그램 경로 (NULL 이면 빈 칸)
+  int disabled;                   // 프로토콜을 모르는 프로그램이면 1
+  int nworkers;
+  cgi_worker_t workers[CGI_MAX_WORKERS];
+} cgi_pool_t;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static cgi_pool_t pools[CGI_MAX_PROGRAMS];
+
+
+/**
+ * @brief 프로그램의 worker 표를 찾는 함수 (없으면 빈 칸에 만든다, pool_lock 을 잡은 채 호출)
+ *
+ * @return cgi_pool_t* worker 표, 표가 가득 찼으면 NULL
+ */
+static cgi_pool_t *find_pool(char *filename) {
+  int i;
+
+  for (i = 0; i < CGI_MAX_PROGRAMS && pools[i].filename != NULL; i++) {
+    if (!strcmp(pools[i].filename, filename)) {
+      return &pools[i];
+    }
+  }
+  if (i == CGI_MAX_PROGRAMS) {
+    return NULL;
+  }
+  pools[i].filename = strdup(filename);
+  return &pools[i];
+}
+
+/**
+ * @brief worker 를 하나 띄우는 함수 (pool_lock 을 잡은 채 호출)
+ *
+ * worker 는 소켓을 표준 입력으로, /dev/null 을 표준 출력으로 받고, CGI_WORKER_ENV 로
+ * worker 로 띄워졌음을 안다. 준비되면 'R' 을 보내므로 그때까지는 busy 로 둔다.
+ */
+static void spawn_worker(cgi_pool_t *p) {
+  char *emptylist[] = { NULL };
+  cgi_worker_t *w;
+  int sv[2], devnull;
+  pid_t pid;
+
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+    return;
+  }
+  if ((pid = fork()) < 0) {
+    close(sv[0]);
+    close(sv[1]);
+    return;
+  }
+  if (pid == 0) {
+    dup2(sv[1], STDIN_FILENO);
+    if ((devnull = open("/dev/null", O_WRONLY)) >= 0) {
+      dup2(devnull, STDOUT_FILENO);
+    }
+    setenv(CGI_WORKER_ENV, "1", 1);
+    close_inherited_fds();
+    execve(p->filename, emptylist, environ);
+    _exit(127);
+  }
+
+  close(sv[1]);
+  w = &p->workers[p->nworkers++];
+  w->sock = sv[0];
+  w->busy = 1;
+  w->started = 0;
+}
+
+/**
+ * @brief worker 를 표에서 빼는 함수 (마지막 worker 를 그 자리로 옮긴다, pool_lock 을 잡은 채 호출)
+ *
+ * 프로세스는 SIGCHLD 핸들러가 거둔다.
+ */
+static void remove_worker(cgi_pool_t *p, int i) {
+  cgi_worker_t *w = &p->workers[i];
+
+  // 한 번도 준비되지 않고 끝났으면 cgi_accept 를 쓰지 않는 프로그램이다.
+  if (!w->started) {
+    p->disabled = 1;
+    fprintf(stderr, "%s does not run as a CGI worker, falling back to fork/exec\n", p->filename);
+  }
+  close(w->sock);
+  p->workers[i] = p->workers[--p->nworkers];
+}
+
+/**
+ * @brief busy 인 worker 가 'R' 을 보냈는지 기다리지 않고 확인하는 함수
+ *
+ * @return int 확인했으면 0 (쉬게 되었으면 busy 가 0 이 된다), worker 가 끝났으면 -1
+ */
+static int poll_worker(cgi_worker_t *w) {
+  char c;
+  ssize_t n;
+
+  if ((n = recv(w->sock, &c, 1, MSG_DONTWAIT)) == 1) {
+    w->busy = 0;
+    w->started = 1;
+    return 0;
+  }
+  if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+    return 0;
+  }
+  return -1;
+}
+
+/**
+ * @brief 쉬는 worker 에게 요청 하나를 넘기는 함수
+ *
+ * QUERY_STRING 은 메시지 본문(NUL 포함)으로, 클라이언트 소켓은 SCM_RIGHTS 로 함께 보낸다.
+ *
+ * @return int 성공하면 0, worker 가 끝났으면 -1
+ */
+static int send_request(cgi_worker_t *w, char *cgiargs, int clientfd) {
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } ctl;
+
+  iov.iov_base = cgiargs;
+  iov.iov_len = strlen(cgiargs) + 1;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctl.buf;
+  msg.msg_controllen = sizeof(ctl.buf);
+
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &clientfd, sizeof(int));
+
+  return (sendmsg(w->sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) ? -1 : 0;
+}
+
+/**
+ * @brief CGI 요청을 쉬는 worker 에게 넘기는 함수
+ *
+ * 넘긴 뒤에는 worker 가 클라이언트 소켓의 복제본으로 응답을 끝까지 쓰고 닫으므로,
+ * 호출한 쪽은 평소처럼 자기 fd 만 닫으면 된다.
+ *
+ * @param filename CGI 프로그램의 경로
+ * @param cgiargs QUERY_STRING
+ * @param clientfd 클라이언트와 연결된 소켓 (블로킹 모드여야 한다)
+ * @return int 넘겼으면 0, 호출한 쪽이 fork/execve 로 처리해야 하면 -1
+ */
+int cgipool_dispatch(char *filename, char *cgiargs, int clientfd) {
+  cgi_pool_t *p;
+  cgi_worker_t *w;
+  int i, starting = 0;
+
+  pthread_mutex_lock(&pool_lock);
+  if ((p = find_pool(filename)) == NULL || p->disabled) {
+    pthread_mutex_unlock(&pool_lock);
+    return -1;
+  }
+
+  for (i = 0; i < p->nworkers; ) {
+    w = &p->workers[i];
+    if (w->busy && poll_worker(w) < 0) {
+      remove_worker(p, i);    // 마지막 worker 가 이 자리로 오므로 i 를 그대로 둔다
+      continue;
+    }
+    if (!w->busy) {
+      if (send_request(w, cgiargs, clientfd) == 0) {
+        w->busy = 1;
+        pthread_mutex_unlock(&pool_lock);
+        return 0;
+      }
+      remove_worker(p, i);
+      continue;
+    }
+    starting |= !w->started;
+    i++;
+  }
+
+  // 쉬는 worker 가 없다. 띄우는 중인 worker 가 없으면 하나 더 띄워 두고, 이번 요청은 fork/execve 로.
+  if (!p->disabled && !starting && p->nworkers < config.cgi_workers) {
+    spawn_worker(p);
+  }
+  pthread_mutex_unlock(&pool_lock);
+  return -1;
+}
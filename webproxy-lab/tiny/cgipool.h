@@ -0,0 +1,21 @@
+/*
+ * cgipool.h - CGI 프로그램마다 상주 worker 프로세스를 두는 FastCGI 비슷한 실행 방식
+ *
+ * 요청마다 fork/execve 로 CGI 프로그램을 새로 띄우는 대신, 프로그램마다 미리 띄워 둔 worker 에게
+ * SOCK_SEQPACKET 소켓으로 요청 하나(QUERY_STRING)와 클라이언트 소켓(SCM_RIGHTS)을 넘긴다.
+ * worker 는 그 소켓을 표준 출력으로 삼아 응답을 직접 쓰고, 다 쓰면 'R' 한 바이트로 다음 요청을 받을
+ * 준비가 되었음을 알린다. 출력이 tiny 를 거치지 않으므로 tiny 가 worker 를 기다리며 블록되는 일이 없다.
+ *
+ * worker 쪽은 cgi-bin/cgiworker.h 의 cgi_accept 루프로 작성한 프로그램이어야 한다.
+ * 쉬는 worker 가 없거나 프로토콜을 모르는 프로그램이면 호출한 쪽이 예전처럼 fork/execve 로 처리한다.
+ */
+#ifndef __CGIPOOL_H__
+#define __CGIPOOL_H__
+
+#define CGI_MAX_PROGRAMS    16      // worker 를 둘 수 있는 CGI 프로그램 수
+#define CGI_MAX_WORKERS     64      // 프로그램 하나의 worker 수 상한 (-w)
+#define CGI_WORKER_ENV      "TINY_CGI_WORKER"   // worker 로 띄울 때 설정하는 환경 변수
+
+int cgipool_dispatch(char *filename, char *cgiargs, int clientfd);
+
+#endif /* __CGIPOOL_H__ */
@@ -802,10 +802,12 @@ ssize_t rio_writen(int fd, void *usrbuf, size_t n)
  *    read() if the internal buffer is empty.
  */
 /* $begin rio_read */
-static ssize_t rio_read(rio_t *rp, char *usrbuf, size_t n)
+/*
+ * rio_fill - Refill the internal buffer if it is empty.
+ *    Returns the number of unread bytes, 0 on EOF, -1 on error.
+ */
+static ssize_t rio_fill(rio_t *rp)
 {
-    int cnt;
-
     while (rp->rio_cnt <= 0) {  /* Refill if buf is empty */
 	rp->rio_cnt = read(rp->rio_fd, rp->rio_buf, 
 			   sizeof(rp->rio_buf));
@@ -818,6 +820,25 @@ static ssize_t rio_read(rio_t *rp, char *usrbuf, size_t n)
 	else 
 	    rp->rio_bufptr = rp->rio_buf; /* Reset buffer ptr */
     }
+    return rp->rio_cnt;
+}
+
+static ssize_t rio_read(rio_t *rp, char *usrbuf, size_t n)
+{
+    int cnt;
+
+    /* Large read into an empty buffer: read straight into the user
+       buffer instead of staging the bytes in rio_buf */
+    if (rp->rio_cnt <= 0 && n >= sizeof(rp->rio_buf)) {
+	while ((cnt = read(rp->rio_fd, usrbuf, n)) < 0) {
+	    if (errno != EINTR) /* Interrupted by sig handler return */
+		return -1;
+	}
+	return cnt;
+    }
+
+    if ((cnt = rio_fill(rp)) <= 0)
+	return cnt;             /* EOF or error */
 
     /* Copy min(n, rp->rio_cnt) bytes from internal buf to user buf */
     cnt = n;          
@@ -866,33 +887,186 @@ ssize_t rio_readnb(rio_t *rp, void *usrbuf, size_t n)
 
 /* 
  * rio_readlineb - Robustly read a text line (buffered)
+ *    Instead of copying one byte per rio_read call, finds the newline
+ *    in the internal buffer with memchr and copies the line (or the
+ *    part of it that is buffered) at once. Reads at most maxlen-1
+ *    bytes and NUL-terminates, as before.
  */
 /* $begin rio_readlineb */
 ssize_t rio_readlineb(rio_t *rp, void *usrbuf, size_t maxlen) 
 {
-    int n, rc;
-    char c, *bufp = usrbuf;
-
-    for (n = 1; n < maxlen; n++) { 
-        if ((rc = rio_read(rp, &c, 1)) == 1) {
-	    *bufp++ = c;
-	    if (c == '\n') {
-                n++;
-     		break;
-            }
-	} else if (rc == 0) {
-	    if (n == 1)
+    ssize_t rc;
+    size_t n = 0, cnt;
+    char *bufp = usrbuf, *nl;
+
+    while (n + 1 < maxlen) {
+	if ((rc = rio_fill(rp)) < 0)
+	    return -1;	  /* Error */
+	else if (rc == 0) {
+	    if (n == 0)
 		return 0; /* EOF, no data read */
 	    else
 		break;    /* EOF, some data was read */
-	} else
-	    return -1;	  /* Error */
+	}
+
+	/* Copy up to and including the first '\n', within maxlen */
+	cnt = rc;
+	if (cnt > maxlen - 1 - n)
+	    cnt = maxlen - 1 - n;
+	if ((nl = memchr(rp->rio_bufptr, '\n', cnt)) != NULL)
+	    cnt = nl - rp->rio_bufptr + 1;
+	memcpy(bufp + n, rp->rio_bufptr, cnt);
+	rp->rio_bufptr += cnt;
+	rp->rio_cnt -= cnt;
+	n += cnt;
+	if (nl != NULL)
+	    break;
     }
-    *bufp = 0;
-    return n-1;
+    bufp[n] = 0;
+    return n;
 }
 /* $end rio_readlineb */
 
+/*
+ * rio_peekb - Expose the unread bytes of the internal buffer without
+ *    copying them, refilling it first if it is empty. *bufp is valid
+ *    until the next call on rp. The bytes stay unread until
+ *    rio_consumeb is called. Returns the number of contiguous bytes,
+ *    0 on EOF, -1 on error.
+ */
+/* $begin rio_peekb */
+ssize_t rio_peekb(rio_t *rp, char **bufp)
+{
+    ssize_t rc;
+
+    if ((rc = rio_fill(rp)) > 0)
+	*bufp = rp->rio_bufptr;
+    return rc;
+}
+/* $end rio_peekb */
+
+/*
+ * rio_consumeb - Mark n bytes returned by rio_peekb as read
+ */
+/* $begin rio_consumeb */
+void rio_consumeb(rio_t *rp, size_t n)
+{
+    if (rp->rio_cnt <= 0)
+	return;
+    if (n > (size_t)rp->rio_cnt)
+	n = rp->rio_cnt;
+    rp->rio_bufptr += n;
+    rp->rio_cnt -= n;
+}
+/* $end rio_consumeb */
+
+/*
+ * rio_iovinit - Start an empty scatter-gather response. Fragments are
+ *    collected with rio_iovadd/rio_iovprintf and sent with one writev
+ *    by rio_iovflush or rio_writev.
+ */
+/* $begin rio_iov */
+void rio_iovinit(rio_iov_t *v)
+{
+    v->iovcnt = 0;
+    v->iovcur = 0;
+    v->fmtptr = v->fmtbuf;
+}
+
+/*
+ * rio_iovadd - Append a reference to len bytes at buf (not copied; buf
+ *    must stay valid until written). A fragment that continues the
+ *    previous one is merged into it. Returns 0, or -1 if v is full.
+ */
+int rio_iovadd(rio_iov_t *v, void *buf, size_t len)
+{
+    struct iovec *last;
+
+    if (len == 0)
+	return 0;
+    if (v->iovcnt > 0) {
+	last = &v->iov[v->iovcnt - 1];
+	if ((char *)last->iov_base + last->iov_len == buf) {
+	    last->iov_len += len;
+	    return 0;
+	}
+    }
+    if (v->iovcnt == RIO_IOVMAX)
+	return -1;
+    v->iov[v->iovcnt].iov_base = buf;
+    v->iov[v->iovcnt].iov_len = len;
+    v->iovcnt++;
+    return 0;
+}
+
+/*
+ * rio_iovprintf - Append formatted text, stored in v->fmtbuf. Text
+ *    formatted back to back ends up in a single fragment. Returns 0,
+ *    or -1 if it does not fit.
+ */
+int rio_iovprintf(rio_iov_t *v, const char *fmt, ...)
+{
+    size_t room = v->fmtbuf + sizeof(v->fmtbuf) - v->fmtptr;
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(v->fmtptr, room, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= room || rio_iovadd(v, v->fmtptr, n) < 0)
+	return -1;
+    v->fmtptr += n;
+    return 0;
+}
+
+/*
+ * rio_iovflush - Write the unwritten fragments with one writev call
+ *    and skip past what the kernel took, so the next call resumes
+ *    after a partial write. Returns the bytes written (0 once all is
+ *    written), or -1 with errno set by writev (EAGAIN on a full
+ *    non-blocking socket).
+ */
+ssize_t rio_iovflush(int fd, rio_iov_t *v)
+{
+    ssize_t n, left;
+    struct iovec *iov;
+
+    if (v->iovcur == v->iovcnt)
+	return 0;
+    if ((n = writev(fd, &v->iov[v->iovcur], v->iovcnt - v->iovcur)) < 0)
+	return -1;
+    for (left = n; left > 0; ) {
+	iov = &v->iov[v->iovcur];
+	if ((size_t)left < iov->iov_len) {
+	    iov->iov_base = (char *)iov->iov_base + left;
+	    iov->iov_len -= left;
+	    break;
+	}
+	left -= iov->iov_len;
+	v->iovcur++;
+    }
+    return n;
+}
+
+/*
+ * rio_writev - Robustly write all fragments (unbuffered)
+ */
+ssize_t rio_writev(int fd, rio_iov_t *v)
+{
+    ssize_t n, total = 0;
+
+    while (v->iovcur < v->iovcnt) {
+	if ((n = rio_iovflush(fd, v)) < 0) {
+	    if (errno == EINTR)  /* Interrupted by sig handler return */
+		continue;        /* and call writev() again */
+	    return -1;           /* errno set by writev() */
+	}
+	total += n;
+    }
+    return total;
+}
+/* $end rio_iov */
+
 /**********************************
  * Wrappers for robust I/O routines
  **********************************/
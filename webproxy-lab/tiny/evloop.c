@@ -0,0 +1,264 @@
+/*
+ * evloop.c - tiny 의 epoll 모드: non-blocking 연결을 상태 기계로 처리하는 이벤트 루프
+ *
+ * 이벤트 루프마다 epoll 인스턴스를 하나씩 두고, 같은 듣기 소켓을 EPOLLEXCLUSIVE 로 등록한다.
+ * 새 연결이 오면 루프 하나만 깨어나 accept 하고, 그 연결은 닫힐 때까지 그 루프만 다루므로 잠금이 필요 없다.
+ *
+ * 연결은 요청 헤더를 빈 줄까지 모은 뒤(ST_READ), 정적 파일이면 응답의 조각들(헤더, 요청한 파일 구간)을
+ * sendfile 로 소켓이 받아 주는 만큼씩 보낸다(ST_SEND, range.c 의 reply_send). 에러 응답과 CGI 의 응답 헤더는 새 연결의 비어 있는
+ * 송신 버퍼에 바로 들어갈 만큼 작으므로 route_request 가 그 자리에서 보내고 연결을 닫는다.
+ */
+#include "tiny.h"
+#include "range.h"
+#include <sys/epoll.h>
+
+#define MAX_EVENTS  64          // epoll_wait 한 번에 받을 이벤트 수
+#define REQ_BUFSIZE MAXLINE     // 요청 헤더를 모을 버퍼 크기 (넘으면 400)
+
+/* 연결의 처리 단계 */
+typedef enum {
+  ST_READ,                      // 요청 헤더를 빈 줄까지 받는 중
+  ST_SEND                       // 정적 파일의 응답 헤더와 본문을 보내는 중
+} conn_state_t;
+
+/* 클라이언트 연결 하나 */
+typedef struct {
+  int fd;
+  int epfd;                     // 이 연결을 맡은 루프의 epoll 인스턴스
+  conn_state_t state;
+  char buf[REQ_BUFSIZE];        // 받은 요청 헤더 (NUL 로 끝난다)
+  int len;
+  reply_t reply;                // 보내는 중인 정적 파일 응답 (ST_SEND)
+} conn_t;
+
+
+/**
+ * @brief fd 를 non-blocking 모드로 바꾸는 함수
+ */
+static int set_nonblocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+
+  if (flags < 0) {
+    return -1;
+  }
+  return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/**
+ * @brief 연결을 닫고 자원을 돌려주는 함수
+ *
+ * epoll 등록은 fd 가 아니라 열린 소켓에 걸려 있어서, CGI 자식이 아직 같은 소켓을 쥐고 있으면
+ * close 만으로는 빠지지 않고 해제된 conn_t 로 이벤트가 온다. 그래서 닫기 전에 직접 뺀다.
+ */
+static void conn_close(conn_t *c) {
+  reply_free(&c->reply);
+  epoll_ctl(c->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+  close(c->fd);
+  free(c);
+
+  printf("---------------------------------\n");
+  fflush(stdout);
+}
+
+/**
+ * @brief 요청 헤더를 블록되지 않고 받을 수 있는 만큼 받는 함수
+ *
+ * @return int 빈 줄까지 받았으면 1, 더 기다려야 하면 0, 연결을 닫아야 하면 -1
+ */
+static int do_read(conn_t *c) {
+  ssize_t n;
+  int from;
+
+  while (1) {
+    if (c->len == REQ_BUFSIZE - 1) {
+      clienterror(c->fd, "", "400", "Bad request", "Tiny couldn't read the request headers");
+      return -1;
+    }
+    if ((n = recv(c->fd, c->buf + c->len, REQ_BUFSIZE - 1 - c->len, 0)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    if (n == 0) {
+      return -1;        // 요청을 다 보내지 않고 연결을 끊었다
+    }
+
+    // 빈 줄이 앞서 받은 조각과 걸쳐 있을 수 있으므로 3바이트 앞부터 찾는다.
+    from = (c->len > 3) ? c->len - 3 : 0;
+    c->len += n;
+    c->buf[c->len] = '\0';
+    if (strstr(c->buf + from, "\r\n\r\n") != NULL) {
+      return 1;
+    }
+  }
+}
+
+/**
+ * @brief 받은 요청을 처리해 보낼 응답을 정하는 함수
+ *
+ * @return int 정적 파일을 보내야 하면 0, 응답을 이미 보냈으면(연결을 닫으면 되면) -1
+ */
+static int start_response(conn_t *c) {
+  char method[MAXLINE], uri[MAXLINE], version[MAXLINE], range[MAXLINE];
+  fcache_entry_t *fe;
+  char *line, *eol;
+  int if_range = 0;
+
+  printf("Request headers:\n");
+  printf("%.*s", c->len - 2, c->buf);
+  fflush(stdout);
+
+  if (sscanf(c->buf, "%s %s %s", method, uri, version) < 2) {
+    clienterror(c->fd, c->buf, "400", "Bad request", "Tiny couldn't parse the request line");
+    return -1;
+  }
+
+  // 요청 라인 뒤의 헤더 줄 중 Range 만 본다. If-Range 가 있으면 Range 를 무시한다.
+  range[0] = '\0';
+  for (line = strstr(c->buf, "\r\n") + 2; (eol = strstr(line, "\r\n")) != line; line = eol + 2) {
+    range_header(line, range, &if_range);
+  }
+  if (if_range) {
+    range[0] = '\0';
+  }
+
+  if (!route_request(c->fd, method, uri, &fe)) {
+    return -1;
+  }
+
+  // 문제 11.11 : HEAD 메서드일 때는 응답 헤더만 보내고 본문은 보내지 않는다 (reply_init).
+  c->state = ST_SEND;
+  reply_init(&c->reply, fe, method, range);
+  return 0;
+}
+
+/**
+ * @brief 이벤트가 온 연결을 블록되지 않는 데까지 진행시키는 함수
+ */
+static void conn_drive(conn_t *c) {
+  int rc;
+
+  if (c->state == ST_READ) {
+    if ((rc = do_read(c)) <= 0) {
+      if (rc < 0) {
+        conn_close(c);
+      }
+      return;
+    }
+    if (start_response(c) < 0) {
+      conn_close(c);
+      return;
+    }
+  }
+  // 소켓이 가득 차면 EPOLLOUT 을 기다렸다가 이어 보낸다. 다 보냈거나 보낼 수 없으면 닫는다.
+  if (reply_send(c->fd, &c->reply) != 0) {
+    conn_close(c);
+  }
+}
+
+/**
+ * @brief 기다리는 연결을 모두 받아 이 루프의 epoll 에 등록하는 함수
+ *
+ * 다른 루프가 먼저 가져갔으면 accept 가 EAGAIN 으로 끝난다.
+ */
+static void accept_conns(int epfd, int listenfd) {
+  struct sockaddr_storage clientaddr;
+  socklen_t clientlen;
+  struct epoll_event ev;
+  conn_t *c;
+  int connfd;
+
+  while (1) {
+    clientlen = sizeof(clientaddr);
+    if ((connfd = accept(listenfd, (SA *)&clientaddr, &clientlen)) < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      return;       // EAGAIN, 또는 fd 가 부족하면 다음 이벤트에서 다시 받는다
+    }
+    if (set_nonblocking(connfd) < 0) {
+      close(connfd);
+      continue;
+    }
+    log_accept(&clientaddr, clientlen);
+
+    c = Malloc(sizeof(conn_t));
+    c->fd = connfd;
+    c->epfd = epfd;
+    c->state = ST_READ;
+    c->len = 0;
+    c->reply.fe = NULL;
+    c->reply.buf = NULL;
+
+    // edge-triggered 로 등록해 두면 읽기와 쓰기 모두 상태가 바뀔 때만 깨어난다.
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = c;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, connfd, &ev) < 0) {
+      conn_close(c);
+    }
+  }
+}
+
+/**
+ * @brief 이벤트 루프 하나를 실행하는 스레드 함수
+ *
+ * @param vargp 듣기 소켓을 가리키는 포인터
+ * @return void* 돌아오지 않는다
+ */
+static void *loop_main(void *vargp) {
+  int listenfd = *(int *)vargp, epfd, n, i;
+  struct epoll_event ev, events[MAX_EVENTS];
+
+  if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+    unix_error("epoll_create1 error");
+  }
+
+  // 듣기 소켓은 data.ptr 을 NULL 로 두어 연결과 구분한다.
+  // EPOLLEXCLUSIVE 로 등록하면 새 연결 하나에 모든 루프가 깨어나지 않는다.
+  ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+  ev.data.ptr = NULL;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, listenfd, &ev) < 0) {
+    unix_error("epoll_ctl error");
+  }
+
+  while (1) {
+    if ((n = epoll_wait(epfd, events, MAX_EVENTS, -1)) < 0) {
+      if (errno == EINTR) {
+        continue;   // SIGCHLD
+      }
+      unix_error("epoll_wait error");
+    }
+    for (i = 0; i < n; i++) {
+      if (events[i].data.ptr == NULL) {
+        accept_conns(epfd, listenfd);
+      } else {
+        conn_drive(events[i].data.ptr);
+      }
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief epoll 모드를 실행하는 함수 (돌아오지 않는다)
+ *
+ * nloops - 1 개의 스레드를 만들고, 호출한 스레드가 마지막 루프를 맡는다.
+ *
+ * @param listenfd 듣기 소켓 (non-blocking 으로 바꾼다)
+ * @param nloops 이벤트 루프 수
+ */
+void evloop_run(int listenfd, int nloops) {
+  static int lfd;
+  pthread_t tid;
+  int i;
+
+  lfd = listenfd;
+  set_nonblocking(lfd);
+
+  for (i = 1; i < nloops; i++) {
+    Pthread_create(&tid, NULL, loop_main, &lfd);
+    Pthread_detach(tid);
+  }
+  loop_main(&lfd);
+}
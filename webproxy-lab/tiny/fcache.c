@@ -0,0 +1,203 @@
+/*
+ * fcache.c - tiny 의 정적 파일 경로를 위한 열린 파일 / 메타데이터 캐시
+ *
+ * 항목은 파일 이름의 해시로 버킷에 나눠 두고, 표 전체를 하나의 락으로 보호한다.
+ * 표가 가득 차면 새 항목은 표에 넣지 않고 그 요청에서만 쓴 뒤 닫는다.
+ * 파일이 바뀐 것을 알게 되면 항목을 표에서 빼고, 그 항목을 보내고 있던 요청이 놓을 때 닫는다.
+ */
+#include "fcache.h"
+
+static pthread_mutex_t fcache_lock = PTHREAD_MUTEX_INITIALIZER;
+static fcache_entry_t *fcache_buckets[FCACHE_BUCKETS];
+static int fcache_count;            // 표에 들어 있는 항목 수
+
+
+/**
+ * @brief 지금 시각을 밀리초로 얻는 함수
+ *
+ * CLOCK_MONOTONIC_COARSE 는 vDSO 로 읽히므로 시스템 콜이 들지 않는다.
+ */
+static long now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 파일 이름의 해시 값을 구하는 함수 (djb2)
+ */
+static unsigned long hash_name(char *s) {
+  unsigned long h = 5381;
+
+  while (*s) {
+    h = h * 33 + (unsigned char)*s++;
+  }
+  return h;
+}
+
+/**
+ * @brief 파일을 열고 메타데이터와 응답 헤더를 채운 새 항목을 만드는 함수
+ *
+ * @param status 실패하면 FCACHE_NOTFOUND 또는 FCACHE_FORBIDDEN 을 저장한다
+ * @return 새 항목 (참조 1), 실패하면 NULL
+ */
+static fcache_entry_t *open_entry(char *filename, unsigned long hash, int *status) {
+  fcache_entry_t *e;
+  int fd;
+
+  if ((fd = open(filename, O_RDONLY | O_CLOEXEC)) < 0) {
+    *status = (errno == ENOENT || errno == ENOTDIR) ? FCACHE_NOTFOUND : FCACHE_FORBIDDEN;
+    return NULL;
+  }
+
+  e = Calloc(1, sizeof(fcache_entry_t));
+  if (fstat(fd, &e->st) < 0 || !S_ISREG(e->st.st_mode) || !(S_IRUSR & e->st.st_mode)) {
+    *status = FCACHE_FORBIDDEN;
+    close(fd);
+    free(e);
+    return NULL;
+  }
+
+  e->filename = strdup(filename);
+  e->hash = hash;
+  e->fd = fd;
+  get_filetype(filename, e->filetype);
+  e->header_len = snprintf(e->header, sizeof(e->header),
+                           "HTTP/1.0 200 OK\r\n"
+                           "Server: Tiny Web Server\r\n"
+                           "Connection: close\r\n"
+                           "Accept-ranges: bytes\r\n"
+                           "Content-length: %lld\r\n"
+                           "Content-type: %s\r\n\r\n",
+                           (long long)e->st.st_size, e->filetype);
+  e->checked = now_ms();
+  e->refcnt = 1;
+  return e;
+}
+
+/**
+ * @brief 열어 둔 파일이 지금도 같은 파일인지 stat 으로 확인하는 함수
+ */
+static int entry_valid(fcache_entry_t *e) {
+  struct stat st;
+
+  if (stat(e->filename, &st) < 0) {
+    return 0;
+  }
+  return st.st_ino == e->st.st_ino && st.st_dev == e->st.st_dev &&
+         st.st_size == e->st.st_size &&
+         st.st_mtim.tv_sec == e->st.st_mtim.tv_sec && st.st_mtim.tv_nsec == e->st.st_mtim.tv_nsec;
+}
+
+/**
+ * @brief 항목을 표에서 빼는 함수 (fcache_lock 을 잡은 채 호출)
+ *
+ * 표가 가지던 참조는 호출한 쪽이 놓는다.
+ */
+static void unlink_entry(fcache_entry_t *e) {
+  fcache_entry_t **pp = &fcache_buckets[e->hash & (FCACHE_BUCKETS - 1)];
+
+  while (*pp != e) {
+    pp = &(*pp)->next;
+  }
+  *pp = e->next;
+  e->linked = 0;
+  fcache_count--;
+}
+
+/**
+ * @brief 참조를 하나 놓는 함수 (fcache_lock 을 잡은 채 호출, 마지막 참조면 파일을 닫고 해제한다)
+ */
+static void release_entry(fcache_entry_t *e) {
+  if (--e->refcnt == 0) {
+    close(e->fd);
+    free(e->filename);
+    free(e);
+  }
+}
+
+/**
+ * @brief 정적 파일을 보낼 준비가 된 항목을 얻는 함수
+ *
+ * 표에 있고 TTL 안이면 시스템 콜 없이 돌려준다. TTL 이 지났으면 stat 으로 확인하고,
+ * 파일이 바뀌었으면 항목을 버리고 새로 연다. stat 은 락을 잡지 않은 채 부른다.
+ *
+ * @param filename 보낼 파일의 경로
+ * @param ep 성공하면 고정된 항목을 저장한다 (다 보낸 뒤 fcache_put 호출)
+ * @return FCACHE_OK, FCACHE_NOTFOUND 또는 FCACHE_FORBIDDEN
+ */
+int fcache_get(char *filename, fcache_entry_t **ep) {
+  unsigned long hash = hash_name(filename);
+  fcache_entry_t *e, *fresh;
+  int status = FCACHE_OK, valid;
+
+  // 1. 표에서 찾는다.
+  pthread_mutex_lock(&fcache_lock);
+  for (e = fcache_buckets[hash & (FCACHE_BUCKETS - 1)]; e != NULL; e = e->next) {
+    if (e->hash == hash && strcmp(e->filename, filename) == 0) {
+      e->refcnt++;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&fcache_lock);
+
+  // 2. TTL 안이면 그대로 쓰고, 지났으면 파일이 바뀌지 않았는지 확인한다.
+  if (e != NULL) {
+    if (now_ms() - e->checked < FCACHE_TTL_MS) {
+      *ep = e;
+      return FCACHE_OK;
+    }
+    valid = entry_valid(e);
+
+    pthread_mutex_lock(&fcache_lock);
+    if (valid) {
+      e->checked = now_ms();
+      pthread_mutex_unlock(&fcache_lock);
+      *ep = e;
+      return FCACHE_OK;
+    }
+    if (e->linked) {
+      unlink_entry(e);
+      release_entry(e);   // 표가 가지던 참조
+    }
+    release_entry(e);       // 이 호출이 잡았던 참조
+    pthread_mutex_unlock(&fcache_lock);
+  }
+
+  // 3. 새로 열고, 자리가 있으면 표에 넣는다. 다른 요청이 먼저 넣었으면 그 항목을 쓴다.
+  if ((fresh = open_entry(filename, hash, &status)) == NULL) {
+    return status;
+  }
+
+  pthread_mutex_lock(&fcache_lock);
+  for (e = fcache_buckets[hash & (FCACHE_BUCKETS - 1)]; e != NULL; e = e->next) {
+    if (e->hash == hash && strcmp(e->filename, filename) == 0) {
+      break;
+    }
+  }
+  if (e != NULL) {
+    e->refcnt++;
+    release_entry(fresh);
+    fresh = e;
+  } else if (fcache_count < FCACHE_MAX_ENTRIES) {
+    fresh->next = fcache_buckets[hash & (FCACHE_BUCKETS - 1)];
+    fcache_buckets[hash & (FCACHE_BUCKETS - 1)] = fresh;
+    fresh->linked = 1;
+    fresh->refcnt++;        // 표가 가질 참조
+    fcache_count++;
+  }
+  pthread_mutex_unlock(&fcache_lock);
+
+  *ep = fresh;
+  return FCACHE_OK;
+}
+
+/**
+ * @brief fcache_get 이 돌려준 항목을 놓는 함수
+ */
+void fcache_put(fcache_entry_t *e) {
+  pthread_mutex_lock(&fcache_lock);
+  release_entry(e);
+  pthread_mutex_unlock(&fcache_lock);
+}
@@ -0,0 +1,46 @@
+/*
+ * fcache.h - tiny 의 정적 파일 경로를 위한 열린 파일 / 메타데이터 캐시
+ *
+ * 요청마다 stat, open, close, get_filetype 을 부르고 응답 헤더를 다시 만드는 대신,
+ * 파일 이름별로 열린 fd, struct stat, MIME 타입, 미리 만든 응답 헤더를 보관한다.
+ * 항목은 FCACHE_TTL_MS 동안은 그대로 믿고, 그 뒤에는 stat 한 번으로 파일이 바뀌지 않았는지
+ * (inode, 크기, mtime) 확인한다. 그래서 자주 요청되는 파일은 파일 시스템 메타데이터 시스템 콜 없이 보낸다.
+ *
+ * fcache_get 이 돌려준 항목은 참조 카운트로 고정되어 있으므로, 다 보낸 뒤 반드시 fcache_put 을 호출해야 한다.
+ */
+#ifndef __FCACHE_H__
+#define __FCACHE_H__
+
+#include "csapp.h"
+
+#define FCACHE_TTL_MS       1000    // 확인 없이 항목을 믿는 시간 (ms)
+#define FCACHE_MAX_ENTRIES  256     // 표에 둘 수 있는 항목 수 (열어 둘 fd 수)
+#define FCACHE_BUCKETS      256     // 해시 표의 버킷 수 (2의 거듭제곱)
+
+/* fcache_get 의 반환값 */
+#define FCACHE_OK           0
+#define FCACHE_NOTFOUND     -1      // 파일이 없다 (404)
+#define FCACHE_FORBIDDEN    -2      // 일반 파일이 아니거나 읽을 수 없다 (403)
+
+/* 열어 둔 파일 하나 */
+typedef struct fcache_entry {
+  char *filename;                 // key: 요청이 가리키는 파일 경로
+  unsigned long hash;
+  int fd;                         // 읽기 전용으로 열어 둔 파일 (여러 요청이 offset 을 따로 지정해 함께 쓴다)
+  struct stat st;                 // 열 때의 메타데이터
+  char filetype[64];              // MIME 타입
+  char header[MAXLINE];           // 미리 만든 200 응답 헤더 (빈 줄 포함)
+  int header_len;
+  long checked;                   // 마지막으로 파일이 바뀌지 않았는지 확인한 시각 (ms)
+  int refcnt;                     // 표(1, 들어 있으면) + 이 항목을 보내고 있는 요청 수
+  int linked;                     // 표에 들어 있으면 1
+  struct fcache_entry *next;      // 같은 버킷의 다음 항목
+} fcache_entry_t;
+
+int fcache_get(char *filename, fcache_entry_t **ep);
+void fcache_put(fcache_entry_t *e);
+
+/* tiny.c */
+void get_filetype(char *filename, char *filetype);
+
+#endif /* __FCACHE_H__ */
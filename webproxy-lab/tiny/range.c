@@ -0,0 +1,306 @@
+/*
+ * range.c - tiny 의 정적 파일 응답: Range 요청(206 Partial Content)과 응답을 나눠 보내는 조각
+ *
+ * 응답은 조각 목록으로 만든다.
+ * - Range 가 없거나 무시할 때(200): 열린 파일 캐시가 미리 만든 헤더 + 파일 전체
+ * - 구간 하나(206): Content-range 를 넣은 헤더 + 그 구간
+ * - 구간 여럿(206, multipart/byteranges): 헤더, 그리고 구간마다 경계와 부분 헤더 + 그 구간, 마지막 경계
+ * - 파일 안에 드는 구간이 없을 때(416): 파일 크기만 적은 Content-range 를 넣은 헤더
+ * Content-length 는 조각들의 길이를 더해 미리 구하므로 본문을 보내기 전에 헤더를 다 만들 수 있다.
+ */
+#include "tiny.h"
+#include "range.h"
+#include <ctype.h>
+#include <limits.h>
+#include <sys/sendfile.h>
+
+#define RANGE_BUFSIZE MAXLINE   // 206 / 416 응답의 헤더와 multipart 경계를 담을 버퍼 크기
+
+
+/**
+ * @brief 요청 헤더 한 줄이 Range 나 If-Range 면 기억하는 함수
+ *
+ * tiny 는 검증자(ETag, Last-Modified)를 보내지 않으므로 If-Range 의 조건은 맞을 수 없다.
+ * 그래서 If-Range 가 있었으면 호출한 쪽이 Range 를 무시하고 파일 전체를 보내야 한다.
+ *
+ * @param line 헤더 한 줄 (CRLF 로 끝난다)
+ * @param range Range 헤더의 값을 저장할 버퍼 (MAXLINE 크기)
+ * @param if_range If-Range 헤더가 있으면 1 로 바꾼다
+ */
+void range_header(char *line, char *range, int *if_range) {
+  size_t len;
+
+  if (!strncasecmp(line, "If-Range:", 9)) {
+    *if_range = 1;
+    return;
+  }
+  if (strncasecmp(line, "Range:", 6)) {
+    return;
+  }
+  line += 6;
+  line += strspn(line, " \t");
+  len = strcspn(line, "\r\n");
+  if (len >= MAXLINE) {
+    len = 0;          // 너무 긴 값은 무시한다
+  }
+  memcpy(range, line, len);
+  range[len] = '\0';
+}
+
+/**
+ * @brief "bytes=0-99,200-,-50" 같은 Range 값을 파일 크기에 맞는 구간들로 바꾸는 함수
+ *
+ * 끝이 없는 구간(200-)은 파일 끝까지, 뒤에서부터 센 구간(-50)은 마지막 50바이트다.
+ * 끝이 파일 크기를 넘으면 파일 끝으로 줄이고, 시작이 파일 밖인 구간은 뺀다.
+ * 문법이 틀렸거나 구간이 max 개를 넘으면 Range 헤더가 없는 것처럼 전체를 보내도록 0 을 돌려준다.
+ *
+ * @param value Range 헤더의 값
+ * @param size 파일의 크기
+ * @param ranges 구간을 저장할 배열
+ * @param max 배열의 크기
+ * @return int 구간의 수, 무시해야 하면 0, 파일 안에 드는 구간이 없으면 RANGE_UNSATISFIABLE
+ */
+int parse_range(char *value, off_t size, byte_range_t *ranges, int max) {
+  char *p, *end;
+  long long first, last;
+  int n = 0, specs = 0;
+
+  if (strncasecmp(value, "bytes=", 6)) {
+    return 0;
+  }
+  for (p = value + 6; ; p = end + 1) {
+    p += strspn(p, " \t");
+    if (*p == ',') {
+      end = p;
+      continue;       // 빈 항목은 건너뛴다
+    }
+    if (*p == '\0') {
+      break;
+    }
+    if (++specs > max) {
+      return 0;
+    }
+
+    if (*p == '-') {
+      // 뒤에서부터 센 구간: -N
+      if (!isdigit((unsigned char)p[1])) {
+        return 0;
+      }
+      last = strtoll(p + 1, &end, 10);
+      first = (last < size) ? size - last : 0;
+      last = (last > 0) ? size - 1 : -1;
+    } else {
+      // first-last 또는 first-
+      if (!isdigit((unsigned char)*p)) {
+        return 0;
+      }
+      first = strtoll(p, &end, 10);
+      if (*end != '-') {
+        return 0;
+      }
+      p = end + 1;
+      if (isdigit((unsigned char)*p)) {
+        last = strtoll(p, &end, 10);
+        if (last < first) {
+          return 0;
+        }
+      } else {
+        last = LLONG_MAX;
+        end = p;
+      }
+      if (last >= size) {
+        last = size - 1;
+      }
+    }
+    end += strspn(end, " \t");
+    if (*end != ',' && *end != '\0') {
+      return 0;
+    }
+
+    // 파일 안에 드는 구간만 남긴다.
+    if (first < size && first <= last) {
+      ranges[n].first = first;
+      ranges[n].last = last;
+      n++;
+    }
+    if (*end == '\0') {
+      break;
+    }
+  }
+
+  if (specs == 0) {
+    return 0;
+  }
+  return (n > 0) ? n : RANGE_UNSATISFIABLE;
+}
+
+/**
+ * @brief 요청에 맞춰 보낼 응답의 조각 목록을 만드는 함수
+ *
+ * Range 는 GET 에만 적용하고, HEAD 는 헤더만 보낸다.
+ *
+ * @param r 만들 응답
+ * @param fe 보낼 파일의 캐시 항목 (소유권이 r 로 넘어온다)
+ * @param method 요청 메서드
+ * @param range Range 헤더의 값 (없거나 무시해야 하면 NULL 이나 빈 문자열)
+ */
+void reply_init(reply_t *r, fcache_entry_t *fe, char *method, char *range) {
+  byte_range_t ranges[MAX_RANGES];
+  char boundary[64], parts[RANGE_BUFSIZE];
+  int part_off[MAX_RANGES + 1], parts_len = 0, hlen, i, n = 0;
+  int head = !strcasecmp(method, "HEAD");
+  long long size = fe->st.st_size, body;
+
+  r->fe = fe;
+  r->buf = NULL;
+  r->cur = 0;
+  r->mem_sent = 0;
+
+  if (!head && range != NULL && *range != '\0') {
+    n = parse_range(range, fe->st.st_size, ranges, MAX_RANGES);
+  }
+
+  // 1. Range 가 없거나 무시할 때: 미리 만든 200 헤더 + 파일 전체
+  if (n == 0) {
+    r->segs[0].mem = fe->header;
+    r->segs[0].len = fe->header_len;
+    r->segs[0].off = 0;
+    r->segs[0].end = head ? 0 : size;
+    r->nsegs = 1;
+    return;
+  }
+
+  r->buf = Malloc(RANGE_BUFSIZE);
+
+  // 2. 파일 안에 드는 구간이 없을 때: 416
+  if (n == RANGE_UNSATISFIABLE) {
+    hlen = snprintf(r->buf, RANGE_BUFSIZE,
+                    "HTTP/1.0 416 Range Not Satisfiable\r\n"
+                    "Server: Tiny Web Server\r\n"
+                    "Connection: close\r\n"
+                    "Content-length: 0\r\n"
+                    "Content-range: bytes */%lld\r\n\r\n",
+                    size);
+    r->segs[0] = (reply_seg_t){ r->buf, hlen, 0, 0 };
+    r->nsegs = 1;
+    return;
+  }
+
+  // 3. 구간 하나: Content-range 를 넣은 헤더 + 그 구간
+  if (n == 1) {
+    hlen = snprintf(r->buf, RANGE_BUFSIZE,
+                    "HTTP/1.0 206 Partial Content\r\n"
+                    "Server: Tiny Web Server\r\n"
+                    "Connection: close\r\n"
+                    "Accept-ranges: bytes\r\n"
+                    "Content-length: %lld\r\n"
+                    "Content-range: bytes %lld-%lld/%lld\r\n"
+                    "Content-type: %s\r\n\r\n",
+                    (long long)(ranges[0].last - ranges[0].first + 1),
+                    (long long)ranges[0].first, (long long)ranges[0].last, size, fe->filetype);
+    r->segs[0] = (reply_seg_t){ r->buf, hlen, ranges[0].first, ranges[0].last + 1 };
+    r->nsegs = 1;
+    return;
+  }
+
+  // 4. 구간 여럿: multipart/byteranges. 경계는 파일마다 다르게 inode 와 mtime 으로 만든다.
+  //    부분 헤더들을 먼저 만들어 본문 길이를 구한 뒤 응답 헤더 뒤에 붙인다.
+  snprintf(boundary, sizeof(boundary), "TINY%lx%lx",
+           (unsigned long)fe->st.st_ino, (unsigned long)fe->st.st_mtime);
+  body = 0;
+  for (i = 0; i < n; i++) {
+    part_off[i] = parts_len;
+    parts_len += snprintf(parts + parts_len, sizeof(parts) - parts_len,
+                          "\r\n--%s\r\n"
+                          "Content-type: %s\r\n"
+                          "Content-range: bytes %lld-%lld/%lld\r\n\r\n",
+                          boundary, fe->filetype,
+                          (long long)ranges[i].first, (long long)ranges[i].last, size);
+    body += ranges[i].last - ranges[i].first + 1;
+  }
+  part_off[n] = parts_len;
+  parts_len += snprintf(parts + parts_len, sizeof(parts) - parts_len, "\r\n--%s--\r\n", boundary);
+  body += parts_len;
+
+  hlen = snprintf(r->buf, RANGE_BUFSIZE,
+                  "HTTP/1.0 206 Partial Content\r\n"
+                  "Server: Tiny Web Server\r\n"
+                  "Connection: close\r\n"
+                  "Accept-ranges: bytes\r\n"
+                  "Content-length: %lld\r\n"
+                  "Content-type: multipart/byteranges; boundary=%s\r\n\r\n",
+                  body, boundary);
+  memcpy(r->buf + hlen, parts, parts_len);
+
+  // 응답 헤더와 첫 부분 헤더는 한 조각으로 보낸다.
+  r->segs[0] = (reply_seg_t){ r->buf, hlen + part_off[1], ranges[0].first, ranges[0].last + 1 };
+  for (i = 1; i < n; i++) {
+    r->segs[i] = (reply_seg_t){ r->buf + hlen + part_off[i], part_off[i + 1] - part_off[i],
+                                ranges[i].first, ranges[i].last + 1 };
+  }
+  r->segs[n] = (reply_seg_t){ r->buf + hlen + part_off[n], parts_len - part_off[n], 0, 0 };
+  r->nsegs = n + 1;
+}
+
+/**
+ * @brief 응답의 조각들을 소켓이 받아 주는 만큼 차례로 보내는 함수
+ *
+ * 메모리 조각은 뒤에 보낼 것이 남아 있으면 MSG_MORE 로 보내 다음 파일 구간의 첫 부분과 같은
+ * 세그먼트에 싣고, 파일 구간은 sendfile 로 캐시 항목의 fd 에서 그 구간의 offset 부터 보낸다.
+ * 블로킹 소켓이면 다 보내거나 실패할 때까지 돌아오지 않는다.
+ *
+ * @param fd 클라이언트와 연결된 소켓
+ * @param r 보낼 응답
+ * @return int 다 보냈으면 1, 소켓이 가득 차 더 기다려야 하면 0, 보낼 수 없으면 -1
+ */
+int reply_send(int fd, reply_t *r) {
+  reply_seg_t *s;
+  ssize_t n;
+  int more;
+
+  for (; r->cur < r->nsegs; r->cur++, r->mem_sent = 0) {
+    s = &r->segs[r->cur];
+    more = (s->off < s->end) || (r->cur + 1 < r->nsegs);
+
+    while (r->mem_sent < s->len) {
+      if ((n = send(fd, s->mem + r->mem_sent, s->len - r->mem_sent, more ? MSG_MORE : 0)) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+      }
+      r->mem_sent += n;
+    }
+
+    while (s->off < s->end) {
+      n = sendfile(fd, r->fe->fd, &s->off, s->end - s->off);
+      if (n > 0 || (n < 0 && errno == EINTR)) {
+        continue;
+      }
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+      }
+      // sendfile 을 지원하지 않는 파일이면 소켓을 블로킹으로 되돌리고 버퍼로 읽어서 보낸다.
+      if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+        copy_file(fd, r->fe->fd, s->off, s->end);
+        s->off = s->end;
+        continue;
+      }
+      return -1;      // 파일이 줄었거나 클라이언트가 연결을 끊었다
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief 응답이 잡고 있는 버퍼와 캐시 항목을 돌려주는 함수
+ */
+void reply_free(reply_t *r) {
+  if (r->fe != NULL) {
+    fcache_put(r->fe);
+    r->fe = NULL;
+  }
+  free(r->buf);
+  r->buf = NULL;
+}
@@ -0,0 +1,49 @@
+/*
+ * range.h - tiny 의 정적 파일 응답: Range 요청(206 Partial Content)과 응답을 나눠 보내는 조각
+ *
+ * 동영상을 넘겨 보거나 끊긴 다운로드를 이어 받는 클라이언트는 "Range: bytes=..." 로 파일의 일부만
+ * 요청한다. 응답은 메모리 조각(응답 헤더, multipart 경계)과 그 뒤에 이어지는 파일 구간의 목록으로
+ * 만들어 두고, 파일 구간은 sendfile 로 그 offset 부터 보낸다. 그래서 요청한 바이트만 보낸다.
+ *
+ * 블로킹 소켓(iter, thread 모드)과 non-blocking 소켓(epoll 모드)이 같은 reply_send 를 쓴다.
+ */
+#ifndef __RANGE_H__
+#define __RANGE_H__
+
+#include "csapp.h"
+#include "fcache.h"
+
+#define MAX_RANGES          16      // 한 요청에서 받아 주는 구간 수 (넘으면 Range 를 무시하고 전체를 보낸다)
+#define RANGE_UNSATISFIABLE -1      // parse_range: 파일 안에 드는 구간이 하나도 없다 (416)
+
+/* 요청한 바이트 구간 [first, last] */
+typedef struct {
+  off_t first;
+  off_t last;
+} byte_range_t;
+
+/* 응답의 조각 하나: 메모리 mem[0..len) 을 보낸 뒤 파일 [off, end) 를 보낸다 */
+typedef struct {
+  char *mem;
+  int len;
+  off_t off;
+  off_t end;
+} reply_seg_t;
+
+/* 보낼 정적 파일 응답 하나 */
+typedef struct {
+  fcache_entry_t *fe;             // 보낼 파일의 캐시 항목 (reply_free 가 fcache_put 한다)
+  char *buf;                      // 206 / 416 응답의 헤더와 경계를 담은 버퍼 (200 이면 NULL)
+  reply_seg_t segs[MAX_RANGES + 2];
+  int nsegs;
+  int cur;                        // 보내는 중인 조각
+  int mem_sent;                   // 지금 조각의 메모리 중 보낸 바이트 수
+} reply_t;
+
+void range_header(char *line, char *range, int *if_range);
+int parse_range(char *value, off_t size, byte_range_t *ranges, int max);
+void reply_init(reply_t *r, fcache_entry_t *fe, char *method, char *range);
+int reply_send(int fd, reply_t *r);
+void reply_free(reply_t *r);
+
+#endif /* __RANGE_H__ */
@@ -1,50 +1,115 @@
 /* $begin tinymain */
 /*
- * tiny.c - A simple, iterative HTTP/1.0 Web server that uses the
- *     GET method to serve static and dynamic content.
+ * tiny.c - A simple HTTP/1.0 Web server that uses the GET method to
+ *     serve static and dynamic content. Connections are handled
+ *     iteratively (default), by prespawned threads (-m thread), or by
+ *     epoll event loops (-m epoll, see evloop.c).
  *
  * Updated 11/2019 droh
  *   - Fixed sprintf() aliasing issue in serve_static(), and clienterror().
  */
-#include "csapp.h"
-
+#include "tiny.h"
+#include "cgipool.h"
+#include "range.h"
+#include <sys/syscall.h>
+
+void usage(char *prog);
+void *accept_worker(void *vargp);
+void serve_conn(int connfd, struct sockaddr_storage *addr, socklen_t addrlen);
 void doit(int fd);
-void read_requesthdrs(rio_t *rp);
+void read_requesthdrs(rio_t *rp, char *range);
 int parse_uri(char *uri, char *filename, char *cgiargs);
-void serve_static(int fd, char *filename, int filesize, char *method);
-void get_filetype(char *filename, char *filetype);
+void serve_static(int fd, fcache_entry_t *fe, char *method, char *range);
 void serve_dynamic(int fd, char *filename, char *cgiargs, char *method);
-void clienterror(int fd, char *cause, char *errnum, char *shortmsg,
-                 char *longmsg);
 void sigchld_handler(int sig);
 
+#define DEFAULT_THREADS 16  // thread 모드의 기본 작업 스레드 수
+
+tiny_config_t config = {
+  .mode = MODE_ITER,
+  .nthreads = 0,          // 0 이면 방식에 맞는 기본값을 쓴다
+  .cgi_workers = 0,
+};
+
 /**
  * @brief HTTP 웹 서버의 메인 실행 함수
  *
  * 지정된 포트에서 클라이언트의 연결을 대기하고, 연결이 수립되면
  * 해당 클라이언트의 HTTP 요청을 처리한다. 서버는 무한 루프로 실행된다.
  *
+ * 기본(iter)은 연결을 하나씩 차례로 처리하므로 느린 클라이언트 하나가 나머지를 모두 막는다.
+ * -m thread 는 작업 스레드들을, -m epoll 은 이벤트 루프들을 미리 만들어 연결을 동시에 처리한다.
+ * -w 를 주면 CGI 프로그램을 요청마다 띄우지 않고 상주 worker 에게 맡긴다 (cgipool.c).
+ *
  * @param argc 명령행 인자의 개수
- * @param argv 명령행 인자 배열 (argv[1]은 포트 번호)
+ * @param argv 명령행 인자 배열 (포트 번호와 실행 옵션)
  * @return int 프로그램 종료 코드
  */
 int main(int argc, char **argv) {
-  int listenfd, connfd;
-  char hostname[MAXLINE], port[MAXLINE];
+  int listenfd, connfd, opt, i;
   socklen_t clientlen;
   struct sockaddr_storage clientaddr;
-
-  // 1. 포트 번호 입력 확인
-  if (argc != 2) {
-    fprintf(stderr, "usage: %s <port>\n", argv[0]);
-    exit(1);
+  pthread_t tid;
+
+  // 1. 실행 옵션과 포트 번호 입력 확인
+  while ((opt = getopt(argc, argv, "m:n:w:")) != -1) {
+    switch (opt) {
+    case 'm':
+      if (!strcmp(optarg, "iter")) {
+        config.mode = MODE_ITER;
+      } else if (!strcmp(optarg, "thread")) {
+        config.mode = MODE_THREAD;
+      } else if (!strcmp(optarg, "epoll")) {
+        config.mode = MODE_EPOLL;
+      } else {
+        usage(argv[0]);
+      }
+      break;
+    case 'n':
+      if ((config.nthreads = atoi(optarg)) <= 0) {
+        usage(argv[0]);
+      }
+      break;
+    case 'w':
+      config.cgi_workers = atoi(optarg);
+      if (config.cgi_workers < 0 || config.cgi_workers > CGI_MAX_WORKERS) {
+        usage(argv[0]);
+      }
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1) {
+    usage(argv[0]);
+  }
+  // epoll 모드는 CPU 마다 이벤트 루프를 하나씩 둔다.
+  if (config.nthreads == 0) {
+    config.nthreads = (config.mode == MODE_EPOLL) ? (int)sysconf(_SC_NPROCESSORS_ONLN) : DEFAULT_THREADS;
   }
 
   /* SIGCHLD 신호가 오면 sigchld_hanlder 함수를 실행한다. */
   Signal(SIGCHLD, sigchld_handler);
 
+  // 클라이언트가 먼저 연결을 끊어도 SIGPIPE 로 서버 전체가 죽지 않도록 한다.
+  Signal(SIGPIPE, SIG_IGN);
+
   // 2. 입력 받은 포트 번호로 클라이언트의 연결을 기다리는 서버 소켓 열기
-  listenfd = Open_listenfd(argv[1]);
+  listenfd = Open_listenfd(argv[optind]);
+
+  // epoll 모드에서는 이벤트 루프들이 듣기 소켓을 나눠 기다리며 모든 연결을 처리한다.
+  if (config.mode == MODE_EPOLL) {
+    evloop_run(listenfd, config.nthreads);
+    exit(0);
+  }
+
+  // thread 모드에서는 작업 스레드들이 각자 accept 해서 처리하고, 메인 스레드는 빠진다.
+  if (config.mode == MODE_THREAD) {
+    for (i = 0; i < config.nthreads; i++) {
+      Pthread_create(&tid, NULL, accept_worker, &listenfd);
+    }
+    Pthread_exit(NULL);
+  }
 
   // 3. 서버가 종료되지 않도록 무한루프 처리
   while (1) {
@@ -55,22 +120,83 @@ int main(int argc, char **argv) {
     connfd = Accept(listenfd, (SA *)&clientaddr,
                     &clientlen); // line:netp:tiny:accept
 
-    // 5. 접속한 클라이언트의 IP주소와 포트 번호를 얻는다.
-    Getnameinfo((SA *)&clientaddr, clientlen, hostname, MAXLINE, port, MAXLINE,
-                0);
-    printf("Accepted connection from (%s, %s)\n", hostname, port);
+    // 5. 연결 하나를 처리하고 닫는다.
+    serve_conn(connfd, &clientaddr, clientlen);
+  }
+}
 
-    // 6. 클라이언트와의 실제 통신(요청 처리 및 응답)은 doit 함수에게 맡기기
-    doit(connfd);  // line:netp:tiny:doit
+/**
+ * @brief 사용법을 출력하고 종료하는 함수
+ *
+ * @param prog 실행 파일 이름
+ */
+void usage(char *prog) {
+  fprintf(stderr, "usage: %s <port> [-m iter|thread|epoll] [-n nthreads] [-w cgi_workers]\n", prog);
+  exit(1);
+}
 
-    // 7. doit 함수가 끝나면(=통신 완료) 클라이언트와 연결을 닫는다.
-    Close(connfd); // line:netp:tiny:close
+/**
+ * @brief thread 모드의 작업 스레드 함수
+ *
+ * 모든 작업 스레드가 같은 듣기 소켓에서 accept 를 기다리고, 커널이 새 연결을 그중 하나에게 준다.
+ * 연결 대기열이나 스레드 생성 없이 바로 처리하므로 느린 연결이 있어도 나머지 스레드는 계속 받는다.
+ * accept 가 실패해도(연결이 먼저 끊겼거나 fd 가 부족하거나) 서버를 끝내지 않고 다음 연결을 기다린다.
+ *
+ * @param vargp 듣기 소켓을 가리키는 포인터
+ * @return void* 돌아오지 않는다
+ */
+void *accept_worker(void *vargp) {
+  int listenfd = *(int *)vargp, connfd;
+  socklen_t clientlen;
+  struct sockaddr_storage clientaddr;
 
-    printf("---------------------------------\n");
-    fflush(stdout);
+  Pthread_detach(pthread_self());
+  while (1) {
+    clientlen = sizeof(clientaddr);
+    if ((connfd = accept(listenfd, (SA *)&clientaddr, &clientlen)) < 0) {
+      continue;
+    }
+    serve_conn(connfd, &clientaddr, clientlen);
   }
+  return NULL;
 }
 
+/**
+ * @brief 연결 하나를 처리하고 닫는 함수 (iter, thread 모드)
+ *
+ * @param connfd 클라이언트와 연결된 소켓
+ * @param addr 클라이언트 주소
+ * @param addrlen 클라이언트 주소의 길이
+ */
+void serve_conn(int connfd, struct sockaddr_storage *addr, socklen_t addrlen) {
+  // 1. 접속한 클라이언트의 IP주소와 포트 번호를 출력한다.
+  log_accept(addr, addrlen);
+
+  // 2. 클라이언트와의 실제 통신(요청 처리 및 응답)은 doit 함수에게 맡기기
+  doit(connfd);  // line:netp:tiny:doit
+
+  // 3. doit 함수가 끝나면(=통신 완료) 클라이언트와 연결을 닫는다.
+  Close(connfd); // line:netp:tiny:close
+
+  printf("---------------------------------\n");
+  fflush(stdout);
+}
+
+/**
+ * @brief 접속한 클라이언트의 IP주소와 포트 번호를 출력하는 함수
+ *
+ * 역방향 DNS 조회로 연결 처리가 멈추지 않도록 숫자 주소만 얻는다.
+ *
+ * @param addr 클라이언트 주소
+ * @param addrlen 클라이언트 주소의 길이
+ */
+void log_accept(struct sockaddr_storage *addr, socklen_t addrlen) {
+  char hostname[MAXLINE], port[MAXLINE];
+
+  Getnameinfo((SA *)addr, addrlen, hostname, MAXLINE, port, MAXLINE,
+              NI_NUMERICHOST | NI_NUMERICSERV);
+  printf("Accepted connection from (%s, %s)\n", hostname, port);
+}
 
 /**
  * @brief 자식 프로세스가 종료될 때 호출되는 시그널 핸들러
@@ -101,65 +227,101 @@ void sigchld_handler(int sig) {
  * 클라이언트로부터 받은 HTTP 요청을 분석하고 적절한 응답을 생성하여 전송한다.
  * 정적 컨텐츠(파일)와 동적 컨텐츠(CGI 프로그램)에 대한 요청을 모두 처리할 수 있다.
  * 현재는 GET 메서드만 지원한다.
+ *
+ * 여러 연결을 동시에 처리하는 모드에서도 쓰이므로, 클라이언트가 먼저 연결을 끊는 등의
+ * 입출력 실패로 서버 전체가 끝나지 않도록 에러에서 종료하는 Rio_ 래퍼 대신 rio_ 함수를 쓴다.
  * 
  * @param fd 클라이언트와 연결된 소켓 파일 디스크립터
  */
 void doit(int fd) {
-  int is_static;
-  struct stat sbuf;
-  char buf[MAXLINE], method[MAXLINE], uri[MAXLINE], version[MAXLINE];
-  char filename[MAXLINE], cgiargs[MAXLINE];
+  fcache_entry_t *fe;
+  char buf[MAXLINE], method[MAXLINE], uri[MAXLINE], version[MAXLINE], range[MAXLINE];
   rio_t rio;
 
   // 1. 소켓(fd)에서 데이터를 읽을 준비하기
   Rio_readinitb(&rio, fd);
+
   // 2. 클라이언트가 보낸 요청의 첫 줄(요청 라인) 읽기
-  Rio_readlineb(&rio, buf, MAXLINE);
+  if (rio_readlineb(&rio, buf, MAXLINE) <= 0) {
+    return;   // 요청을 보내지 않고 연결을 끊었다
+  }
   printf("Request headers:\n");
   printf("%s", buf);
-  // 3. 요청 라인에서 메서드 ,URI, HTTP 버전을 분리해 각 변수에 저장하기
-  sscanf(buf, "%s %s %s", method, uri, version);
 
-  // 4. GET, HEAD 메서드가 아니면 에러를 보낸다.
-  if (strcasecmp(method, "GET") && strcasecmp(method, "HEAD")) {
-    clienterror(fd, method, "501", "Not implemented", "Tiny does not implement this method");
+  // 3. 요청 라인에서 메서드 ,URI, HTTP 버전을 분리해 각 변수에 저장하기
+  if (sscanf(buf, "%s %s %s", method, uri, version) < 2) {
+    clienterror(fd, buf, "400", "Bad request", "Tiny couldn't parse the request line");
     return;
   }
 
-  // 5. 요청 헤더를 읽어서 버린다. (tiny는 헤더 정보를 사용하지 않음)
-  read_requesthdrs(&rio);
+  // 4. 요청 헤더를 읽는다. (tiny는 Range 헤더만 사용한다)
+  read_requesthdrs(&rio, range);
 
-  // 6. URI를 분석해서 정적 요청인지 동적 요청인지 판단한다.
-  is_static = parse_uri(uri, filename, cgiargs);
+  // 5. 요청을 처리한다. 정적 컨텐츠면 열린 파일 캐시 항목을 받아 요청한 구간을 보낸다.
+  if (route_request(fd, method, uri, &fe)) {
+    serve_static(fd, fe, method, range);
+  }
+}
 
-  // 7. 'filename'에 해당하는 파일을 가져온다. 실패하면 '파일 없음' 에러를 보낸다.
-  if (stat(filename, &sbuf) < 0) {
-    clienterror(fd, filename, "404", "Not found", "Tiny couldn't find this file");
-    return;
+/**
+ * @brief 요청 라인을 보고 응답을 정하는 함수 (모든 모드가 함께 쓴다)
+ *
+ * 에러 응답과 CGI 는 이 함수 안에서 보낸다. 정적 컨텐츠는 보낼 파일의 캐시 항목만 돌려주고,
+ * 보내는 방법은 호출한 쪽이 정한다 (블로킹 소켓이면 serve_static, epoll 모드면 상태 기계).
+ *
+ * @param fd 클라이언트와 연결된 소켓 파일 디스크립터
+ * @param method 요청 메서드
+ * @param uri 요청 URI
+ * @param fe 정적 컨텐츠면 보낼 파일의 캐시 항목을 저장한다 (다 보낸 뒤 fcache_put 호출)
+ * @return int 정적 컨텐츠를 보내야 하면 1, 응답을 이미 보냈으면 0
+ */
+int route_request(int fd, char *method, char *uri, fcache_entry_t **fe) {
+  int is_static;
+  struct stat sbuf;
+  char filename[MAXLINE], cgiargs[MAXLINE];
+
+  // 1. GET, HEAD 메서드가 아니면 에러를 보낸다.
+  if (strcasecmp(method, "GET") && strcasecmp(method, "HEAD")) {
+    clienterror(fd, method, "501", "Not implemented", "Tiny does not implement this method");
+    return 0;
   }
 
-  // 8. 정적 컨텐츠 요청 처리
+  // 2. URI를 분석해서 정적 요청인지 동적 요청인지 판단한다.
+  is_static = parse_uri(uri, filename, cgiargs);
+
+  // 3. 정적 컨텐츠 요청 처리
+  //    열린 파일 캐시에서 fd, 메타데이터, 응답 헤더를 한 번에 얻는다. 자주 요청되는 파일은
+  //    stat/open 없이 바로 보낼 수 있다.
   if (is_static) {
-    // 8-1. 해당 파일이 일반 파일이 아니거나, 읽기 권한이 없으면 에러를 보낸다.
-    if (!(S_ISREG(sbuf.st_mode)) || !(S_IRUSR & sbuf.st_mode)) {
+    switch (fcache_get(filename, fe)) {
+    case FCACHE_NOTFOUND:
+      // 3-1. 'filename'에 해당하는 파일이 없으면 '파일 없음' 에러를 보낸다.
+      clienterror(fd, filename, "404", "Not found", "Tiny couldn't find this file");
+      return 0;
+    case FCACHE_FORBIDDEN:
+      // 3-2. 해당 파일이 일반 파일이 아니거나, 읽기 권한이 없으면 에러를 보낸다.
       clienterror(fd, filename, "403", "Forbidden", "Tiny couldn't read the file");
-      return;
+      return 0;
     }
-    // 8-2. serve_static 함수를 호출해 파일을 클라이언트에게 보낸다.
-    serve_static(fd, filename, sbuf.st_size, method);
+    return 1;
   }
-  // 9. 동적 컨텐츠 요청 처리
-  else {
-    // 9-1. 해당 파일이 일반 파일이 아니거나, 실행 권한이 없으면 에러를 보낸다.
-    if (!(S_ISREG(sbuf.st_mode)) || !(S_IXUSR & sbuf.st_mode)) {
-      clienterror(fd, filename, "403", "Forbidden", "Tiny couldn't run the CGI program");
-      return;
-    }
-    // 9-2. serve_dynamic 함수를 호출해 프로그램을 실행하고, 결과를 클라이언트에게 보낸다.
-    serve_dynamic(fd, filename, cgiargs, method);
+
+  // 4. 'filename'에 해당하는 프로그램을 찾는다. 실패하면 '파일 없음' 에러를 보낸다.
+  if (stat(filename, &sbuf) < 0) {
+    clienterror(fd, filename, "404", "Not found", "Tiny couldn't find this file");
+    return 0;
   }
-}
 
+  // 5. 동적 컨텐츠 요청 처리
+  // 5-1. 해당 파일이 일반 파일이 아니거나, 실행 권한이 없으면 에러를 보낸다.
+  if (!(S_ISREG(sbuf.st_mode)) || !(S_IXUSR & sbuf.st_mode)) {
+    clienterror(fd, filename, "403", "Forbidden", "Tiny couldn't run the CGI program");
+    return 0;
+  }
+  // 5-2. serve_dynamic 함수를 호출해 프로그램을 실행하고, 결과를 클라이언트에게 보낸다.
+  serve_dynamic(fd, filename, cgiargs, method);
+  return 0;
+}
 
 /**
  * @brief URI를 파싱하여 파일 이름과 CGI 인자를 추출하는 함수
@@ -209,52 +371,48 @@ int parse_uri(char *uri, char *filename, char *cgiargs) {
 /**
  * @brief 정적 컨텐츠를 클라이언트에게 전송하는 함수
  *
- * 요청된 파일의 내용을 읽어서 HTTP 응답으로 클라이언트에게 전송한다.
+ * 요청된 파일의 내용을 HTTP 응답으로 클라이언트에게 전송한다.
  * 응답 헤더와 파일 내용을 포함한다.
  *
+ * 파일 크기만큼 메모리를 할당해 읽고 다시 쓰는 대신, sendfile 로 커널이 페이지 캐시에서
+ * 소켓으로 바로 보내게 한다. 헤더는 MSG_MORE 로 보내 본문의 첫 부분과 같은 세그먼트에 실린다.
+ * 파일과 응답 헤더는 열린 파일 캐시가 준비해 두므로 여기서는 열거나 닫지 않는다.
+ * Range 요청이면 요청한 구간만 그 offset 부터 보낸다 (206 Partial Content, range.c).
+ *
  * @param fd 클라이언트와 연결된 소켓 파일 디스크립터
- * @param filename 전송할 파일의 경로
- * @param filesize 파일의 크기
+ * @param fe 전송할 파일의 캐시 항목 (열린 fd, 크기, 미리 만든 응답 헤더, 다 보낸 뒤 놓아준다)
+ * @param method 요청 메서드 (HEAD 이면 헤더만 보낸다)
+ * @param range Range 헤더의 값 (없으면 빈 문자열)
  */
-void serve_static(int fd, char *filename, int filesize, char *method) {
-  int srcfd;
-  char *srcp, filetype[MAXLINE], buf[MAXLINE];
-
-  // 1. 파일 확장자를 보고 HTTP 응답 헤더에 들어갈 파일 타입(Content-Type)을 결정한다.
-  get_filetype(filename, filetype);
-
-  // 2. HTTP 응답 헤더를 'buf' 버퍼에 만든다. (상태 코드, 파일 크기, 파일 타입 등)
-  sprintf(buf, "HTTP/1.0 200 OK\r\n");
-  sprintf(buf, "%sServer: Tiny Web Server\r\n", buf);
-  sprintf(buf, "%sConnection: close\r\n", buf);
-  sprintf(buf, "%sContent-length: %d\r\n", buf, filesize);
-  sprintf(buf, "%sContent-type: %s\r\n\r\n", buf, filetype);
-  // 3. 만들어진 응답 헤더를 클라이언트에게 보낸다.
-  Rio_writen(fd, buf, strlen(buf));
+void serve_static(int fd, fcache_entry_t *fe, char *method, char *range) {
+  reply_t reply;
 
-  // 문제 11.11 : HEAD 메서드일 때는 응답 헤더만 보내고 본문은 보내지 않는다.
-  if (!strcasecmp(method, "HEAD")) {
-    return;
-  }
-
-  // 파일을 담을 빈 메모리 공간 생성
-  srcp = Malloc(filesize);
-
-  // 4. 보낼 파일을 연다.
-  srcfd = Open(filename, O_RDONLY, 0);
-
-  // 5. 파일의 내용을 빈 메모리 공간에 복사
-  // (1) 어떤 파일에서 읽어서(=파일 번호표) (2) 어디에 담을지(=메모리 주소) (3) 얼마나 많이 읽을지(=파일 크기)
-  Rio_readn(srcfd, srcp, filesize);
+  reply_init(&reply, fe, method, range);
+  reply_send(fd, &reply);   // 블로킹 소켓이므로 다 보내거나 실패해야 돌아온다
+  reply_free(&reply);
+}
 
-  // 6. 파일 디스크립터는 이제 필요없기 때문에 닫는다.
-  Close(srcfd);
 
-  // 7. 메모리에 매핑된 파일 내용을 클라이언트에게 전부 보낸다.
-  Rio_writen(fd, srcp, filesize);
+/**
+ * @brief sendfile 을 쓸 수 없는 파일을 버퍼로 읽어서 보내는 함수
+ *
+ * 파일 전체를 한 번에 할당하지 않고 MAXBUF 크기의 버퍼 하나로 나눠 보낸다.
+ *
+ * @param fd 클라이언트와 연결된 소켓 파일 디스크립터
+ * @param srcfd 보낼 파일
+ * @param offset 이미 보낸 바이트 수
+ * @param filesize 파일의 크기
+ */
+void copy_file(int fd, int srcfd, off_t offset, int filesize) {
+  char buf[MAXBUF];
+  ssize_t n;
 
-  // 8. 할당받았던 메모리 해제
-  free(srcp);
+  while (offset < filesize && (n = pread(srcfd, buf, MAXBUF, offset)) > 0) {
+    if (rio_writen(fd, buf, n) < 0) {
+      return;
+    }
+    offset += n;
+  }
 }
 
 
@@ -263,39 +421,71 @@ void serve_static(int fd, char *filename, int filesize, char *method) {
  *
  * CGI 프로그램을 실행하고 그 출력을 클라이언트에게 전송한다.
  * 자식 프로세스를 생성하여 CGI 프로그램을 실행한다.
+ * -w 로 상주 worker 를 켜 두었으면 fork/execve 없이 쉬는 worker 에게 맡긴다.
  *
  * @param fd 클라이언트와 연결된 소켓 파일 디스크립터
  * @param filename 실행할 CGI 프로그램의 경로
  * @param cgiargs CGI 프로그램에 전달할 인자
  */
 void serve_dynamic(int fd, char *filename, char *cgiargs, char *method) {
-  char buf[MAXLINE], *emptylist[] = { NULL };
+  char *emptylist[] = { NULL };
+  rio_iov_t resp;
+
+  // 0. epoll 모드의 소켓은 non-blocking 이다. CGI 프로그램은 블로킹 stdout 을 가정하므로 되돌린다.
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
 
-  // 1. 기본적인 성공 응답 헤더를 먼저 보낸다.
-  sprintf(buf, "HTTP/1.0 200 OK\r\n");
-  Rio_writen(fd, buf, strlen(buf));
-  sprintf(buf, "Server: Tiny Web Server \r\n");
-  Rio_writen(fd, buf, strlen(buf));
+  // 1. 기본적인 성공 응답 헤더를 먼저 보낸다. 두 줄을 writev 한 번으로 보내 세그먼트가 나뉘지 않게 한다.
+  rio_iovinit(&resp);
+  rio_iovprintf(&resp, "HTTP/1.0 200 OK\r\n");
+  rio_iovprintf(&resp, "Server: Tiny Web Server \r\n");
+  rio_writev(fd, &resp);
 
   // 문제 11.11 : HEAD 메서드일 때는 응답 헤더만 보내고 본문은 보내지 않는다.
   if (!strcasecmp(method, "HEAD")) {
     return;
   }
 
-  // 2. Fork()로 현재 프로세스를 복제하여 자식 프로세스를 만든다.
+  // 2. 상주 worker 를 쓰면 쉬는 worker 에게 요청과 소켓을 넘긴다. 넘기지 못했을 때만 fork/execve 한다.
+  if (config.cgi_workers > 0 && cgipool_dispatch(filename, cgiargs, fd) == 0) {
+    return;
+  }
+
+  // 3. Fork()로 현재 프로세스를 복제하여 자식 프로세스를 만든다.
   if (Fork() == 0) { // 자식 프로세스만 이 코드 블록을 실행한다.
-    // 3. CGI 인자를 `QUERY_STRING` 환경 변수로 설정한다.
+    // 4. CGI 인자를 `QUERY_STRING` 환경 변수로 설정한다.
     // CGI 프로그램이 이 값을 읽어 사용한다.
     setenv("QUERY_STRING", cgiargs, 1);
-    // 4. `dup2` 를 사용해, 표준 출력(원래 화면으로 향함)의 방향을 클라이언트 소켓(fd)으로 바꾼다.
+    // 5. `dup2` 를 사용해, 표준 출력(원래 화면으로 향함)의 방향을 클라이언트 소켓(fd)으로 바꾼다.
     Dup2(fd, STDOUT_FILENO);
-    // 5. `execve`로 지정된 CGI 프로그램을 실행한다.
+    // 6. 물려받은 나머지 fd(다른 연결의 소켓, 듣기 소켓, epoll, 열어 둔 파일)를 닫는다.
+    close_inherited_fds();
+    // 7. `execve`로 지정된 CGI 프로그램을 실행한다.
     //    이제 이 프로그램이 화면에 출력하는 모든 내용은 소켓을 통해 클라이언트에게 전달된다.
     Execve(filename, emptylist, environ);
   }
   // Wait(NULL);   /* 숙제 문제 11.18 : 주석 처리 */
 }
 
+/**
+ * @brief CGI 자식 프로세스가 표준 입출력 말고 물려받은 fd 를 모두 닫는 함수
+ *
+ * 여러 연결을 동시에 처리하는 모드에서는 fork 한 순간 열려 있던 다른 연결의 소켓도 자식에게 복제된다.
+ * 자식이 그 소켓을 쥐고 있으면 부모가 닫아도 그 연결은 CGI 가 끝날 때까지 닫히지 않고,
+ * epoll 에 등록된 소켓이면 부모가 닫은 뒤에도 이벤트가 계속 온다.
+ * close_range 를 쓸 수 없는 커널이면 열 수 있는 fd 번호를 하나씩 닫는다.
+ */
+void close_inherited_fds(void) {
+  long fd, maxfd;
+
+  if (syscall(SYS_close_range, 3, ~0U, 0) == 0) {
+    return;
+  }
+  maxfd = sysconf(_SC_OPEN_MAX);
+  for (fd = 3; fd < maxfd; fd++) {
+    close(fd);
+  }
+}
+
 
 /**
  * @brief 파일의 MIME 타입을 결정하는 함수
@@ -315,7 +505,7 @@ void get_filetype(char *filename, char *filetype) {
     strcpy(filetype, "image/png");
   } else if (strstr(filename, ".jpg")) {
     strcpy(filetype, "image/jpeg");
-  } else if (strstr(filename, ".mpeg")) {
+  } else if (strstr(filename, ".mpeg") || strstr(filename, ".mpg")) {
     strcpy(filetype, "video/mpeg");
   } else {
     strcpy(filetype, "text/plain");
@@ -328,18 +518,25 @@ void get_filetype(char *filename, char *filetype) {
  *
  * 클라이언트가 전송한 모든 HTTP 요청 헤더를 읽어서 출력한다.
  * 빈 줄(CRLF)이 나올 때까지 계속해서 헤더를 읽는다.
+ * Range 헤더의 값은 따로 저장한다. If-Range 가 있으면 Range 를 무시한다 (range_header 참고).
  *
  * @param rp 요청을 읽기 위한 rio 버퍼 구조체
+ * @param range Range 헤더의 값을 저장할 버퍼 (없으면 빈 문자열)
  */
-void read_requesthdrs(rio_t *rp) {
+void read_requesthdrs(rio_t *rp, char *range) {
   char buf[MAXLINE];
+  int if_range = 0;
 
-  Rio_readlineb(rp, buf, MAXLINE);
+  range[0] = '\0';
 
-  while (strcmp(buf, "\r\n")) {
+  // 빈 줄이 오기 전에 연결이 끊기면(읽은 것이 없으면) 그만 읽는다.
+  while (rio_readlineb(rp, buf, MAXLINE) > 0 && strcmp(buf, "\r\n")) {
     printf("%s", buf);
     fflush(stdout);   // 버퍼를 즉시 비우기
-    Rio_readlineb(rp, buf, MAXLINE);
+    range_header(buf, range, &if_range);
+  }
+  if (if_range) {
+    range[0] = '\0';
   }
   return;
 }
@@ -358,21 +555,28 @@ void read_requesthdrs(rio_t *rp) {
  * @param longmsg 자세한 오류 설명
  */
 void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg) {
-  char buf[MAXLINE], body[MAXBUF];
+  char body[MAXBUF];
+  rio_iov_t resp;
+  int len;
 
   /* Build the HTTP response body */
-  sprintf(body, "<html><title>Tiny Error</title>");
-  sprintf(body, "%s<body bgcolor=""ffffff"">\r\n",body);
-  sprintf(body, "%s%s: %s\r\n", body, errnum, shortmsg);
-  sprintf(body, "%s<p>%s: %s\r\n", body, longmsg, cause);
-  sprintf(body, "%s<hr><em>The Tiny Web server</em>\r\n", body);
-
-  /* Print the HTTP response */
-  sprintf(buf, "HTTP/1.0 %s %s\r\n", errnum, shortmsg);
-  Rio_writen(fd, buf, strlen(buf));
-  sprintf(buf, "Content-type: text/html\r\n");
-  Rio_writen(fd, buf, strlen(buf));
-  sprintf(buf, "Content-length: %d\r\n\r\n", (int)strlen(body));
-  Rio_writen(fd, buf, strlen(buf));
-  Rio_writen(fd, body, strlen(body));
+  len = snprintf(body, sizeof(body),
+                 "<html><title>Tiny Error</title>"
+                 "<body bgcolor=""ffffff"">\r\n"
+                 "%s: %s\r\n"
+                 "<p>%s: %s\r\n"
+                 "<hr><em>The Tiny Web server</em>\r\n",
+                 errnum, shortmsg, longmsg, cause);
+  if (len >= (int)sizeof(body)) {
+    len = sizeof(body) - 1;
+  }
+
+  /* Print the HTTP response: 헤더와 본문을 모아 writev 한 번으로 보낸다 (작은 응답은 세그먼트 하나) */
+  rio_iovinit(&resp);
+  rio_iovprintf(&resp, "HTTP/1.0 %s %s\r\n"
+                       "Content-type: text/html\r\n"
+                       "Content-length: %d\r\n\r\n",
+                errnum, shortmsg, len);
+  rio_iovadd(&resp, body, len);
+  rio_writev(fd, &resp);
 }
\ No newline at end of file
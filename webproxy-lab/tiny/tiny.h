@@ -0,0 +1,37 @@
+/*
+ * tiny.h - tiny 서버의 여러 소스 파일이 함께 사용하는 선언
+ */
+#ifndef __TINY_H__
+#define __TINY_H__
+
+#include "csapp.h"
+#include "fcache.h"
+
+/* 연결을 처리하는 방식 */
+typedef enum {
+  MODE_ITER,          // 메인 스레드가 연결을 하나씩 차례로 처리한다 (CS:APP 원본)
+  MODE_THREAD,        // 미리 만든 작업 스레드들이 같은 듣기 소켓에서 직접 accept 해 처리한다
+  MODE_EPOLL          // epoll 이벤트 루프들이 non-blocking 연결을 상태 기계로 처리한다
+} tiny_mode_t;
+
+/* 실행 옵션 */
+typedef struct {
+  tiny_mode_t mode;   // -m: 연결 처리 방식
+  int nthreads;       // -n: thread 모드의 작업 스레드 수, epoll 모드의 이벤트 루프 수
+  int cgi_workers;    // -w: CGI 프로그램마다 둘 상주 worker 수 (0 이면 요청마다 fork/execve)
+} tiny_config_t;
+
+extern tiny_config_t config;
+
+/* tiny.c */
+void log_accept(struct sockaddr_storage *addr, socklen_t addrlen);
+int route_request(int fd, char *method, char *uri, fcache_entry_t **fe);
+void clienterror(int fd, char *cause, char *errnum, char *shortmsg,
+                 char *longmsg);
+void copy_file(int fd, int srcfd, off_t offset, int filesize);
+void close_inherited_fds(void);
+
+/* evloop.c */
+void evloop_run(int listenfd, int nloops);
+
+#endif /* __TINY_H__ */
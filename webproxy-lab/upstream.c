@@ -0,0 +1,156 @@
+/*
+ * upstream.c - 목적지 서버별 keep-alive 연결 풀
+ *
+ * 목적지마다 유휴 연결을 스택(LIFO)으로 보관한다. 가장 최근에 쓴 연결일수록
+ * 서버가 아직 닫지 않았을 가능성이 높으므로 위에서부터 꺼낸다.
+ * 유휴 시간이 지난 연결은 꺼내거나 돌려놓을 때 그 목적지 것만 정리한다.
+ *
+ * 풀에 있는 동안 서버가 연결을 닫았을 수 있으므로, 꺼낼 때 MSG_PEEK 로 한 번 확인한다.
+ * 그래도 요청을 보낸 직후 닫힌 연결은 호출한 쪽이 새 연결로 한 번 다시 시도해야 한다.
+ */
+#include "upstream.h"
+#include "cache.h"
+
+/* 풀에 있는 유휴 연결 하나 */
+typedef struct idle_conn {
+    int fd;
+    time_t since;                   // 풀에 들어온 시각
+    struct idle_conn *next;
+} idle_conn_t;
+
+/* 목적지 하나 (host:port) */
+typedef struct origin {
+    char *key;                      // "host:port"
+    uint64_t key_hash;
+    idle_conn_t *idle;              // 유휴 연결 스택 (위가 가장 최근)
+    int nidle;
+    struct origin *next;            // 같은 버킷의 다음 목적지
+} origin_t;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static origin_t *origin_buckets[UPSTREAM_HASH_BUCKETS];
+
+
+/**
+ * 목적지를 찾는 함수 (create 가 1 이면 없을 때 새로 만든다, pool_lock 을 잡은 채 호출)
+ */
+static origin_t *find_origin(char *hostname, char *port, int create) {
+    char key[MAXLINE];
+    uint64_t hash;
+    origin_t **bucket, *o;
+
+    snprintf(key, sizeof(key), "%s:%s", hostname, port);
+    hash = hash_uri(key);
+    bucket = &origin_buckets[hash & (UPSTREAM_HASH_BUCKETS - 1)];
+
+    for (o = *bucket; o != NULL; o = o->next) {
+        if (o->key_hash == hash && strcmp(o->key, key) == 0) {
+            return o;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    o = Calloc(1, sizeof(origin_t));
+    o->key = strdup(key);
+    o->key_hash = hash;
+    o->next = *bucket;
+    *bucket = o;
+    return o;
+}
+
+/**
+ * 목적지의 유휴 연결 중 유휴 시간이 지난 것을 닫는 함수 (pool_lock 을 잡은 채 호출)
+ *
+ * 스택 아래쪽일수록 오래된 연결이므로, 처음으로 만료된 연결부터 아래는 모두 만료되었다.
+ */
+static void expire_idle(origin_t *o, time_t now) {
+    idle_conn_t **pp, *ic;
+
+    for (pp = &o->idle; *pp != NULL; pp = &(*pp)->next) {
+        if (now - (*pp)->since >= UPSTREAM_IDLE_TIMEOUT) {
+            break;
+        }
+    }
+    while ((ic = *pp) != NULL) {
+        *pp = ic->next;
+        close(ic->fd);
+        free(ic);
+        o->nidle--;
+    }
+}
+
+/**
+ * 풀에 있던 연결을 서버가 이미 닫았는지 확인하는 함수
+ *
+ * 응답을 끝까지 읽은 뒤 돌려놓았으므로 읽을 데이터가 있으면 안 된다.
+ * EOF 나 예상하지 못한 데이터가 보이면 그 연결은 쓸 수 없다.
+ */
+static int is_stale(int fd) {
+    char c;
+    ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+
+    return !(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+/**
+ * 목적지로 가는 유휴 연결을 풀에서 꺼내는 함수
+ *
+ * @return 다시 쓸 수 있는 연결, 없으면 -1 (호출한 쪽이 새로 연결한다)
+ */
+int upstream_get(char *hostname, char *port) {
+    origin_t *o;
+    idle_conn_t *ic;
+    int fd = -1;
+
+    pthread_mutex_lock(&pool_lock);
+
+    if ((o = find_origin(hostname, port, 0)) != NULL) {
+        expire_idle(o, time(NULL));
+        while ((ic = o->idle) != NULL) {
+            o->idle = ic->next;
+            o->nidle--;
+            fd = ic->fd;
+            free(ic);
+            if (!is_stale(fd)) {
+                break;
+            }
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    pthread_mutex_unlock(&pool_lock);
+    return fd;
+}
+
+/**
+ * 응답을 끝까지 읽은 연결을 풀에 돌려놓는 함수
+ *
+ * 목적지의 유휴 연결이 이미 UPSTREAM_MAX_IDLE 개면 닫는다.
+ */
+void upstream_put(char *hostname, char *port, int fd) {
+    origin_t *o;
+    idle_conn_t *ic;
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&pool_lock);
+
+    o = find_origin(hostname, port, 1);
+    expire_idle(o, now);
+    if (o->nidle >= UPSTREAM_MAX_IDLE) {
+        pthread_mutex_unlock(&pool_lock);
+        close(fd);
+        return;
+    }
+
+    ic = Malloc(sizeof(idle_conn_t));
+    ic->fd = fd;
+    ic->since = now;
+    ic->next = o->idle;
+    o->idle = ic;
+    o->nidle++;
+
+    pthread_mutex_unlock(&pool_lock);
+}
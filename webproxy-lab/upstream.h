@@ -0,0 +1,19 @@
+/*
+ * upstream.h - 목적지 서버별 keep-alive 연결 풀
+ *
+ * 응답을 끝까지 읽은 목적지 연결은 닫지 않고 (host, port) 별 풀에 돌려놓는다.
+ * 다음 미스가 같은 목적지로 가면 getaddrinfo 와 TCP handshake 없이 그 연결을 다시 쓴다.
+ */
+#ifndef __UPSTREAM_H__
+#define __UPSTREAM_H__
+
+#include "csapp.h"
+
+#define UPSTREAM_MAX_IDLE       8       // 목적지 하나당 풀에 남겨 둘 유휴 연결 수
+#define UPSTREAM_IDLE_TIMEOUT   15      // 유휴 연결을 버리기까지의 시간 (초)
+#define UPSTREAM_HASH_BUCKETS   64      // 목적지 표의 버킷 수 (2의 거듭제곱)
+
+int upstream_get(char *hostname, char *port);
+void upstream_put(char *hostname, char *port, int fd);
+
+#endif /* __UPSTREAM_H__ */